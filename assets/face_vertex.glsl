@@ -0,0 +1,77 @@
+#version 330 core
+
+// Face records, six vertices are drawn per face
+uniform usamplerBuffer faces;
+uniform vec3 regionOrigin;
+uniform float mcubeSize;
+
+// Bits per coordinate in a record, set from the
+// region depth the game was built with
+uniform uint cellBits;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+out float brightness;
+
+// Corners of each face in the same order as
+// addFace, 0 is the low side and 1 the high side
+const vec3 corners[24] = vec3[](
+    // Front
+    vec3(0, 1, 1), vec3(1, 1, 1), vec3(0, 0, 1), vec3(1, 0, 1),
+    // Back
+    vec3(0, 0, 0), vec3(1, 0, 0), vec3(0, 1, 0), vec3(1, 1, 0),
+    // Left
+    vec3(0, 0, 0), vec3(0, 1, 0), vec3(0, 0, 1), vec3(0, 1, 1),
+    // Right
+    vec3(1, 0, 1), vec3(1, 1, 1), vec3(1, 0, 0), vec3(1, 1, 0),
+    // Top
+    vec3(0, 1, 0), vec3(1, 1, 0), vec3(0, 1, 1), vec3(1, 1, 1),
+    // Bottom
+    vec3(0, 0, 1), vec3(1, 0, 1), vec3(0, 0, 0), vec3(1, 0, 0)
+);
+
+const int indices[6] = int[](0, 1, 3, 0, 3, 2);
+
+void main() {
+    // The cell and then a light byte per corner
+    uvec2 entry = texelFetch(faces, gl_VertexID / 6).rg;
+    uint record = entry.x;
+
+    // Laid out as in addFaceRecord
+    uint cellMask = (1u << cellBits) - 1u;
+    uint extentBits = (29u - 3u * cellBits) / 2u;
+    uint extentMask = (1u << extentBits) - 1u;
+    uint faceShift = 3u * cellBits;
+
+    vec3 cell = vec3(record & cellMask, (record >> cellBits) & cellMask, (record >> (2u * cellBits)) & cellMask);
+    int face = int((record >> faceShift) & 7u);
+    float width = float((record >> (faceShift + 3u)) & extentMask) + 1.0;
+    float height = float((record >> (faceShift + 3u + extentBits)) & extentMask) + 1.0;
+
+    // Merged faces stretch along the two axes
+    // the face lies in
+    vec3 extent;
+    if (face < 2)
+        extent = vec3(width, height, 1.0);
+    else if (face < 4)
+        extent = vec3(1.0, height, width);
+    else
+        extent = vec3(width, 1.0, height);
+
+    int cornerIndex = indices[gl_VertexID % 6];
+    vec3 corner = corners[face * 4 + cornerIndex];
+
+    uint light = (entry.y >> (8 * cornerIndex)) & 255u;
+    float level = float(max(light >> 4, light & 15u));
+
+    // Each level down is a bit darker
+    brightness = 0.05 + 0.95 * pow(0.8, 15.0 - level);
+
+    vec3 low = vec3(-0.5 * mcubeSize);
+    vec3 high = (extent - 0.5) * mcubeSize;
+    vec3 aPos = regionOrigin + cell * mcubeSize + mix(low, high, corner);
+
+    gl_Position = projection * view * model * vec4(aPos.x, aPos.y, aPos.z, 1.0);
+}
@@ -1,6 +1,10 @@
 #version 330 core
-out vec3 color;
+in float brightness;
+out vec4 color;
+
+// Below 1 for the transparent faces
+uniform float alpha;
 
 void main() {
-    color = vec3(1.0, 1.0, 1.0);
+    color = vec4(vec3(brightness), alpha);
 }
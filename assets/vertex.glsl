@@ -1,10 +1,20 @@
 #version 330 core
 
 layout (location = 0) in vec3 aPos;
+// Sky light in the high 4 bits, cube light in
+// the low 4
+layout (location = 1) in uint aLight;
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+out float brightness;
+
 void main() {
+    float level = float(max(aLight >> 4, aLight & 15u));
+
+    // Each level down is a bit darker
+    brightness = 0.05 + 0.95 * pow(0.8, 15.0 - level);
+
     gl_Position = projection * view * model * vec4(aPos.x, aPos.y, aPos.z, 1.0);
 }
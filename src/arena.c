@@ -0,0 +1,204 @@
+/**
+ * Bump arenas for memory that only lives for a
+ * frame or a single piece of work.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+static const size_t ARENA_ALIGN = 16;
+
+// Starting size, it grows to its high water mark
+// after the first overflow
+static const size_t SCRATCH_ARENA_SIZE = 256 * 1024;
+
+/**
+ * A heap block for an allocation that didn't fit,
+ * start is where it begins in the arena's count
+ * of used bytes.
+ *
+ */
+typedef struct _arenaOverflow {
+    struct _arenaOverflow* next;
+    size_t start;
+    size_t bytes;
+    // Keeps data aligned to 16
+    size_t pad;
+    char data[];
+} ArenaOverflow;
+
+static _Thread_local Arena* scratchArena = NULL;
+
+// Totals over every thread
+static size_t reservedBytes = 0;
+static size_t scratchHighWater = 0;
+
+static size_t alignSize(size_t bytes) {
+    return (bytes + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static void raiseHighWater(size_t* peak, size_t value) {
+    size_t current = __atomic_load_n(peak, __ATOMIC_RELAXED);
+
+    while (value > current &&
+           !__atomic_compare_exchange_n(peak, &current, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static void* allocBase(size_t capacity) {
+    void* result = aligned_alloc(ARENA_ALIGN, capacity);
+
+    if (result == NULL) {
+        fprintf(stderr, "ERROR: Unable to allocate memory for arena\n");
+        exit(1);
+    }
+
+    __atomic_add_fetch(&reservedBytes, capacity, __ATOMIC_RELAXED);
+    return result;
+}
+
+Arena* initArena(size_t capacity) {
+    Arena* result = malloc(sizeof(Arena));
+
+    if (result == NULL) {
+        fprintf(stderr, "ERROR: Unable to allocate memory for arena\n");
+        exit(1);
+    }
+
+    result->capacity = alignSize(capacity);
+    result->base = allocBase(result->capacity);
+    result->used = 0;
+    result->highWater = 0;
+    result->overflow = NULL;
+    result->overflowBytes = 0;
+    result->peak = NULL;
+
+    return result;
+}
+
+void* arenaAlloc(Arena* arena, size_t bytes) {
+    bytes = alignSize(bytes);
+
+    size_t start = arena->used;
+    arena->used += bytes;
+    if (arena->used > arena->highWater)
+        arena->highWater = arena->used;
+
+    // Once something overflows the rest has to
+    // follow it so marks stay in order
+    if (arena->overflow == NULL && arena->used <= arena->capacity)
+        return arena->base + start;
+
+    ArenaOverflow* block = malloc(sizeof(ArenaOverflow) + bytes);
+
+    if (block == NULL) {
+        fprintf(stderr, "ERROR: Unable to allocate memory for arena\n");
+        exit(1);
+    }
+
+    block->next = arena->overflow;
+    block->start = start;
+    block->bytes = bytes;
+    arena->overflow = block;
+    arena->overflowBytes += bytes;
+    __atomic_add_fetch(&reservedBytes, bytes, __ATOMIC_RELAXED);
+
+    return block->data;
+}
+
+void* arenaResize(Arena* arena, void* ptr, size_t oldBytes, size_t newBytes) {
+    if (ptr != NULL && arena->overflow == NULL) {
+        char* end = arena->base + arena->used;
+        size_t start = (char*) ptr - arena->base;
+
+        // The last thing handed out can just
+        // move the end
+        if ((char*) ptr + alignSize(oldBytes) == end && start + alignSize(newBytes) <= arena->capacity) {
+            arena->used = start + alignSize(newBytes);
+            if (arena->used > arena->highWater)
+                arena->highWater = arena->used;
+
+            return ptr;
+        }
+    }
+
+    void* result = arenaAlloc(arena, newBytes);
+
+    if (ptr != NULL)
+        memcpy(result, ptr, oldBytes < newBytes ? oldBytes : newBytes);
+
+    return result;
+}
+
+size_t getArenaMark(Arena* arena) {
+    return arena->used;
+}
+
+void rewindArena(Arena* arena, size_t mark) {
+    // Overflow blocks are newest first
+    while (arena->overflow != NULL && arena->overflow->start >= mark) {
+        ArenaOverflow* block = arena->overflow;
+        arena->overflow = block->next;
+        arena->overflowBytes -= block->bytes;
+        __atomic_sub_fetch(&reservedBytes, block->bytes, __ATOMIC_RELAXED);
+        free(block);
+    }
+
+    arena->used = mark;
+
+    if (mark == 0 && arena->peak != NULL)
+        raiseHighWater(arena->peak, arena->highWater);
+
+    // Empty, so the block can grow to fit
+    // everything that was used at once
+    if (mark == 0 && arena->highWater > arena->capacity) {
+        __atomic_sub_fetch(&reservedBytes, arena->capacity, __ATOMIC_RELAXED);
+        free(arena->base);
+
+        arena->capacity = arena->highWater;
+        arena->base = allocBase(arena->capacity);
+    }
+}
+
+void resetArena(Arena* arena) {
+    rewindArena(arena, 0);
+}
+
+void freeArena(Arena** arenaPtrPtr) {
+    Arena* arenaPtr = *arenaPtrPtr;
+
+    if (arenaPtr == NULL)
+        return;
+
+    rewindArena(arenaPtr, 0);
+
+    __atomic_sub_fetch(&reservedBytes, arenaPtr->capacity, __ATOMIC_RELAXED);
+    free(arenaPtr->base);
+    free(arenaPtr);
+
+    *arenaPtrPtr = NULL;
+}
+
+Arena* getScratchArena() {
+    if (scratchArena == NULL) {
+        scratchArena = initArena(SCRATCH_ARENA_SIZE);
+        scratchArena->peak = &scratchHighWater;
+    }
+
+    return scratchArena;
+}
+
+void freeThreadArenas() {
+    freeArena(&scratchArena);
+}
+
+ArenaUsage getArenaUsage() {
+    ArenaUsage result = {
+        .reserved = __atomic_load_n(&reservedBytes, __ATOMIC_RELAXED),
+        .scratchHighWater = __atomic_load_n(&scratchHighWater, __ATOMIC_RELAXED)
+    };
+
+    return result;
+}
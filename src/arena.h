@@ -0,0 +1,84 @@
+#include <stddef.h>
+
+#ifndef ARENA_H
+#define ARENA_H
+
+/**
+ * Memory handed out by moving a pointer along one
+ * block and given back all at once. Anything past
+ * the block comes from the heap until the arena is
+ * next emptied, then the block grows to the most
+ * that was used so it fits next time.
+ *
+ */
+typedef struct _arena {
+    char* base;
+    size_t capacity;
+
+    // Bytes handed out, including overflow
+    size_t used;
+    size_t highWater;
+
+    // Heap blocks for what didn't fit
+    struct _arenaOverflow* overflow;
+    size_t overflowBytes;
+
+    // Raised to the high water mark whenever the
+    // arena is emptied, can be NULL
+    size_t* peak;
+} Arena;
+
+/**
+ * The arenas of every thread together.
+ *
+ */
+typedef struct _arenaUsage {
+    size_t reserved;
+    size_t scratchHighWater;
+} ArenaUsage;
+
+Arena* initArena(size_t capacity);
+
+/**
+ * Returns bytes aligned to 16, never NULL.
+ *
+ */
+void* arenaAlloc(Arena* arena, size_t bytes);
+
+/**
+ * Grows or shrinks ptr, in place if it was the
+ * last thing handed out. ptr can be NULL.
+ *
+ */
+void* arenaResize(Arena* arena, void* ptr, size_t oldBytes, size_t newBytes);
+
+/**
+ * Everything handed out after a mark is given
+ * back when rewound to it, marks have to be
+ * rewound in the reverse order they were taken.
+ *
+ */
+size_t getArenaMark(Arena* arena);
+void rewindArena(Arena* arena, size_t mark);
+
+void resetArena(Arena* arena);
+void freeArena(Arena** arenaPtrPtr);
+
+/**
+ * Each thread has its own scratch arena, made
+ * when it is first asked for. Space is given back
+ * with marks by whoever takes it.
+ *
+ */
+Arena* getScratchArena();
+
+/**
+ * Frees the arenas of the calling thread, call
+ * before a thread that used them exits.
+ *
+ */
+void freeThreadArenas();
+
+ArenaUsage getArenaUsage();
+
+#endif
@@ -0,0 +1,170 @@
+/**
+ * Loads assets by mapping them instead of
+ * reading them. With a bundle every asset comes
+ * from the one mapping, unless its loose file
+ * was changed after the bundle was made.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "asset.h"
+
+static void* bundleMapping = NULL;
+static size_t bundleSize = 0;
+static const AssetBundleEntry* bundleEntries = NULL;
+static uint32_t bundleCount = 0;
+
+// When the bundle file was last written
+static struct timespec bundleTime = { 0 };
+
+/**
+ * Maps a whole file read only. Empty files have
+ * nothing to map so they come back as NULL with
+ * a size of 0.
+ *
+ */
+static int mapFile(const char* path, void** mapping, size_t* size, struct timespec* modified) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    *size = info.st_size;
+    *modified = info.st_mtim;
+    *mapping = NULL;
+
+    if (*size > 0) {
+        *mapping = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (*mapping == MAP_FAILED) {
+            *mapping = NULL;
+            close(fd);
+            return -1;
+        }
+    }
+
+    // The mapping stays after the file closes
+    close(fd);
+    return 0;
+}
+
+int openAssetBundle(const char* path) {
+    closeAssetBundle();
+
+    void* mapping;
+    size_t size;
+    struct timespec modified;
+
+    if (mapFile(path, &mapping, &size, &modified) < 0)
+        return -1;
+
+    const AssetBundleHeader* header = mapping;
+
+    if (size < sizeof(AssetBundleHeader) ||
+        header->magic != ASSET_BUNDLE_MAGIC || header->version != ASSET_BUNDLE_VERSION ||
+        header->count > (size - sizeof(AssetBundleHeader)) / sizeof(AssetBundleEntry)) {
+        fprintf(stderr, "ERROR: %s is not an asset bundle\n", path);
+
+        if (mapping != NULL)
+            munmap(mapping, size);
+        return -1;
+    }
+
+    const AssetBundleEntry* entries = (const AssetBundleEntry*) (header + 1);
+
+    for (uint32_t i = 0; i < header->count; i++) {
+        if (entries[i].offset > size || entries[i].size > size - entries[i].offset ||
+            memchr(entries[i].name, '\0', ASSET_NAME_LENGTH) == NULL) {
+            fprintf(stderr, "ERROR: Asset bundle %s is damaged\n", path);
+
+            munmap(mapping, size);
+            return -1;
+        }
+    }
+
+    bundleMapping = mapping;
+    bundleSize = size;
+    bundleEntries = entries;
+    bundleCount = header->count;
+    bundleTime = modified;
+
+    return 0;
+}
+
+void closeAssetBundle() {
+    if (bundleMapping != NULL)
+        munmap(bundleMapping, bundleSize);
+
+    bundleMapping = NULL;
+    bundleSize = 0;
+    bundleEntries = NULL;
+    bundleCount = 0;
+    bundleTime = (struct timespec) { 0 };
+}
+
+static int isNewer(struct timespec a, struct timespec b) {
+    return a.tv_sec > b.tv_sec || (a.tv_sec == b.tv_sec && a.tv_nsec > b.tv_nsec);
+}
+
+static const AssetBundleEntry* findBundleEntry(const char* path) {
+    for (uint32_t i = 0; i < bundleCount; i++) {
+        if (strcmp(bundleEntries[i].name, path) == 0)
+            return &(bundleEntries[i]);
+    }
+
+    return NULL;
+}
+
+int loadAsset(const char* path, Asset* asset) {
+    const AssetBundleEntry* entry = findBundleEntry(path);
+
+    // A loose file edited since the bundle was
+    // made is newer than what the bundle holds
+    struct stat info;
+    if (entry != NULL && stat(path, &info) == 0 && isNewer(info.st_mtim, bundleTime))
+        entry = NULL;
+
+    if (entry != NULL) {
+        asset->data = (const char*) bundleMapping + entry->offset;
+        asset->size = entry->size;
+        asset->mapping = NULL;
+        asset->mappingSize = 0;
+
+        return 0;
+    }
+
+    void* mapping;
+    size_t size;
+    struct timespec modified;
+
+    if (mapFile(path, &mapping, &size, &modified) < 0)
+        return -1;
+
+    asset->data = mapping != NULL ? mapping : "";
+    asset->size = size;
+    asset->mapping = mapping;
+    asset->mappingSize = size;
+
+    return 0;
+}
+
+void freeAsset(Asset* asset) {
+    if (asset->mapping != NULL)
+        munmap(asset->mapping, asset->mappingSize);
+
+    asset->data = NULL;
+    asset->size = 0;
+    asset->mapping = NULL;
+    asset->mappingSize = 0;
+}
@@ -0,0 +1,63 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef ASSET_H
+#define ASSET_H
+
+/**
+ * Layout of a bundle file, the header is
+ * followed by the index and then the blobs.
+ * Offsets are from the start of the file.
+ *
+ */
+#define ASSET_BUNDLE_MAGIC 0x4241434du // "MCAB"
+#define ASSET_BUNDLE_VERSION 1
+#define ASSET_NAME_LENGTH 56
+
+typedef struct _assetBundleHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+} AssetBundleHeader;
+
+typedef struct _assetBundleEntry {
+    char name[ASSET_NAME_LENGTH];
+    uint32_t offset;
+    uint32_t size;
+} AssetBundleEntry;
+
+/**
+ * The bytes of a file, not terminated. They are
+ * either in the bundle or in a mapping of their
+ * own that is released by freeAsset.
+ *
+ */
+typedef struct _asset {
+    const char* data;
+    size_t size;
+
+    void* mapping;
+    size_t mappingSize;
+} Asset;
+
+/**
+ * Maps a bundle that assets are looked up in
+ * before the loose files. Loose files written
+ * after the bundle are still used over it.
+ * Returns 0 when it was opened and -1 otherwise.
+ *
+ */
+int openAssetBundle(const char* path);
+void closeAssetBundle();
+
+/**
+ * Finds an asset by its path and prints where it
+ * came from. Returns 0 when it was found and -1
+ * if it doesn't exist.
+ *
+ */
+int loadAsset(const char* path, Asset* asset);
+void freeAsset(Asset* asset);
+
+#endif
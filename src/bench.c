@@ -0,0 +1,703 @@
+/**
+ * Generated worlds and a scripted camera for
+ * timing the whole game end to end.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "bench.h"
+#include "palette.h"
+#include "light.h"
+#include "arena.h"
+#include "edit.h"
+#include "physics.h"
+
+// Scenes are sized in regions 32 mini cubes a
+// side so every region depth gets the same world
+#define SCENE_REGIONS(n) ((n) * 32 / REGION_MCUBE_DEPTH)
+
+static const BenchScene BENCH_SCENES[] = {
+    {.name = "small", .width = SCENE_REGIONS(8), .height = SCENE_REGIONS(8), .depth = SCENE_REGIONS(8), .ticks = 600},
+    {.name = "medium", .width = SCENE_REGIONS(24), .height = SCENE_REGIONS(8), .depth = SCENE_REGIONS(24), .ticks = 900},
+    {.name = "large", .width = SCENE_REGIONS(48), .height = SCENE_REGIONS(8), .depth = SCENE_REGIONS(48), .ticks = 1200}
+};
+
+static const int BENCH_SCENE_COUNT = sizeof(BENCH_SCENES) / sizeof(BENCH_SCENES[0]);
+
+// Cube IDs from the bottom of a column up, lamps
+// sit on top of a few of them
+static char* STONE_CUBE = "1";
+static char* DIRT_CUBE = "2";
+static char* GRASS_CUBE = "3";
+static char* LAMP_CUBE = "4";
+
+// Transparent, fills the valleys up to the
+// water level
+static char* WATER_CUBE = "5";
+
+static const int DIRT_DEPTH = 3;
+
+// One column in this many has a lamp
+static const uint32_t LAMP_SPACING = 1024;
+
+// Terrain is the same for every run
+static const uint32_t TERRAIN_SEED = 0x6d696e69;
+
+// Heights in mini cubes, the ground sits this far
+// up the world and hills go this far either way
+static const float TERRAIN_LEVEL = 0.4f;
+static const float TERRAIN_AMPLITUDE = 24.0f;
+
+// Mini cubes below the ground level the water
+// comes up to
+static const float WATER_DEPTH = 6.0f;
+
+// Wavelength of each octave in mini cubes and how
+// much of the amplitude it gets
+static const float TERRAIN_WAVELENGTHS[] = {160.0f, 56.0f, 18.0f};
+static const float TERRAIN_WEIGHTS[] = {0.65f, 0.25f, 0.1f};
+
+// Regions timed for each culling kernel, each
+// kernel gets at least this long
+static const int CULL_SAMPLE_REGIONS = 64;
+static const double CULL_MEASURE_MS = 20.0;
+
+// Bodies the size of the player stand on a grid
+// this many a side, each walking in a circle
+static const int PHYSICS_GRID = 4;
+static const int PHYSICS_TICKS = 600;
+static const float PHYSICS_TICK_SECONDS = 1.0f / 60.0f;
+static const vec3s BODY_HALF_SIZE = {.x = 0.3f, .y = 0.9f, .z = 0.3f};
+static const float BODY_SPEED = 2.0f;
+static const float BODY_GRAVITY = 20.0f;
+
+// Mini cubes above the ground the bodies start
+static const int BODY_DROP = 8;
+
+// Spots on the ground a cube and a lamp are put
+// down on
+static const int EDIT_SAMPLES = 64;
+static const uint32_t EDIT_SEED = 0x65646974;
+
+// The camera flies this far above the highest
+// hills, looking down this many degrees
+static const float CAMERA_HEIGHT = 6.0f;
+static const float CAMERA_PITCH = 20.0f;
+
+const BenchScene* getBenchScene(const char* name) {
+    for (int i = 0; i < BENCH_SCENE_COUNT; i++) {
+        if (strcmp(BENCH_SCENES[i].name, name) == 0)
+            return &(BENCH_SCENES[i]);
+    }
+
+    return NULL;
+}
+
+void printBenchScenes() {
+    for (int i = 0; i < BENCH_SCENE_COUNT; i++) {
+        const BenchScene* scene = &(BENCH_SCENES[i]);
+
+        printf("  %-8s %dx%dx%d regions, %d frames\n",
+                scene->name, scene->width, scene->height, scene->depth, scene->ticks);
+    }
+}
+
+static uint32_t hashPoint(int x, int z, uint32_t seed) {
+    uint32_t h = seed ^ ((uint32_t) x * 0x27d4eb2du) ^ ((uint32_t) z * 0x165667b1u);
+
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    h *= 0x297a2d39u;
+    h ^= h >> 15;
+
+    return h;
+}
+
+/**
+ * Smoothly blended random values on a grid of the
+ * given spacing, between 0 and 1.
+ *
+ */
+static float getNoise(float x, float z, float wavelength, uint32_t seed) {
+    float gx = x / wavelength;
+    float gz = z / wavelength;
+
+    int x0 = (int) floorf(gx);
+    int z0 = (int) floorf(gz);
+    float tx = gx - x0;
+    float tz = gz - z0;
+
+    tx = tx * tx * (3.0f - 2.0f * tx);
+    tz = tz * tz * (3.0f - 2.0f * tz);
+
+    float corners[4];
+    for (int i = 0; i < 4; i++)
+        corners[i] = (float) (hashPoint(x0 + (i & 1), z0 + (i >> 1), seed) & 0xFFFF) / 65535.0f;
+
+    float near = corners[0] + (corners[1] - corners[0]) * tx;
+    float far = corners[2] + (corners[3] - corners[2]) * tx;
+
+    return near + (far - near) * tz;
+}
+
+/**
+ * Solid mini cubes in the column at world mini
+ * cube x and z.
+ *
+ */
+static int getTerrainHeight(const BenchScene* scene, int x, int z) {
+    float noise = 0.0f;
+
+    for (int i = 0; i < 3; i++)
+        noise += TERRAIN_WEIGHTS[i] * getNoise(x, z, TERRAIN_WAVELENGTHS[i], TERRAIN_SEED + i);
+
+    float level = scene->height * REGION_MCUBE_DEPTH * TERRAIN_LEVEL;
+
+    return (int) (level + (noise * 2.0f - 1.0f) * TERRAIN_AMPLITUDE);
+}
+
+/**
+ * Mini cubes up from the bottom of the world
+ * that are under water where there is no ground.
+ *
+ */
+static int getWaterLevel(const BenchScene* scene) {
+    return (int) (scene->height * REGION_MCUBE_DEPTH * TERRAIN_LEVEL - WATER_DEPTH);
+}
+
+static char* getTerrainCube(int y, int height, int lamp, int water) {
+    if (y < height - DIRT_DEPTH)
+        return STONE_CUBE;
+    if (y < height - 1)
+        return DIRT_CUBE;
+    if (y < height)
+        return GRASS_CUBE;
+    if (y == height && lamp)
+        return LAMP_CUBE;
+    if (y < water)
+        return WATER_CUBE;
+
+    return AIR_CUBE;
+}
+
+/**
+ * Writes the terrain of one region from the column
+ * heights under it. Regions the surface doesn't
+ * cross are left filled. The highest column counts
+ * the water on top of it.
+ *
+ * Returns 1 if the surface crosses it.
+ */
+static int generateRegion(Region* reg, int baseY, int* heights, uint8_t* lamps, int water, int lowest, int highest) {
+    const int D = REGION_MCUBE_DEPTH;
+
+    // Lamps are one above the highest column
+    if (baseY > highest)
+        return 0;
+
+    if (baseY + D <= lowest - DIRT_DEPTH) {
+        setRegionFill(STONE_CUBE, reg);
+        return 0;
+    }
+
+    expandRegion(reg);
+    makeRegionWritable(reg, REGION_BLOCK_DATA);
+
+    for (int y = 0; y < D; y++) {
+        for (int z = 0; z < D; z++) {
+            char** row = &(reg->data[z * D + y * D * D]);
+            RegionRow occupied = 0;
+            RegionRow opaque = 0;
+
+            for (int x = 0; x < D; x++) {
+                row[x] = getTerrainCube(baseY + y, heights[x + z * D], lamps[x + z * D], water);
+
+                if (row[x] != AIR_CUBE)
+                    occupied |= REGION_ROW_BIT(x);
+                if (row[x] != AIR_CUBE && row[x] != WATER_CUBE)
+                    opaque |= REGION_ROW_BIT(x);
+            }
+
+            setOccupancyRow(reg, y, z, occupied, opaque);
+        }
+    }
+
+    return 1;
+}
+
+Region** generateBenchWorld(const BenchScene* scene, int* count) {
+    const int D = REGION_MCUBE_DEPTH;
+    const float regionSize = D * REGION_MCUBE_SIZE;
+
+    int total = scene->width * scene->height * scene->depth;
+    Region** regions = malloc(total * sizeof(Region*));
+    uint8_t* surface = calloc(total, 1);
+
+    int* heights = malloc(D * D * sizeof(int));
+    uint8_t* lamps = malloc(D * D);
+
+    if (regions == NULL || surface == NULL || heights == NULL || lamps == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate memory for program!\n");
+        exit(1);
+    }
+
+    // Cube IDs go in the palette before meshing
+    // so the meshers only ever read it
+    getPaletteID(STONE_CUBE);
+    getPaletteID(DIRT_CUBE);
+    getPaletteID(GRASS_CUBE);
+    setPaletteLight(LAMP_CUBE, LIGHT_MAX);
+    setPaletteTransparent(WATER_CUBE, 1);
+
+    const int water = getWaterLevel(scene);
+
+    for (int rz = 0; rz < scene->depth; rz++) {
+        for (int rx = 0; rx < scene->width; rx++) {
+            // Every region in a column shares the
+            // heights under it, water covers the
+            // columns lower than it
+            int lowest = scene->height * D;
+            int highest = water;
+
+            for (int z = 0; z < D; z++) {
+                for (int x = 0; x < D; x++) {
+                    int wx = rx * D + x;
+                    int wz = rz * D + z;
+                    int height = getTerrainHeight(scene, wx, wz);
+
+                    heights[x + z * D] = height;
+                    lamps[x + z * D] = hashPoint(wx, wz, ~TERRAIN_SEED) % LAMP_SPACING == 0;
+
+                    if (height < lowest)
+                        lowest = height;
+                    if (height > highest)
+                        highest = height;
+                }
+            }
+
+            for (int ry = 0; ry < scene->height; ry++) {
+                int i = rx + rz * scene->width + ry * scene->width * scene->depth;
+                vec3s pos = {.x = rx * regionSize, .y = ry * regionSize, .z = rz * regionSize};
+
+                regions[i] = initRegion(pos);
+                surface[i] = generateRegion(regions[i], ry * D, heights, lamps, water, lowest, highest);
+            }
+        }
+    }
+
+    for (int ry = 0; ry < scene->height; ry++) {
+        for (int rz = 0; rz < scene->depth; rz++) {
+            for (int rx = 0; rx < scene->width; rx++) {
+                int i = rx + rz * scene->width + ry * scene->width * scene->depth;
+
+                if (rx + 1 < scene->width)
+                    connectRegions(regions[i], regions[i + 1], RIGHT);
+                if (rz + 1 < scene->depth)
+                    connectRegions(regions[i], regions[i + scene->width], FRONT);
+                if (ry + 1 < scene->height)
+                    connectRegions(regions[i], regions[i + scene->width * scene->depth], TOP);
+            }
+        }
+    }
+
+    // Open air and solid stone start out lit
+    // right, only the surface needs working out
+    for (int i = 0; i < total; i++) {
+        if (surface[i])
+            lightRegion(regions[i]);
+    }
+
+    free(heights);
+    free(lamps);
+    free(surface);
+
+    *count = total;
+
+    return regions;
+}
+
+void getBenchCamera(const BenchScene* scene, int tick, vec3s* position, float* yaw, float* pitch) {
+    const float regionSize = REGION_MCUBE_DEPTH * REGION_MCUBE_SIZE;
+
+    float centerX = scene->width * regionSize / 2.0f;
+    float centerZ = scene->depth * regionSize / 2.0f;
+    float radius = 0.35f * fminf(scene->width, scene->depth) * regionSize;
+
+    float angle = 2.0f * (float) M_PI * (float) tick / (float) scene->ticks;
+    float top = (scene->height * REGION_MCUBE_DEPTH * TERRAIN_LEVEL + TERRAIN_AMPLITUDE) * REGION_MCUBE_SIZE;
+
+    position->x = centerX + radius * cosf(angle);
+    position->y = top + CAMERA_HEIGHT;
+    position->z = centerZ + radius * sinf(angle);
+
+    // Facing along the loop
+    *yaw = angle * 180.0f / (float) M_PI + 90.0f;
+    *pitch = CAMERA_PITCH;
+}
+
+/**
+ * Culls every sampled run of rows once with the
+ * kernel, the way the mesher does it, once for
+ * each section along x.
+ *
+ */
+static void cullSample(enum CullKernel kernel, CullRows* runs, int count) {
+    const int sectionsPerAxis = REGION_MCUBE_DEPTH / REGION_SECTION_DEPTH;
+    RegionRow visible[6][CULL_MAX_ROWS];
+
+    for (int i = 0; i < count; i++) {
+        for (int s = 0; s < sectionsPerAxis; s++) {
+            int startX = s * REGION_SECTION_DEPTH;
+            RegionRow mask = getRowMask(startX, startX + REGION_SECTION_DEPTH - 1);
+
+            cullRowsWith(kernel, &(runs[i]), REGION_SECTION_DEPTH, mask, visible);
+        }
+    }
+}
+
+/**
+ * Picks up to CULL_SAMPLE_REGIONS of the regions
+ * to time. The sample has to be freed.
+ *
+ * Returns the sample and sets samples.
+ */
+static Region** sampleRegions(Region** regions, int count, int* samples) {
+    Region** sample = malloc(CULL_SAMPLE_REGIONS * sizeof(Region*));
+
+    if (sample == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate memory for program!\n");
+        exit(1);
+    }
+
+    // Regions with a surface have faces to find,
+    // the rest are left out unless there is none
+    *samples = 0;
+
+    for (int i = 0; i < count && *samples < CULL_SAMPLE_REGIONS; i++) {
+        if (!isRegionEmpty(regions[i]) && !isRegionFull(regions[i]))
+            sample[(*samples)++] = regions[i];
+    }
+
+    for (int i = 0; i < count && *samples == 0; i++)
+        sample[(*samples)++] = regions[i];
+
+    return sample;
+}
+
+void measureCullKernels(BenchResult* result, Region** regions, int count) {
+    const int D = REGION_MCUBE_DEPTH;
+    const int S = REGION_SECTION_DEPTH;
+
+    memset(result->cullRates, 0, sizeof(result->cullRates));
+    result->cullKernel = getCullKernel();
+
+    if (count == 0)
+        return;
+
+    int samples;
+    Region** sample = sampleRegions(regions, count, &samples);
+
+    // Sections are culled a few rows along z at a
+    // time, so that is what is timed
+    int runCount = samples * D * (D / S);
+    CullRows* runs = malloc((size_t) runCount * sizeof(CullRows));
+    RegionRow* ends = malloc((size_t) runCount * (S + 2) * sizeof(RegionRow));
+
+    if (runs == NULL || ends == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate memory for program!\n");
+        exit(1);
+    }
+
+    int run = 0;
+    for (int i = 0; i < samples; i++) {
+        for (int y = 0; y < D; y++) {
+            for (int z0 = 0; z0 < D; z0 += S) {
+                getCullRows(sample[i], OCCUPANCY_SOLID, y, z0, S, &(ends[run * (S + 2)]), &(runs[run]));
+                run++;
+            }
+        }
+    }
+
+    double frequency = (double) SDL_GetPerformanceFrequency();
+    double cells = (double) samples * D * D * D;
+
+    for (int kernel = 0; kernel < CULL_KERNEL_COUNT; kernel++) {
+        if (!isCullKernelSupported(kernel))
+            continue;
+
+        // Once to warm the caches
+        cullSample(kernel, runs, runCount);
+
+        Uint64 start = SDL_GetPerformanceCounter();
+        double elapsed = 0.0;
+        int passes = 0;
+
+        while (elapsed < CULL_MEASURE_MS) {
+            cullSample(kernel, runs, runCount);
+            passes++;
+            elapsed = (double) (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+        }
+
+        result->cullRates[kernel] = cells * passes / (elapsed * 1000000.0);
+    }
+
+    free(sample);
+    free(runs);
+    free(ends);
+}
+
+void measureMeshing(BenchResult* result, Region** regions, int count) {
+    const int sectionsPerAxis = REGION_MCUBE_DEPTH / REGION_SECTION_DEPTH;
+    const int sectionCount = sectionsPerAxis * sectionsPerAxis * sectionsPerAxis;
+
+    if (count == 0)
+        return;
+
+    int samples;
+    Region** sample = sampleRegions(regions, count, &samples);
+
+    Arena* scratch = getScratchArena();
+    size_t mark = getArenaMark(scratch);
+    MeshBuilder builder = {.data = NULL, .size = 0, .capacity = 0, .arena = scratch};
+    MeshBuilder clearBuilder = {.data = NULL, .size = 0, .capacity = 0, .arena = scratch};
+
+    double frequency = (double) SDL_GetPerformanceFrequency();
+
+    // Once to unpack cold regions and warm the
+    // caches, then once timed
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < samples; i++) {
+            for (int j = 0; j < sectionCount; j++) {
+                clearMeshBuilder(&builder);
+                clearMeshBuilder(&clearBuilder);
+
+                Uint64 start = SDL_GetPerformanceCounter();
+                buildRegionSection(sample[i], sample[i]->meshPtr, j, &builder, &clearBuilder);
+
+                if (pass == 1)
+                    addFrameTime(&(result->sectionTimes), (double) (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency);
+            }
+        }
+    }
+
+    freeMeshBuilder(&builder);
+    freeMeshBuilder(&clearBuilder);
+    rewindArena(scratch, mark);
+
+    free(sample);
+}
+
+/**
+ * The mini cube the ground or water stops at in
+ * a column, the first one up that bodies and
+ * lamps can be in.
+ *
+ */
+static int getGroundLevel(const BenchScene* scene, int x, int z) {
+    int height = getTerrainHeight(scene, x, z);
+    int water = getWaterLevel(scene);
+
+    return height > water ? height : water;
+}
+
+void measurePhysics(BenchResult* result, Region** regions, int count) {
+    const BenchScene* scene = result->scene;
+    const int D = REGION_MCUBE_DEPTH;
+    const int bodyCount = PHYSICS_GRID * PHYSICS_GRID;
+
+    result->bodyCount = 0;
+
+    if (count == 0)
+        return;
+
+    Body* bodies = malloc(bodyCount * sizeof(Body));
+
+    if (bodies == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate memory for program!\n");
+        exit(1);
+    }
+
+    // Spread out in the middle of each grid
+    // square, a little above the ground
+    for (int i = 0; i < bodyCount; i++) {
+        int x = (2 * (i % PHYSICS_GRID) + 1) * scene->width * D / (2 * PHYSICS_GRID);
+        int z = (2 * (i / PHYSICS_GRID) + 1) * scene->depth * D / (2 * PHYSICS_GRID);
+        int y = getGroundLevel(scene, x, z) + BODY_DROP;
+
+        bodies[i] = (Body) {
+            .position = {.x = x * REGION_MCUBE_SIZE, .y = y * REGION_MCUBE_SIZE, .z = z * REGION_MCUBE_SIZE},
+            .halfSize = BODY_HALF_SIZE,
+            .velocity = {.x = 0.0f, .y = 0.0f, .z = 0.0f},
+            .contacts = 0
+        };
+    }
+
+    double frequency = (double) SDL_GetPerformanceFrequency();
+
+    for (int tick = 0; tick < PHYSICS_TICKS; tick++) {
+        // Each body turns a full circle over the
+        // run, starting off facing its own way
+        for (int i = 0; i < bodyCount; i++) {
+            float heading = 2.0f * (float) M_PI * ((float) i / bodyCount + (float) tick / PHYSICS_TICKS);
+
+            bodies[i].velocity.x = BODY_SPEED * cosf(heading);
+            bodies[i].velocity.z = BODY_SPEED * sinf(heading);
+            bodies[i].velocity.y -= BODY_GRAVITY * PHYSICS_TICK_SECONDS;
+        }
+
+        Uint64 start = SDL_GetPerformanceCounter();
+        stepBodies(regions[0], bodies, bodyCount, PHYSICS_TICK_SECONDS);
+        addFrameTime(&(result->tickTimes), (double) (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency);
+    }
+
+    result->bodyCount = bodyCount;
+
+    free(bodies);
+}
+
+/**
+ * Sets one mini cube the way an edit does.
+ *
+ * Returns the time it took in milliseconds, or
+ * -1 if the cube was already there.
+ */
+static double timeEdit(Region* reg, int x, int y, int z, char* cubeID) {
+    EditBatch batch;
+    beginEdit(&batch);
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    int changed = setMCubeRow(&batch, reg, y, z, x, x, cubeID);
+    Uint64 end = SDL_GetPerformanceCounter();
+
+    // Remeshing isn't part of the edit
+    endEdit(&batch);
+
+    if (!changed)
+        return -1.0;
+
+    return (double) (end - start) * 1000.0 / (double) SDL_GetPerformanceFrequency();
+}
+
+void measureEdits(BenchResult* result, Region** regions, int count) {
+    const BenchScene* scene = result->scene;
+    const int D = REGION_MCUBE_DEPTH;
+
+    if (count == 0)
+        return;
+
+    for (int i = 0; i < EDIT_SAMPLES; i++) {
+        int x = hashPoint(i, 0, EDIT_SEED) % (uint32_t) (scene->width * D);
+        int z = hashPoint(i, 1, EDIT_SEED) % (uint32_t) (scene->depth * D);
+        int y = getGroundLevel(scene, x, z);
+
+        if (y < 0 || y >= scene->height * D)
+            continue;
+
+        Region* reg = regions[x / D + (z / D) * scene->width + (y / D) * scene->width * scene->depth];
+        char* old = getMCube(reg, x % D, y % D, z % D);
+
+        // Spots that already hold one are skipped
+        double placeTime = timeEdit(reg, x % D, y % D, z % D, STONE_CUBE);
+
+        if (placeTime >= 0.0) {
+            addFrameTime(&(result->placeTimes), placeTime);
+            addFrameTime(&(result->removeTimes), timeEdit(reg, x % D, y % D, z % D, old));
+        }
+
+        placeTime = timeEdit(reg, x % D, y % D, z % D, LAMP_CUBE);
+
+        if (placeTime >= 0.0) {
+            addFrameTime(&(result->lampPlaceTimes), placeTime);
+            addFrameTime(&(result->lampRemoveTimes), timeEdit(reg, x % D, y % D, z % D, old));
+        }
+    }
+}
+
+static void printBenchTimes(const char* name, FrameTimes* frames) {
+    FrameSummary summary;
+    summarizeFrameTimes(frames, &summary);
+
+    printf(",\"%s\":{\"mean\":%.4f,\"min\":%.4f,\"p50\":%.4f,\"p95\":%.4f,\"p99\":%.4f,\"max\":%.4f}",
+            name, summary.mean, summary.min, summary.p50, summary.p95, summary.p99, summary.max);
+}
+
+void printBenchResult(BenchResult* result) {
+    const BenchScene* scene = result->scene;
+    int frames = result->frames.count;
+
+    printf("{\"scene\":\"%s\",\"region_depth\":%d,\"regions\":[%d,%d,%d],\"frames\":%d",
+            scene->name, REGION_MCUBE_DEPTH, scene->width, scene->height, scene->depth, frames);
+
+    printBenchTimes("frame_ms", &(result->frames));
+    if (result->cpuTimes != NULL)
+        printBenchTimes("cpu_ms", result->cpuTimes);
+    if (result->gpuTimes != NULL)
+        printBenchTimes("gpu_ms", result->gpuTimes);
+
+    double meshSeconds = result->meshTime / 1000.0;
+
+    printf(",\"generate_ms\":%.2f,\"mesh\":{\"ms\":%.2f,\"regions\":%d,\"faces\":%llu,\"clear_faces\":%llu,\"regions_per_s\":%.1f,\"faces_per_s\":%.0f}",
+            result->generateTime, result->meshTime, result->regionCount,
+            (unsigned long long) result->faces, (unsigned long long) result->clearFaces,
+            meshSeconds > 0.0 ? result->regionCount / meshSeconds : 0.0,
+            meshSeconds > 0.0 ? result->faces / meshSeconds : 0.0);
+
+    MeshCounters* counters = &(result->counters);
+
+    printf(",\"upload_bytes\":%llu,\"uploads\":%llu,\"draw_calls_per_frame\":%.1f,\"faces_per_frame\":%.0f",
+            (unsigned long long) counters->uploadBytes, (unsigned long long) counters->uploads,
+            frames > 0 ? (double) counters->drawCalls / frames : 0.0,
+            frames > 0 ? (double) counters->drawnFaces / frames : 0.0);
+
+    printf(",\"cull\":{\"kernel\":\"%s\",\"cells_per_ns\":{", getCullKernelName(result->cullKernel));
+
+    int first = 1;
+    for (int i = 0; i < CULL_KERNEL_COUNT; i++) {
+        if (result->cullRates[i] <= 0.0)
+            continue;
+
+        printf("%s\"%s\":%.3f", first ? "" : ",", getCullKernelName(i), result->cullRates[i]);
+        first = 0;
+    }
+
+    printf("}}");
+
+    printBenchTimes("section_ms", &(result->sectionTimes));
+
+    printf(",\"bodies\":%d", result->bodyCount);
+    printBenchTimes("physics_tick_ms", &(result->tickTimes));
+
+    printBenchTimes("place_ms", &(result->placeTimes));
+    printBenchTimes("remove_ms", &(result->removeTimes));
+    printBenchTimes("lamp_place_ms", &(result->lampPlaceTimes));
+    printBenchTimes("lamp_remove_ms", &(result->lampRemoveTimes));
+
+    printf(",\"memory\":{\"total\":%zu", getMemoryTotal(&(result->memory)));
+
+    for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+        printf(",\"");
+
+        // Category names with underscores
+        for (const char* c = getMemoryCategoryName(i); *c != '\0'; c++)
+            putchar(*c == ' ' ? '_' : *c);
+
+        printf("\":%zu", result->memory.bytes[i]);
+    }
+
+    printf("}}\n");
+    fflush(stdout);
+}
+
+void freeBenchResult(BenchResult* result) {
+    freeFrameTimes(&(result->frames));
+    freeFrameTimes(&(result->sectionTimes));
+    freeFrameTimes(&(result->tickTimes));
+    freeFrameTimes(&(result->placeTimes));
+    freeFrameTimes(&(result->removeTimes));
+    freeFrameTimes(&(result->lampPlaceTimes));
+    freeFrameTimes(&(result->lampRemoveTimes));
+}
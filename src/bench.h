@@ -0,0 +1,153 @@
+#include <stdint.h>
+#include <cglm/struct.h>
+
+#include "region.h"
+#include "mesh.h"
+#include "pacing.h"
+#include "memstats.h"
+#include "cull.h"
+
+#ifndef BENCH_H
+#define BENCH_H
+
+/**
+ * A generated world and the loop the camera
+ * flies around it for --bench.
+ *
+ */
+typedef struct _benchScene {
+    const char* name;
+
+    // Size of the world in regions
+    int width;
+    int height;
+    int depth;
+
+    // Ticks the camera takes to fly the loop,
+    // which is also how many frames are drawn
+    int ticks;
+} BenchScene;
+
+/**
+ * Finds a scene by name. Returns NULL if there
+ * is none.
+ *
+ */
+const BenchScene* getBenchScene(const char* name);
+
+/**
+ * Prints the scene names, for when one wasn't
+ * found.
+ *
+ */
+void printBenchScenes();
+
+/**
+ * Generates the terrain of a scene, links the
+ * regions and lights them. Nothing is meshed.
+ * Regions are ordered x, then z, then y.
+ *
+ * Returns the regions and sets count.
+ */
+Region** generateBenchWorld(const BenchScene* scene, int* count);
+
+/**
+ * Where the camera is on its loop at a tick, in
+ * the same space as the regions.
+ *
+ */
+void getBenchCamera(const BenchScene* scene, int tick, vec3s* position, float* yaw, float* pitch);
+
+/**
+ * Everything measured over a run, times are in
+ * milliseconds.
+ *
+ */
+typedef struct _benchResult {
+    const BenchScene* scene;
+    int regionCount;
+
+    // Making and lighting the world, then
+    // meshing all of it
+    double generateTime;
+    double meshTime;
+    uint64_t faces;
+    // Faces of transparent cubes, not in faces
+    uint64_t clearFaces;
+
+    // Present to present
+    FrameTimes frames;
+
+    // Only set when drawing headless
+    FrameTimes* cpuTimes;
+    FrameTimes* gpuTimes;
+
+    MeshCounters counters;
+    MemoryStats memory;
+
+    // Mini cubes culled a nanosecond by each
+    // kernel, 0 where the CPU doesn't have it
+    enum CullKernel cullKernel;
+    double cullRates[CULL_KERNEL_COUNT];
+
+    // Building one section on one thread
+    FrameTimes sectionTimes;
+
+    // One tick of every body
+    int bodyCount;
+    FrameTimes tickTimes;
+
+    // Placing a cube on the ground and taking it
+    // away again, each one edit with its relight.
+    // Lamps light everything around them so they
+    // are timed on their own.
+    FrameTimes placeTimes;
+    FrameTimes removeTimes;
+    FrameTimes lampPlaceTimes;
+    FrameTimes lampRemoveTimes;
+} BenchResult;
+
+/**
+ * Times each face culling kernel on some of the
+ * regions that have a surface, culled a section
+ * at a time the same as the mesher, filling in
+ * the result's cull rates.
+ *
+ */
+void measureCullKernels(BenchResult* result, Region** regions, int count);
+
+/**
+ * Builds every section of some of the regions
+ * that have a surface, one at a time on this
+ * thread, timing each build.
+ *
+ */
+void measureMeshing(BenchResult* result, Region** regions, int count);
+
+/**
+ * Drops bodies the size of the player onto the
+ * terrain and walks them in circles, timing each
+ * tick of all of them.
+ *
+ */
+void measurePhysics(BenchResult* result, Region** regions, int count);
+
+/**
+ * Places a cube and then a lamp on the ground at
+ * spots around the world, taking each away again,
+ * timing every edit with the relight it causes.
+ * The cubes are the same afterwards, the edited
+ * regions are remeshed.
+ *
+ */
+void measureEdits(BenchResult* result, Region** regions, int count);
+
+/**
+ * Prints the result as one line of JSON.
+ *
+ */
+void printBenchResult(BenchResult* result);
+
+void freeBenchResult(BenchResult* result);
+
+#endif
@@ -39,6 +39,7 @@ Camera* initCamera() {
     result->yaw = -90.0f;
     result->pitch = 0.0f;
     result->position = (vec3s) {.x = 0.0f, .y = 0.0f, .z = 0.0f};
+    result->lastPosition = result->position;
     result->up = (vec3s) {.x = 0.0f, .y = 1.0f, .z = 0.0f};
     result->front = (vec3s) {.x = 0.0f, .y = 0.0f, .z = 0.0f};
 
@@ -51,14 +52,16 @@ Camera* initCamera() {
  * Gets the view matrix of the camera
  *
  */
-void getView(Camera* camPtr, mat4 view) {
+void getView(Camera* camPtr, float alpha, mat4 view) {
     setFront(camPtr);
 
-    vec3s dir = {.x = camPtr->position.x + camPtr->front.x,
-                 .y = camPtr->position.y + camPtr->front.y,
-                 .z = camPtr->position.z + camPtr->front.z};
+    vec3s position = glms_vec3_lerp(camPtr->lastPosition, camPtr->position, alpha);
 
-    glm_lookat(camPtr->position.raw, dir.raw, camPtr->up.raw, view);
+    vec3s dir = {.x = position.x + camPtr->front.x,
+                 .y = position.y + camPtr->front.y,
+                 .z = position.z + camPtr->front.z};
+
+    glm_lookat(position.raw, dir.raw, camPtr->up.raw, view);
 }
 
 /**
@@ -66,49 +69,96 @@ void getView(Camera* camPtr, mat4 view) {
  * based on player mouse events.
  *
  */
-void updateCameraLook(Camera *camPtr, SDL_Event event, float deltaTime) {
-    float sensitivity = 5.0f;
+void updateCameraLook(Camera *camPtr, SDL_Event event) {
+    // Degrees per pixel, about what it was when
+    // it was scaled by a 60 fps frame
+    float sensitivity = 0.08f;
 
     if (event.type == SDL_MOUSEMOTION) {
-        camPtr->yaw += event.motion.xrel * sensitivity * deltaTime;
-        camPtr->pitch += event.motion.yrel * sensitivity * deltaTime;
+        camPtr->yaw += event.motion.xrel * sensitivity;
+        camPtr->pitch += event.motion.yrel * sensitivity;
 
         camPtr->pitch = glm_clamp(camPtr->pitch, -89.0f, 89.0f);
     }
 }
 
+void turnCamera(Camera* camPtr, float yaw, float pitch) {
+    camPtr->yaw = yaw;
+    camPtr->pitch = glm_clamp(pitch, -89.0f, 89.0f);
+
+    setFront(camPtr);
+}
+
 /**
  * Updates the camera's position 
  * based on keyboard input.
  *
  */
 void updateCameraMovement(Camera *camPtr, float deltaTime) {
-    float speed = 5.0f;
-    vec3s direction = {.x = 0.0f, .y = 0.0f, .z = 0.0f};
+    vec3s move = getCameraMovement(camPtr, getCameraKeys(), deltaTime);
+
+    moveCamera(camPtr, glms_vec3_add(camPtr->position, move));
+}
 
+int getCameraKeys() {
     const Uint8* keyState = SDL_GetKeyboardState(NULL);
+    int keys = 0;
+
+    if (keyState[SDL_SCANCODE_W])
+        keys |= CAMERA_FORWARD;
+    if (keyState[SDL_SCANCODE_S])
+        keys |= CAMERA_BACK;
+    if (keyState[SDL_SCANCODE_A])
+        keys |= CAMERA_LEFT;
+    if (keyState[SDL_SCANCODE_D])
+        keys |= CAMERA_RIGHT;
+    if (keyState[SDL_SCANCODE_SPACE])
+        keys |= CAMERA_UP;
+    if (keyState[SDL_SCANCODE_LSHIFT])
+        keys |= CAMERA_DOWN;
+
+    return keys;
+}
 
-    if (keyState[SDL_SCANCODE_W]) 
+/**
+ * Works out the camera's movement based on
+ * the keys held.
+ *
+ */
+vec3s getCameraMovement(Camera *camPtr, int keys, float deltaTime) {
+    float speed = 5.0f;
+    vec3s direction = {.x = 0.0f, .y = 0.0f, .z = 0.0f};
+
+    if (keys & CAMERA_FORWARD)
         direction.z = 1.0f;
-    else if (keyState[SDL_SCANCODE_S])
+    else if (keys & CAMERA_BACK)
         direction.z = -1.0f;
 
-    if (keyState[SDL_SCANCODE_D]) 
+    if (keys & CAMERA_RIGHT)
         direction.x = 1.0f;
-    else if (keyState[SDL_SCANCODE_A])
+    else if (keys & CAMERA_LEFT)
         direction.x = -1.0f;
 
-    if (keyState[SDL_SCANCODE_SPACE])
+    if (keys & CAMERA_UP)
         direction.y = 1.0f;
 
-    else if (keyState[SDL_SCANCODE_LSHIFT])
+    else if (keys & CAMERA_DOWN)
         direction.y = -1.0f;
 
     float frontMove = speed * deltaTime * direction.z;
     float sideMove = speed * deltaTime * direction.x;
     float yMove = speed * deltaTime * direction.y;
 
-    glm_vec3_add(glms_vec3_mul(glms_vec3_normalize(glms_vec3_cross(camPtr->front, camPtr->up)), (vec3s) {.x = sideMove, .y = 0.0f, .z = sideMove}).raw, camPtr->position.raw, camPtr->position.raw);
-    glm_vec3_add(glms_vec3_mul(camPtr->front, (vec3s) {.x = frontMove, .y = 0.0f, .z = frontMove}).raw, camPtr->position.raw, camPtr->position.raw);
-    glm_vec3_add(camPtr->position.raw, (vec3s) {.x = 0.0f, .y = yMove, .z = 0.0f}.raw, camPtr->position.raw);
+    vec3s move = {.x = 0.0f, .y = 0.0f, .z = 0.0f};
+
+    glm_vec3_add(glms_vec3_mul(glms_vec3_normalize(glms_vec3_cross(camPtr->front, camPtr->up)), (vec3s) {.x = sideMove, .y = 0.0f, .z = sideMove}).raw, move.raw, move.raw);
+    glm_vec3_add(glms_vec3_mul(camPtr->front, (vec3s) {.x = frontMove, .y = 0.0f, .z = frontMove}).raw, move.raw, move.raw);
+    glm_vec3_add(move.raw, (vec3s) {.x = 0.0f, .y = yMove, .z = 0.0f}.raw, move.raw);
+
+    return move;
+}
+
+void moveCamera(Camera* camPtr, vec3s position) {
+    camPtr->lastPosition = camPtr->position;
+    camPtr->position = position;
 }
@@ -11,13 +11,74 @@ typedef struct _camera {
     vec3s position;
     vec3s front;
     vec3s up;
+
+    // Position before the last simulation tick,
+    // frames are drawn between the two
+    vec3s lastPosition;
 } Camera;
 
+/**
+ * Movement keys held during a simulation tick,
+ * kept as bits so they can be recorded.
+ *
+ */
+enum CameraKey {
+    CAMERA_FORWARD = 1,
+    CAMERA_BACK = 2,
+    CAMERA_LEFT = 4,
+    CAMERA_RIGHT = 8,
+    CAMERA_UP = 16,
+    CAMERA_DOWN = 32
+};
+
 Camera* initCamera();
 
-void getView(Camera* camPtr, mat4 view);
+/**
+ * Gets the view matrix with the position blended
+ * from the last tick to the current one by alpha.
+ *
+ */
+void getView(Camera* camPtr, float alpha, mat4 view);
+
+/**
+ * Look follows the mouse as events come in, the
+ * sensitivity is per pixel so it doesn't depend
+ * on the frame or tick rate.
+ *
+ */
+void updateCameraLook(Camera* camPtr, SDL_Event event);
+
+/**
+ * Points the camera, the direction it moves in
+ * follows straight away.
+ *
+ */
+void turnCamera(Camera* camPtr, float yaw, float pitch);
 
-void updateCameraLook(Camera* camPtr, SDL_Event event, float deltaTime);
+/**
+ * Moves the camera for one simulation tick.
+ *
+ */
 void updateCameraMovement(Camera* camPtr, float deltaTime);
 
+/**
+ * Reads which movement keys are held.
+ *
+ */
+int getCameraKeys();
+
+/**
+ * How far the keys move the camera in one
+ * simulation tick, without moving it.
+ *
+ */
+vec3s getCameraMovement(Camera* camPtr, int keys, float deltaTime);
+
+/**
+ * Ends a simulation tick at the given position,
+ * the old one is kept to blend frames from.
+ *
+ */
+void moveCamera(Camera* camPtr, vec3s position);
+
 #endif
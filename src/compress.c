@@ -0,0 +1,305 @@
+/**
+ * Packs the data of regions nobody has used for
+ * a while into runs of palette IDs, and unpacks
+ * it again the first time it is needed. Terrain
+ * packs to a few percent of its size.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "compress.h"
+#include "palette.h"
+#include "jobs.h"
+#include "arena.h"
+
+// Regions unused for this many frames are cold
+static const uint32_t COLD_FRAMES = 600;
+
+// How often the regions are looked over
+static const uint32_t COLD_SCAN_FRAMES = 60;
+
+// Regions this close to the eye are kept warm
+// since they are the likeliest to be edited
+static const float WARM_DISTANCE = 24.0f;
+
+// Longest run a pair can hold
+static const int MAX_RUN_LENGTH = UINT16_MAX;
+
+/**
+ * Runs of the same cube pointer found by a worker.
+ * They only become palette IDs on the main thread
+ * since the palette can grow there.
+ *
+ */
+typedef struct _cubeRun {
+    char* cubeID;
+    int length;
+} CubeRun;
+
+typedef struct _packJob {
+    Region* region;
+    uint64_t version;
+
+    // A reference to the data being packed
+    char** data;
+
+    // Stays -1 if it didn't pack small enough
+    int runCount;
+    CubeRun* runs;
+} PackJob;
+
+static size_t coldTarget = DEFAULT_COLD_REGION_TARGET;
+static uint32_t regionClock = 0;
+
+// Zeroed the same as initJobCounter leaves it
+static JobCounter packing;
+static int packsRunning = 0;
+
+static ColdRegionStats coldStats;
+
+static size_t getCellBytes() {
+    return (size_t) REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH * sizeof(char*);
+}
+
+void setColdRegionTarget(size_t bytes) {
+    coldTarget = bytes;
+}
+
+uint32_t getRegionClock() {
+    return regionClock;
+}
+
+void touchRegion(Region* reg) {
+    reg->lastUsed = regionClock;
+}
+
+size_t getPackedBytes(PackedCells* packed) {
+    return sizeof(PackedCells) + (size_t) packed->runCount * 2 * sizeof(uint16_t);
+}
+
+int unpackRegion(Region* reg) {
+    PackedCells* packed = reg->packed;
+
+    if (packed == NULL)
+        return 0;
+
+    char** data = allocRegionBlock(getCellBytes());
+    int index = 0;
+
+    for (int i = 0; i < packed->runCount; i++) {
+        char* cubeID = getPaletteCube(packed->runs[i * 2]);
+        int length = packed->runs[i * 2 + 1];
+
+        for (int j = 0; j < length; j++)
+            data[index++] = cubeID;
+    }
+
+    free(packed);
+    reg->packed = NULL;
+    reg->data = data;
+
+    touchRegion(reg);
+    coldStats.unpacked++;
+
+    return 1;
+}
+
+static void freePackJob(PackJob* job) {
+    releaseRegionBlock(job->data);
+    free(job->runs);
+    free(job);
+}
+
+/**
+ * Swaps the data for the runs on the main thread
+ * if the region wasn't changed while they were
+ * found.
+ *
+ */
+static void finishPack(void* data) {
+    PackJob* job = data;
+    Region* reg = job->region;
+
+    packsRunning--;
+
+    if (job->runCount < 0) {
+        // Not tried again until it goes cold again
+        touchRegion(reg);
+        coldStats.skipped++;
+        freePackJob(job);
+        return;
+    }
+
+    if (reg->version != job->version || reg->packed != NULL) {
+        freePackJob(job);
+        return;
+    }
+
+    PackedCells* packed = malloc(sizeof(PackedCells) + (size_t) job->runCount * 2 * sizeof(uint16_t));
+
+    if (packed == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate memory for program!\n");
+        exit(1);
+    }
+
+    // Different pointers to the same name join up
+    // once they are palette IDs. This is on the
+    // main thread, the palette never moves the
+    // entries the workers are reading.
+    packed->runCount = 0;
+
+    for (int i = 0; i < job->runCount; i++) {
+        uint16_t paletteID = getPaletteID(job->runs[i].cubeID);
+        int last = packed->runCount - 1;
+
+        if (last >= 0 && packed->runs[last * 2] == paletteID &&
+            packed->runs[last * 2 + 1] + job->runs[i].length <= MAX_RUN_LENGTH) {
+            packed->runs[last * 2 + 1] += job->runs[i].length;
+            continue;
+        }
+
+        packed->runs[packed->runCount * 2] = paletteID;
+        packed->runs[packed->runCount * 2 + 1] = job->runs[i].length;
+        packed->runCount++;
+    }
+
+    releaseRegionBlock(reg->data);
+    reg->data = NULL;
+    reg->packed = packed;
+
+    coldStats.packed++;
+    freePackJob(job);
+}
+
+static void packRegion(void* data) {
+    PackJob* job = data;
+
+    const int cells = REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH;
+
+    // Only worth keeping under a quarter of the size
+    const int maxRuns = (int) (getCellBytes() / 4 / (2 * sizeof(uint16_t)));
+
+    job->runs = malloc(maxRuns * sizeof(CubeRun));
+
+    if (job->runs == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate memory for program!\n");
+        exit(1);
+    }
+
+    int runCount = 0;
+
+    for (int i = 0; i < cells; ) {
+        char* cubeID = job->data[i];
+        int length = 1;
+
+        while (i + length < cells && length < MAX_RUN_LENGTH && job->data[i + length] == cubeID)
+            length++;
+
+        if (runCount == maxRuns) {
+            runCount = -1;
+            break;
+        }
+
+        job->runs[runCount++] = (CubeRun) {.cubeID = cubeID, .length = length};
+        i += length;
+    }
+
+    job->runCount = runCount;
+
+    runMainJob(finishPack, job, &packing);
+}
+
+static void startPack(Region* reg) {
+    PackJob* job = malloc(sizeof(PackJob));
+
+    if (job == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate memory for program!\n");
+        exit(1);
+    }
+
+    // The reference keeps the data as it is, any
+    // edit meanwhile copies it first
+    job->region = reg;
+    job->version = reg->version;
+    job->data = shareRegionBlock(reg->data);
+    job->runCount = -1;
+    job->runs = NULL;
+
+    packsRunning++;
+    runJob(packRegion, job, &packing);
+}
+
+static int compareLastUsed(const void* a, const void* b) {
+    const Region* regA = *(Region* const*) a;
+    const Region* regB = *(Region* const*) b;
+
+    // Oldest first, the clock only goes forward
+    uint32_t ageA = regionClock - regA->lastUsed;
+    uint32_t ageB = regionClock - regB->lastUsed;
+
+    return ageA < ageB ? 1 : (ageA > ageB ? -1 : 0);
+}
+
+void updateColdRegions(Region** regions, int count, vec3s eye) {
+    regionClock++;
+
+    if (regionClock % COLD_SCAN_FRAMES != 0 || packsRunning > 0)
+        return;
+
+    Arena* scratch = getScratchArena();
+    size_t mark = getArenaMark(scratch);
+    Region** cold = arenaAlloc(scratch, count * sizeof(Region*));
+    int coldCount = 0;
+
+    const float halfRegion = REGION_MCUBE_DEPTH * REGION_MCUBE_SIZE / 2.0f;
+    size_t resident = 0;
+
+    for (int i = 0; i < count; i++) {
+        Region* reg = regions[i];
+
+        if (reg->regType != MCUBED || reg->packed != NULL)
+            continue;
+
+        vec3s centre = reg->meshPtr->position;
+        centre.x += halfRegion;
+        centre.y += halfRegion;
+        centre.z += halfRegion;
+
+        vec3s offset = glms_vec3_sub(centre, eye);
+        if (glms_vec3_dot(offset, offset) < WARM_DISTANCE * WARM_DISTANCE)
+            touchRegion(reg);
+
+        resident += getCellBytes();
+
+        if (regionClock - reg->lastUsed >= COLD_FRAMES)
+            cold[coldCount++] = reg;
+    }
+
+    if (resident > coldTarget) {
+        qsort(cold, coldCount, sizeof(Region*), compareLastUsed);
+
+        for (int i = 0; i < coldCount && resident > coldTarget; i++) {
+            startPack(cold[i]);
+            resident -= getCellBytes();
+        }
+    }
+
+    rewindArena(scratch, mark);
+}
+
+void waitForColdRegions() {
+    waitForJobs(&packing);
+}
+
+ColdRegionStats getColdRegionStats() {
+    ColdRegionStats result = coldStats;
+    memset(&coldStats, 0, sizeof(ColdRegionStats));
+
+    return result;
+}
+
+void printColdRegionStats(ColdRegionStats* stats) {
+    fprintf(stderr, "Cold regions %d packed, %d unpacked, %d skipped\n", stats->packed, stats->unpacked, stats->skipped);
+}
@@ -0,0 +1,92 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <cglm/struct.h>
+
+#include "region.h"
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+// Unpacked MCUBED data kept around by default
+#define DEFAULT_COLD_REGION_TARGET (512u * 1024u * 1024u)
+
+/**
+ * The data of a cold region as runs of palette
+ * IDs in data order.
+ *
+ */
+typedef struct _packedCells {
+    int runCount;
+    // Each run is a palette ID then a length
+    uint16_t runs[];
+} PackedCells;
+
+/**
+ * What the cold region pass did since the stats
+ * were last read.
+ *
+ */
+typedef struct _coldRegionStats {
+    int packed;
+    int unpacked;
+
+    // Cold but not worth packing
+    int skipped;
+} ColdRegionStats;
+
+/**
+ * Bytes of unpacked MCUBED data to keep before
+ * the coldest regions are packed.
+ *
+ */
+void setColdRegionTarget(size_t bytes);
+
+/**
+ * Frames counted by updateColdRegions, regions
+ * remember the last one they were used in.
+ *
+ */
+uint32_t getRegionClock();
+void touchRegion(Region* reg);
+
+/**
+ * Call once a frame from the main thread. Every
+ * so often the regions that have gone longest
+ * without being used are packed on the job
+ * workers until the unpacked data fits the
+ * target. Regions near the eye count as used.
+ * The eye is in the same space as the regions.
+ *
+ * A region can't be freed while it is packing.
+ */
+void updateColdRegions(Region** regions, int count, vec3s eye);
+
+/**
+ * Puts the data of a packed region back, only
+ * from the thread that edits it. Returns 1 if
+ * it was packed.
+ *
+ */
+int unpackRegion(Region* reg);
+
+/**
+ * Bytes held by a packed region's runs.
+ *
+ */
+size_t getPackedBytes(PackedCells* packed);
+
+/**
+ * Runs jobs until every region being packed is
+ * done.
+ *
+ */
+void waitForColdRegions();
+
+/**
+ * Reads and restarts the stats.
+ *
+ */
+ColdRegionStats getColdRegionStats();
+void printColdRegionStats(ColdRegionStats* stats);
+
+#endif
@@ -0,0 +1,369 @@
+/**
+ * Works out which faces of a run of occupancy
+ * rows can be seen. Each face is the solid bits
+ * with the row beside them shifted over and
+ * masked off, so the vector kernels do a register
+ * of rows at a time.
+ *
+ */
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "cull.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CULL_X86
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define CULL_ARM
+#include <arm_neon.h>
+#endif
+
+typedef void (*CullFunction)(const CullRows* rows, int count, RegionRow mask, RegionRow visible[6][CULL_MAX_ROWS]);
+
+static const char* CULL_KERNEL_NAMES[CULL_KERNEL_COUNT] = {
+    "scalar",
+    "sse2",
+    "avx2",
+    "neon"
+};
+
+// Rows past a missing neighbor
+static const RegionRow AIR_ROWS[CULL_MAX_ROWS];
+
+// Picked on first use, -1 until then
+static int currentKernel = -1;
+
+#if defined(CULL_X86) || defined(CULL_ARM)
+
+/**
+ * The same rows starting further along.
+ *
+ */
+static CullRows skipRows(const CullRows* rows, int skip) {
+    return (CullRows) {
+        .rows = rows->rows + skip,
+        .above = rows->above + skip,
+        .below = rows->below + skip,
+        .left = rows->left + skip,
+        .right = rows->right + skip
+    };
+}
+
+/**
+ * Culls the rows from done on with a kernel for
+ * shorter runs. When nothing was done yet they go
+ * straight into visible, which is how sections
+ * shorter than a register get culled.
+ *
+ */
+static void cullRest(CullFunction function, const CullRows* rows, int done, int count, RegionRow mask, RegionRow visible[6][CULL_MAX_ROWS]) {
+    if (done == count)
+        return;
+
+    if (done == 0) {
+        function(rows, count, mask, visible);
+        return;
+    }
+
+    CullRows rest = skipRows(rows, done);
+    RegionRow restVisible[6][CULL_MAX_ROWS];
+
+    function(&rest, count - done, mask, restVisible);
+
+    for (int face = 0; face < 6; face++)
+        memcpy(&(visible[face][done]), restVisible[face], (count - done) * sizeof(RegionRow));
+}
+
+#endif
+
+static void cullScalar(const CullRows* rows, int count, RegionRow mask, RegionRow visible[6][CULL_MAX_ROWS]) {
+    const int lastX = REGION_MCUBE_DEPTH - 1;
+
+    for (int i = 0; i < count; i++) {
+        RegionRow row = rows->rows[i];
+        RegionRow solid = row & mask;
+
+        visible[TOP][i] = solid & ~rows->above[i];
+        visible[BOTTOM][i] = solid & ~rows->below[i];
+        visible[FRONT][i] = solid & ~rows->rows[i + 1];
+        visible[BACK][i] = solid & ~rows->rows[i - 1];
+
+        // The cubes past either end of the row are
+        // in the left and right regions
+        visible[LEFT][i] = solid & ~((RegionRow) (row << 1) | (RegionRow) (rows->left[i] >> lastX));
+        visible[RIGHT][i] = solid & ~((RegionRow) (row >> 1) | (RegionRow) (rows->right[i] << lastX));
+    }
+}
+
+#ifdef CULL_X86
+
+// Lane sized to the rows
+#if REGION_MCUBE_DEPTH == 16
+#define SET1_128(v) _mm_set1_epi16((short) (v))
+#define SLLI_128 _mm_slli_epi16
+#define SRLI_128 _mm_srli_epi16
+#define SET1_256(v) _mm256_set1_epi16((short) (v))
+#define SLLI_256 _mm256_slli_epi16
+#define SRLI_256 _mm256_srli_epi16
+#elif REGION_MCUBE_DEPTH == 32
+#define SET1_128(v) _mm_set1_epi32((int) (v))
+#define SLLI_128 _mm_slli_epi32
+#define SRLI_128 _mm_srli_epi32
+#define SET1_256(v) _mm256_set1_epi32((int) (v))
+#define SLLI_256 _mm256_slli_epi32
+#define SRLI_256 _mm256_srli_epi32
+#else
+#define SET1_128(v) _mm_set1_epi64x((long long) (v))
+#define SLLI_128 _mm_slli_epi64
+#define SRLI_128 _mm_srli_epi64
+#define SET1_256(v) _mm256_set1_epi64x((long long) (v))
+#define SLLI_256 _mm256_slli_epi64
+#define SRLI_256 _mm256_srli_epi64
+#endif
+
+__attribute__((target("sse2")))
+static void cullSSE2(const CullRows* rows, int count, RegionRow mask, RegionRow visible[6][CULL_MAX_ROWS]) {
+    const int lanes = sizeof(__m128i) / sizeof(RegionRow);
+    const int lastX = REGION_MCUBE_DEPTH - 1;
+    const __m128i masks = SET1_128(mask);
+
+    int i = 0;
+    for (; i + lanes <= count; i += lanes) {
+        __m128i row = _mm_loadu_si128((const __m128i*) &(rows->rows[i]));
+        __m128i solid = _mm_and_si128(row, masks);
+
+        __m128i above = _mm_loadu_si128((const __m128i*) &(rows->above[i]));
+        __m128i below = _mm_loadu_si128((const __m128i*) &(rows->below[i]));
+        __m128i front = _mm_loadu_si128((const __m128i*) &(rows->rows[i + 1]));
+        __m128i back = _mm_loadu_si128((const __m128i*) &(rows->rows[i - 1]));
+        __m128i left = _mm_or_si128(SLLI_128(row, 1), SRLI_128(_mm_loadu_si128((const __m128i*) &(rows->left[i])), lastX));
+        __m128i right = _mm_or_si128(SRLI_128(row, 1), SLLI_128(_mm_loadu_si128((const __m128i*) &(rows->right[i])), lastX));
+
+        _mm_storeu_si128((__m128i*) &(visible[TOP][i]), _mm_andnot_si128(above, solid));
+        _mm_storeu_si128((__m128i*) &(visible[BOTTOM][i]), _mm_andnot_si128(below, solid));
+        _mm_storeu_si128((__m128i*) &(visible[FRONT][i]), _mm_andnot_si128(front, solid));
+        _mm_storeu_si128((__m128i*) &(visible[BACK][i]), _mm_andnot_si128(back, solid));
+        _mm_storeu_si128((__m128i*) &(visible[LEFT][i]), _mm_andnot_si128(left, solid));
+        _mm_storeu_si128((__m128i*) &(visible[RIGHT][i]), _mm_andnot_si128(right, solid));
+    }
+
+    cullRest(cullScalar, rows, i, count, mask, visible);
+}
+
+__attribute__((target("avx2")))
+static void cullAVX2(const CullRows* rows, int count, RegionRow mask, RegionRow visible[6][CULL_MAX_ROWS]) {
+    const int lanes = sizeof(__m256i) / sizeof(RegionRow);
+    const int lastX = REGION_MCUBE_DEPTH - 1;
+    const __m256i masks = SET1_256(mask);
+
+    int i = 0;
+    for (; i + lanes <= count; i += lanes) {
+        __m256i row = _mm256_loadu_si256((const __m256i*) &(rows->rows[i]));
+        __m256i solid = _mm256_and_si256(row, masks);
+
+        __m256i above = _mm256_loadu_si256((const __m256i*) &(rows->above[i]));
+        __m256i below = _mm256_loadu_si256((const __m256i*) &(rows->below[i]));
+        __m256i front = _mm256_loadu_si256((const __m256i*) &(rows->rows[i + 1]));
+        __m256i back = _mm256_loadu_si256((const __m256i*) &(rows->rows[i - 1]));
+        __m256i left = _mm256_or_si256(SLLI_256(row, 1), SRLI_256(_mm256_loadu_si256((const __m256i*) &(rows->left[i])), lastX));
+        __m256i right = _mm256_or_si256(SRLI_256(row, 1), SLLI_256(_mm256_loadu_si256((const __m256i*) &(rows->right[i])), lastX));
+
+        _mm256_storeu_si256((__m256i*) &(visible[TOP][i]), _mm256_andnot_si256(above, solid));
+        _mm256_storeu_si256((__m256i*) &(visible[BOTTOM][i]), _mm256_andnot_si256(below, solid));
+        _mm256_storeu_si256((__m256i*) &(visible[FRONT][i]), _mm256_andnot_si256(front, solid));
+        _mm256_storeu_si256((__m256i*) &(visible[BACK][i]), _mm256_andnot_si256(back, solid));
+        _mm256_storeu_si256((__m256i*) &(visible[LEFT][i]), _mm256_andnot_si256(left, solid));
+        _mm256_storeu_si256((__m256i*) &(visible[RIGHT][i]), _mm256_andnot_si256(right, solid));
+    }
+
+    // Whatever is left fits in SSE registers or
+    // is too short for them
+    cullRest(cullSSE2, rows, i, count, mask, visible);
+}
+
+#endif
+
+#ifdef CULL_ARM
+
+#if REGION_MCUBE_DEPTH == 16
+#define NEON_ROWS uint16x8_t
+#define NEON_LOAD(p) vld1q_u16(p)
+#define NEON_STORE(p, v) vst1q_u16(p, v)
+#define NEON_DUP(v) vdupq_n_u16(v)
+#define NEON_SHL vshlq_n_u16
+#define NEON_SHR vshrq_n_u16
+#define NEON_AND vandq_u16
+#define NEON_ORR vorrq_u16
+#define NEON_BIC vbicq_u16
+#elif REGION_MCUBE_DEPTH == 32
+#define NEON_ROWS uint32x4_t
+#define NEON_LOAD(p) vld1q_u32(p)
+#define NEON_STORE(p, v) vst1q_u32(p, v)
+#define NEON_DUP(v) vdupq_n_u32(v)
+#define NEON_SHL vshlq_n_u32
+#define NEON_SHR vshrq_n_u32
+#define NEON_AND vandq_u32
+#define NEON_ORR vorrq_u32
+#define NEON_BIC vbicq_u32
+#else
+#define NEON_ROWS uint64x2_t
+#define NEON_LOAD(p) vld1q_u64(p)
+#define NEON_STORE(p, v) vst1q_u64(p, v)
+#define NEON_DUP(v) vdupq_n_u64(v)
+#define NEON_SHL vshlq_n_u64
+#define NEON_SHR vshrq_n_u64
+#define NEON_AND vandq_u64
+#define NEON_ORR vorrq_u64
+#define NEON_BIC vbicq_u64
+#endif
+
+static void cullNEON(const CullRows* rows, int count, RegionRow mask, RegionRow visible[6][CULL_MAX_ROWS]) {
+    const int lanes = sizeof(NEON_ROWS) / sizeof(RegionRow);
+    const NEON_ROWS masks = NEON_DUP(mask);
+
+    int i = 0;
+    for (; i + lanes <= count; i += lanes) {
+        NEON_ROWS row = NEON_LOAD(&(rows->rows[i]));
+        NEON_ROWS solid = NEON_AND(row, masks);
+
+        // Shifts take constants so the last bit is
+        // spelled out
+        NEON_ROWS left = NEON_ORR(NEON_SHL(row, 1), NEON_SHR(NEON_LOAD(&(rows->left[i])), REGION_MCUBE_DEPTH - 1));
+        NEON_ROWS right = NEON_ORR(NEON_SHR(row, 1), NEON_SHL(NEON_LOAD(&(rows->right[i])), REGION_MCUBE_DEPTH - 1));
+
+        NEON_STORE(&(visible[TOP][i]), NEON_BIC(solid, NEON_LOAD(&(rows->above[i]))));
+        NEON_STORE(&(visible[BOTTOM][i]), NEON_BIC(solid, NEON_LOAD(&(rows->below[i]))));
+        NEON_STORE(&(visible[FRONT][i]), NEON_BIC(solid, NEON_LOAD(&(rows->rows[i + 1]))));
+        NEON_STORE(&(visible[BACK][i]), NEON_BIC(solid, NEON_LOAD(&(rows->rows[i - 1]))));
+        NEON_STORE(&(visible[LEFT][i]), NEON_BIC(solid, left));
+        NEON_STORE(&(visible[RIGHT][i]), NEON_BIC(solid, right));
+    }
+
+    cullRest(cullScalar, rows, i, count, mask, visible);
+}
+
+#endif
+
+// NULL where the kernel isn't built for this CPU
+static const CullFunction CULL_FUNCTIONS[CULL_KERNEL_COUNT] = {
+    [CULL_SCALAR] = cullScalar,
+#ifdef CULL_X86
+    [CULL_SSE2] = cullSSE2,
+    [CULL_AVX2] = cullAVX2,
+#endif
+#ifdef CULL_ARM
+    [CULL_NEON] = cullNEON,
+#endif
+};
+
+int isCullKernelSupported(enum CullKernel kernel) {
+    if (kernel < 0 || kernel >= CULL_KERNEL_COUNT || CULL_FUNCTIONS[kernel] == NULL)
+        return 0;
+
+    switch (kernel) {
+        case CULL_SSE2:
+            return SDL_HasSSE2();
+        case CULL_AVX2:
+            return SDL_HasAVX2();
+        case CULL_NEON:
+            return SDL_HasNEON();
+        default:
+            return 1;
+    }
+}
+
+int setCullKernel(enum CullKernel kernel) {
+    if (!isCullKernelSupported(kernel))
+        return 0;
+
+    __atomic_store_n(&currentKernel, kernel, __ATOMIC_RELAXED);
+    return 1;
+}
+
+enum CullKernel getCullKernel() {
+    int kernel = __atomic_load_n(&currentKernel, __ATOMIC_RELAXED);
+
+    if (kernel >= 0)
+        return kernel;
+
+    // Later kernels are wider, threads racing to
+    // pick one all pick the same
+    kernel = CULL_SCALAR;
+    for (int i = CULL_SCALAR + 1; i < CULL_KERNEL_COUNT; i++) {
+        if (isCullKernelSupported(i))
+            kernel = i;
+    }
+
+    __atomic_store_n(&currentKernel, kernel, __ATOMIC_RELAXED);
+    return kernel;
+}
+
+const char* getCullKernelName(enum CullKernel kernel) {
+    if (kernel < 0 || kernel >= CULL_KERNEL_COUNT)
+        return "unknown";
+
+    return CULL_KERNEL_NAMES[kernel];
+}
+
+int findCullKernel(const char* name) {
+    for (int i = 0; i < CULL_KERNEL_COUNT; i++) {
+        if (strcmp(CULL_KERNEL_NAMES[i], name) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+void cullRowsWith(enum CullKernel kernel, const CullRows* rows, int count, RegionRow mask, RegionRow visible[6][CULL_MAX_ROWS]) {
+    CULL_FUNCTIONS[kernel](rows, count, mask, visible);
+}
+
+void cullRows(const CullRows* rows, int count, RegionRow mask, RegionRow visible[6][CULL_MAX_ROWS]) {
+    CULL_FUNCTIONS[getCullKernel()](rows, count, mask, visible);
+}
+
+/**
+ * Rows count long at y in the region, or the
+ * layer above or below it in the next region.
+ *
+ */
+static const RegionRow* getLayerRows(Region* reg, enum OccupancyPlane plane, int y, int z0) {
+    if (y < 0) {
+        reg = reg->down;
+        y += REGION_MCUBE_DEPTH;
+    }
+    else if (y >= REGION_MCUBE_DEPTH) {
+        reg = reg->up;
+        y -= REGION_MCUBE_DEPTH;
+    }
+
+    if (reg == NULL)
+        return AIR_ROWS;
+
+    return &(getOccupancyPlane(reg, plane)[z0 + y * REGION_MCUBE_DEPTH]);
+}
+
+void getCullRows(Region* reg, enum OccupancyPlane plane, int y, int z0, int count, RegionRow* ends, CullRows* rows) {
+    const RegionRow* layer = &(getOccupancyPlane(reg, plane)[y * REGION_MCUBE_DEPTH]);
+
+    // Copied so the rows past either end sit
+    // next to the rest
+    memcpy(&(ends[1]), &(layer[z0]), count * sizeof(RegionRow));
+
+    if (z0 > 0)
+        ends[0] = layer[z0 - 1];
+    else
+        ends[0] = reg->back == NULL ? 0 : getOccupancyPlane(reg->back, plane)[REGION_MCUBE_DEPTH - 1 + y * REGION_MCUBE_DEPTH];
+
+    if (z0 + count < REGION_MCUBE_DEPTH)
+        ends[count + 1] = layer[z0 + count];
+    else
+        ends[count + 1] = reg->front == NULL ? 0 : getOccupancyPlane(reg->front, plane)[y * REGION_MCUBE_DEPTH];
+
+    rows->rows = &(ends[1]);
+    rows->above = getLayerRows(reg, plane, y + 1, z0);
+    rows->below = getLayerRows(reg, plane, y - 1, z0);
+    rows->left = reg->left == NULL ? AIR_ROWS : &(getOccupancyPlane(reg->left, plane)[z0 + y * REGION_MCUBE_DEPTH]);
+    rows->right = reg->right == NULL ? AIR_ROWS : &(getOccupancyPlane(reg->right, plane)[z0 + y * REGION_MCUBE_DEPTH]);
+}
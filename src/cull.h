@@ -0,0 +1,84 @@
+#include "region.h"
+
+#ifndef CULL_H
+#define CULL_H
+
+// Most rows one call can cull, a whole layer
+// of a region
+#define CULL_MAX_ROWS REGION_MCUBE_DEPTH
+
+/**
+ * Ways of working out visible faces, the vector
+ * ones are only there on CPUs that have them.
+ *
+ */
+enum CullKernel {
+    CULL_SCALAR,
+    CULL_SSE2,
+    CULL_AVX2,
+    CULL_NEON,
+    CULL_KERNEL_COUNT
+};
+
+/**
+ * Occupancy rows along z at one y, each array
+ * indexed from the first row being culled.
+ * rows[-1] and rows[count] must be the rows just
+ * past either end, the rest only need count.
+ *
+ */
+typedef struct _cullRows {
+    const RegionRow* rows;
+    const RegionRow* above;
+    const RegionRow* below;
+
+    // Rows of the regions to either side, only
+    // their last and first bits are used
+    const RegionRow* left;
+    const RegionRow* right;
+} CullRows;
+
+/**
+ * Points rows at one occupancy plane of count
+ * rows from z0 at y, taking the rows past the
+ * region from its neighbors. Missing neighbors
+ * are air. The ends buffer holds count + 2 rows
+ * and is where rows points into.
+ *
+ */
+void getCullRows(Region* reg, enum OccupancyPlane plane, int y, int z0, int count, RegionRow* ends, CullRows* rows);
+
+/**
+ * Sets each row of visible (indexed by CubeFace)
+ * to the solid bits within mask that have a clear
+ * bit beside them on that side. Uses the fastest
+ * kernel the CPU has unless one was set.
+ *
+ */
+void cullRows(const CullRows* rows, int count, RegionRow mask, RegionRow visible[6][CULL_MAX_ROWS]);
+void cullRowsWith(enum CullKernel kernel, const CullRows* rows, int count, RegionRow mask, RegionRow visible[6][CULL_MAX_ROWS]);
+
+/**
+ * Returns 1 if the kernel was built in and the
+ * CPU can run it.
+ *
+ */
+int isCullKernelSupported(enum CullKernel kernel);
+
+/**
+ * Picks the kernel cullRows uses. Returns 0 if it
+ * isn't supported, leaving the kernel as it was.
+ *
+ */
+int setCullKernel(enum CullKernel kernel);
+enum CullKernel getCullKernel();
+
+/**
+ * Names are lower case, scalar, sse2, avx2 and
+ * neon. Returns -1 for a name that isn't one.
+ *
+ */
+const char* getCullKernelName(enum CullKernel kernel);
+int findCullKernel(const char* name);
+
+#endif
@@ -0,0 +1,721 @@
+/**
+ * Bulk edits over boxes of mini cubes that can
+ * span many regions. The volume is split per
+ * region and written a row at a time, regions
+ * that are covered completely collapse back to
+ * FILLED. Remeshing is deferred until the end
+ * of the batch so every region is rebuilt once.
+ *
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "edit.h"
+#include "journal.h"
+#include "light.h"
+#include "remesh.h"
+#include "compress.h"
+
+enum EditKind {
+    EDIT_FILL,
+    EDIT_SPHERE,
+    EDIT_REPLACE,
+    EDIT_PASTE
+};
+
+// Off until the job workers are running
+static int remeshAsync = 0;
+
+typedef struct _editOp {
+    enum EditKind kind;
+
+    char* cubeID;
+
+    // EDIT_REPLACE only touches this ID
+    char* oldID;
+
+    // EDIT_SPHERE in anchor mini cube units
+    float center[3];
+    float radius;
+
+    // EDIT_PASTE
+    Volume* vol;
+    int origin[3];
+    int skipAir;
+} EditOp;
+
+static void sortCorners(vec3s from, vec3s to, int min[3], int max[3]) {
+    for (int i = 0; i < 3; i++) {
+        int a = floorf(from.raw[i]);
+        int b = floorf(to.raw[i]);
+        min[i] = a < b ? a : b;
+        max[i] = a < b ? b : a;
+    }
+}
+
+/**
+ * Which sides of a region a local box
+ * reaches as a mask of (1 << CubeFace).
+ *
+ */
+static int touchedFaces(int lo[3], int hi[3]) {
+    int faces = 0;
+
+    if (lo[0] == 0)
+        faces |= 1 << LEFT;
+    if (hi[0] == REGION_MCUBE_DEPTH - 1)
+        faces |= 1 << RIGHT;
+    if (lo[1] == 0)
+        faces |= 1 << BOTTOM;
+    if (hi[1] == REGION_MCUBE_DEPTH - 1)
+        faces |= 1 << TOP;
+    if (lo[2] == 0)
+        faces |= 1 << BACK;
+    if (hi[2] == REGION_MCUBE_DEPTH - 1)
+        faces |= 1 << FRONT;
+
+    return faces;
+}
+
+static void queueRemesh(EditBatch* batch, Region* reg) {
+    if (reg == NULL || reg->remeshQueued)
+        return;
+
+    if (batch->size == batch->capacity) {
+        int capacity = batch->capacity == 0 ? 16 : batch->capacity * 2;
+        Region** regions = realloc(batch->regions, capacity * sizeof(Region*));
+
+        if (regions == NULL) {
+            fprintf(stderr, "ERROR: unable to allocate memory for program!\n");
+            exit(1);
+        }
+
+        batch->regions = regions;
+        batch->capacity = capacity;
+    }
+
+    reg->remeshQueued = 1;
+    batch->regions[batch->size++] = reg;
+}
+
+void beginEdit(EditBatch* batch) {
+    batch->regions = NULL;
+    batch->size = 0;
+    batch->capacity = 0;
+}
+
+void endEdit(EditBatch* batch) {
+    for (int i = 0; i < batch->size; i++) {
+        batch->regions[i]->remeshQueued = 0;
+
+        if (remeshAsync)
+            startRegionRemesh(batch->regions[i]);
+        else
+            updateRegionSections(batch->regions[i]);
+    }
+
+    free(batch->regions);
+    batch->regions = NULL;
+    batch->size = 0;
+    batch->capacity = 0;
+}
+
+void setEditRemeshAsync(int async) {
+    remeshAsync = async;
+}
+
+void markRegionEdited(EditBatch* batch, Region* reg, int lo[3], int hi[3]) {
+    markRegionRemesh(batch, reg, lo, hi);
+    updateLight(batch, reg, lo, hi);
+}
+
+void markRegionRemesh(EditBatch* batch, Region* reg, int lo[3], int hi[3]) {
+    markRegionDirty(reg, lo, hi);
+    queueRemesh(batch, reg);
+
+    int faces = touchedFaces(lo, hi);
+
+    for (int face = FRONT; face <= BOTTOM; face++) {
+        if (faces & (1 << face))
+            queueRemesh(batch, getNeighbor(reg, face));
+    }
+}
+
+/**
+ * Runs of mini cubes in one region that changed
+ * in a way light can see, in scratch space while
+ * the region is edited. The last two cubes looked
+ * at keep their light class.
+ *
+ */
+typedef struct _lightChanges {
+    Arena* arena;
+    size_t mark;
+
+    CellRun* runs;
+    int count;
+    int capacity;
+
+    char* cubes[2];
+    int classes[2];
+    int next;
+} LightChanges;
+
+static void beginLightChanges(LightChanges* changes) {
+    changes->arena = getScratchArena();
+    changes->mark = getArenaMark(changes->arena);
+    changes->runs = NULL;
+    changes->count = 0;
+    changes->capacity = 0;
+    changes->cubes[0] = NULL;
+    changes->cubes[1] = NULL;
+    changes->next = 0;
+}
+
+static int getChangeClass(LightChanges* changes, char* cubeID) {
+    for (int i = 0; i < 2; i++) {
+        if (changes->cubes[i] == cubeID)
+            return changes->classes[i];
+    }
+
+    int slot = changes->next;
+    changes->next ^= 1;
+
+    changes->cubes[slot] = cubeID;
+    changes->classes[slot] = getCubeLightClass(cubeID);
+
+    return changes->classes[slot];
+}
+
+static void addLightChanges(LightChanges* changes, int start, int length) {
+    CellRun* last = changes->count > 0 ? &(changes->runs[changes->count - 1]) : NULL;
+
+    if (last != NULL && last->start + last->length == start) {
+        last->length += length;
+        return;
+    }
+
+    if (changes->count == changes->capacity) {
+        int capacity = changes->capacity == 0 ? 64 : changes->capacity * 2;
+        changes->runs = arenaResize(changes->arena, changes->runs, changes->capacity * sizeof(CellRun), capacity * sizeof(CellRun));
+        changes->capacity = capacity;
+    }
+
+    changes->runs[changes->count].start = start;
+    changes->runs[changes->count].length = length;
+    changes->count++;
+}
+
+/**
+ * Adds every mini cube of the region that filling
+ * it with the cube changes for light.
+ *
+ */
+static void addFillChanges(LightChanges* changes, Region* reg, char* cubeID) {
+    const int D = REGION_MCUBE_DEPTH;
+    int fillClass = getChangeClass(changes, cubeID);
+
+    if (reg->regType == FILLED) {
+        if (getChangeClass(changes, *(reg->data)) != fillClass)
+            addLightChanges(changes, 0, D * D * D);
+
+        return;
+    }
+
+    for (int y = 0; y < D; y++) {
+        for (int z = 0; z < D; z++) {
+            for (int x = 0; x < D; x++) {
+                if (getChangeClass(changes, getMCube(reg, x, y, z)) != fillClass)
+                    addLightChanges(changes, x + z * D + y * D * D, 1);
+            }
+        }
+    }
+}
+
+/**
+ * Remeshes the box an edit covered and relights
+ * only the mini cubes light can see changed.
+ *
+ */
+static void finishRegionEdit(EditBatch* batch, Region* reg, int lo[3], int hi[3], LightChanges* changes) {
+    markRegionRemesh(batch, reg, lo, hi);
+    updateLightRuns(batch, reg, changes->runs, changes->count);
+}
+
+/**
+ * What a row write puts in each mini cube, one
+ * cube for all of them or cells[x - x0] for
+ * each. Cells holding anything but onlyID are
+ * left alone when it is set, as is air in cells
+ * when skipAir is.
+ *
+ */
+typedef struct _rowWrite {
+    char* cubeID;
+    char** cells;
+    char* onlyID;
+    int skipAir;
+} RowWrite;
+
+static int changesCell(RowWrite* write, char* current, int i) {
+    char* cubeID = write->cells != NULL ? write->cells[i] : write->cubeID;
+
+    if (write->onlyID != NULL && !isSameCube(current, write->onlyID))
+        return 0;
+    if (write->skipAir && isSameCube(cubeID, AIR_CUBE))
+        return 0;
+
+    return !isSameCube(current, cubeID);
+}
+
+/**
+ * Writes a span of a row and keeps the
+ * occupancy row in step. The row is compared in
+ * place and only the runs that change are
+ * journaled and written, the region is expanded
+ * and made writable the first time there is one.
+ * Cells that change for light are added to
+ * changes.
+ *
+ * Returns 1 if anything changed.
+ */
+static int writeRow(Region* reg, int y, int z, int x0, int x1, RowWrite* write, LightChanges* changes) {
+    const int rowStart = z * REGION_MCUBE_DEPTH + y * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH;
+
+    // Never made, but only FILLED and MCUBED can
+    // be read a row at a time
+    if (reg->regType == CUBED)
+        expandRegion(reg);
+
+    unpackRegion(reg);
+
+    // Filled regions are compared against their
+    // one cube until something changes
+    char** row = reg->regType == MCUBED ? &(reg->data[rowStart]) : NULL;
+    char* fill = *(reg->data);
+
+    int changed = 0;
+    int x = x0;
+
+    while (x <= x1) {
+        if (!changesCell(write, row != NULL ? row[x] : fill, x - x0)) {
+            x++;
+            continue;
+        }
+
+        int end = x;
+        while (end < x1 && changesCell(write, row != NULL ? row[end + 1] : fill, end + 1 - x0))
+            end++;
+
+        int length = end - x + 1;
+
+        if (!changed) {
+            expandRegion(reg);
+            makeRegionWritable(reg, REGION_BLOCK_DATA);
+            row = &(reg->data[rowStart]);
+        }
+
+        for (int i = x; i <= end; i++) {
+            char* cubeID = write->cells != NULL ? write->cells[i - x0] : write->cubeID;
+
+            if (getChangeClass(changes, row[i]) != getChangeClass(changes, cubeID))
+                addLightChanges(changes, rowStart + i, 1);
+        }
+
+        if (write->cells != NULL) {
+            char** cells = &(write->cells[x - x0]);
+
+            journalRecordCubes(reg, rowStart + x, length, cells);
+            memcpy(&(row[x]), cells, length * sizeof(char*));
+
+            // Occupancy is set for each run of the
+            // same cube
+            for (int i = x; i <= end;) {
+                int same = i;
+                while (same < end && row[same + 1] == row[i])
+                    same++;
+
+                setOccupancyBits(reg, y, z, getRowMask(i, same), row[i]);
+                i = same + 1;
+            }
+        }
+        else {
+            journalRecordCells(reg, rowStart + x, length, write->cubeID);
+
+            for (int i = x; i <= end; i++)
+                row[i] = write->cubeID;
+
+            setOccupancyBits(reg, y, z, getRowMask(x, end), write->cubeID);
+        }
+
+        changed = 1;
+        x = end + 1;
+    }
+
+    return changed;
+}
+
+static int fillRow(Region* reg, int y, int z, int x0, int x1, char* cubeID, LightChanges* changes) {
+    RowWrite write = {.cubeID = cubeID, .cells = NULL, .onlyID = NULL, .skipAir = 0};
+
+    return writeRow(reg, y, z, x0, x1, &write, changes);
+}
+
+int setMCubeRow(EditBatch* batch, Region* reg, int y, int z, int x0, int x1, char* cubeID) {
+    LightChanges changes;
+    beginLightChanges(&changes);
+
+    int changed = fillRow(reg, y, z, x0, x1, cubeID, &changes);
+
+    if (changed) {
+        collapseRegion(reg);
+
+        int lo[3] = {x0, y, z};
+        int hi[3] = {x1, y, z};
+        finishRegionEdit(batch, reg, lo, hi, &changes);
+    }
+
+    rewindArena(changes.arena, changes.mark);
+
+    return changed;
+}
+
+/**
+ * Returns 1 if every mini cube of the region
+ * at base is inside of the sphere.
+ *
+ */
+static int regionInSphere(EditOp* op, int base[3]) {
+    for (int corner = 0; corner < 8; corner++) {
+        float dist = 0.0f;
+
+        for (int i = 0; i < 3; i++) {
+            float c = base[i] + ((corner >> i) & 1 ? REGION_MCUBE_DEPTH - 1 : 0);
+            dist += (c - op->center[i]) * (c - op->center[i]);
+        }
+
+        if (dist > op->radius * op->radius)
+            return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Returns 1 if any part of the local box
+ * reaches into the sphere.
+ *
+ */
+static int boxInSphere(EditOp* op, int base[3], int lo[3], int hi[3]) {
+    float dist = 0.0f;
+
+    for (int i = 0; i < 3; i++) {
+        float closest = glm_clamp(op->center[i], base[i] + lo[i], base[i] + hi[i]);
+        dist += (closest - op->center[i]) * (closest - op->center[i]);
+    }
+
+    return dist <= op->radius * op->radius;
+}
+
+/**
+ * Applies the edit to the part of a single
+ * region between lo and hi (local, inclusive).
+ * base is where the region starts relative to
+ * the anchor.
+ *
+ * Returns 1 if anything changed, 0 otherwise.
+ */
+static int writeRegion(Region* reg, int base[3], int lo[3], int hi[3], EditOp* op, LightChanges* changes) {
+    int whole = 1;
+    for (int i = 0; i < 3; i++) {
+        if (lo[i] != 0 || hi[i] != REGION_MCUBE_DEPTH - 1)
+            whole = 0;
+    }
+
+    // Try to avoid expanding the region at all
+    switch (op->kind) {
+        case EDIT_FILL:
+        case EDIT_SPHERE:
+            if (reg->regType == FILLED && isSameCube(*(reg->data), op->cubeID))
+                return 0;
+
+            if (op->kind == EDIT_SPHERE && !boxInSphere(op, base, lo, hi))
+                return 0;
+
+            if (whole && (op->kind == EDIT_FILL || regionInSphere(op, base))) {
+                addFillChanges(changes, reg, op->cubeID);
+                return setRegionFill(op->cubeID, reg);
+            }
+            break;
+        case EDIT_REPLACE:
+            if (reg->regType == FILLED) {
+                if (!isSameCube(*(reg->data), op->oldID))
+                    return 0;
+
+                if (whole) {
+                    addFillChanges(changes, reg, op->cubeID);
+                    return setRegionFill(op->cubeID, reg);
+                }
+            }
+            break;
+        case EDIT_PASTE:
+            break;
+    }
+
+    // The writes expand the region once they find
+    // a mini cube that changes
+    int changed = 0;
+
+    for (int y = lo[1]; y <= hi[1]; y++) {
+        for (int z = lo[2]; z <= hi[2]; z++) {
+            switch (op->kind) {
+                case EDIT_FILL:
+                    changed |= fillRow(reg, y, z, lo[0], hi[0], op->cubeID, changes);
+                    break;
+                case EDIT_SPHERE: {
+                    float dy = (base[1] + y) - op->center[1];
+                    float dz = (base[2] + z) - op->center[2];
+                    float rest = op->radius * op->radius - dy * dy - dz * dz;
+
+                    if (rest < 0.0f)
+                        break;
+
+                    float dx = sqrtf(rest);
+                    int x0 = ceilf(op->center[0] - dx) - base[0];
+                    int x1 = floorf(op->center[0] + dx) - base[0];
+
+                    if (x0 < lo[0])
+                        x0 = lo[0];
+                    if (x1 > hi[0])
+                        x1 = hi[0];
+
+                    if (x0 <= x1)
+                        changed |= fillRow(reg, y, z, x0, x1, op->cubeID, changes);
+                    break;
+                }
+                case EDIT_REPLACE: {
+                    RowWrite write = {.cubeID = op->cubeID, .cells = NULL, .onlyID = op->oldID, .skipAir = 0};
+                    changed |= writeRow(reg, y, z, lo[0], hi[0], &write, changes);
+                    break;
+                }
+                case EDIT_PASTE: {
+                    Volume* vol = op->vol;
+                    int vy = base[1] + y - op->origin[1];
+                    int vz = base[2] + z - op->origin[2];
+                    int vx = base[0] + lo[0] - op->origin[0];
+
+                    RowWrite write = {
+                        .cubeID = NULL,
+                        .cells = &(vol->data[vx + vz * vol->width + vy * vol->width * vol->depth]),
+                        .onlyID = NULL,
+                        .skipAir = op->skipAir
+                    };
+                    changed |= writeRow(reg, y, z, lo[0], hi[0], &write, changes);
+                    break;
+                }
+            }
+        }
+    }
+
+    // Digging out or filling in every mini cube
+    // one row at a time leaves it all one cube
+    if (changed)
+        collapseRegion(reg);
+
+    return changed;
+}
+
+static int editRegion(EditBatch* batch, Region* reg, int base[3], int lo[3], int hi[3], EditOp* op) {
+    LightChanges changes;
+    beginLightChanges(&changes);
+
+    int changed = writeRegion(reg, base, lo, hi, op, &changes);
+
+    if (changed)
+        finishRegionEdit(batch, reg, lo, hi, &changes);
+
+    rewindArena(changes.arena, changes.mark);
+
+    return changed;
+}
+
+/**
+ * Splits the box (anchor mini cube units,
+ * inclusive) by region and applies the edit to
+ * every loaded region inside of it.
+ *
+ */
+static int applyEdit(EditBatch* batch, Region* anchor, int min[3], int max[3], EditOp* op) {
+    int rmin[3], rmax[3];
+    for (int i = 0; i < 3; i++) {
+        rmin[i] = floorDiv(min[i], REGION_MCUBE_DEPTH);
+        rmax[i] = floorDiv(max[i], REGION_MCUBE_DEPTH);
+    }
+
+    int changed = 0;
+
+    for (int ry = rmin[1]; ry <= rmax[1]; ry++) {
+        for (int rz = rmin[2]; rz <= rmax[2]; rz++) {
+            for (int rx = rmin[0]; rx <= rmax[0]; rx++) {
+                Region* reg = findRegion(anchor, rx, ry, rz);
+
+                if (reg == NULL)
+                    continue;
+
+                int r[3] = {rx, ry, rz};
+                int base[3], lo[3], hi[3];
+
+                for (int i = 0; i < 3; i++) {
+                    base[i] = r[i] * REGION_MCUBE_DEPTH;
+                    lo[i] = min[i] - base[i] > 0 ? min[i] - base[i] : 0;
+                    hi[i] = max[i] - base[i] < REGION_MCUBE_DEPTH - 1 ? max[i] - base[i] : REGION_MCUBE_DEPTH - 1;
+                }
+
+                changed |= editRegion(batch, reg, base, lo, hi, op);
+            }
+        }
+    }
+
+    return changed;
+}
+
+static int runEdit(Region* anchor, int min[3], int max[3], EditOp* op) {
+    EditBatch batch;
+
+    beginEdit(&batch);
+    beginJournalStep();
+
+    int changed = applyEdit(&batch, anchor, min, max, op);
+
+    endJournalStep();
+    endEdit(&batch);
+
+    return changed;
+}
+
+int fillBox(char* cubeID, Region* anchor, vec3s from, vec3s to) {
+    int min[3], max[3];
+    sortCorners(from, to, min, max);
+
+    EditOp op = {.kind = EDIT_FILL, .cubeID = cubeID};
+
+    return runEdit(anchor, min, max, &op);
+}
+
+int fillSphere(char* cubeID, Region* anchor, vec3s center, float radius) {
+    int min[3], max[3];
+
+    EditOp op = {.kind = EDIT_SPHERE, .cubeID = cubeID, .radius = radius};
+
+    for (int i = 0; i < 3; i++) {
+        op.center[i] = center.raw[i];
+        min[i] = ceilf(center.raw[i] - radius);
+        max[i] = floorf(center.raw[i] + radius);
+    }
+
+    return runEdit(anchor, min, max, &op);
+}
+
+int replaceBox(char* oldID, char* newID, Region* anchor, vec3s from, vec3s to) {
+    int min[3], max[3];
+    sortCorners(from, to, min, max);
+
+    EditOp op = {.kind = EDIT_REPLACE, .cubeID = newID, .oldID = oldID};
+
+    return runEdit(anchor, min, max, &op);
+}
+
+Volume* copyVolume(Region* anchor, vec3s from, vec3s to) {
+    int min[3], max[3];
+    sortCorners(from, to, min, max);
+
+    Volume* result = malloc(sizeof(Volume));
+
+    if (result == NULL) {
+        fprintf(stderr, "ERROR: Cannot allocate space for Volume!\n");
+        exit(1);
+    }
+
+    result->width = max[0] - min[0] + 1;
+    result->height = max[1] - min[1] + 1;
+    result->depth = max[2] - min[2] + 1;
+    result->data = malloc(result->width * result->height * result->depth * sizeof(char*));
+
+    if (result->data == NULL) {
+        fprintf(stderr, "ERROR: Cannot allocate space for Volume data!\n");
+        exit(1);
+    }
+
+    for (int y = 0; y < result->height; y++) {
+        for (int z = 0; z < result->depth; z++) {
+            char** dest = &(result->data[z * result->width + y * result->width * result->depth]);
+
+            int ay = min[1] + y;
+            int az = min[2] + z;
+            int ry = floorDiv(ay, REGION_MCUBE_DEPTH);
+            int rz = floorDiv(az, REGION_MCUBE_DEPTH);
+            int ly = ay - ry * REGION_MCUBE_DEPTH;
+            int lz = az - rz * REGION_MCUBE_DEPTH;
+
+            // Copy the row a region at a time
+            int x = 0;
+            while (x < result->width) {
+                int ax = min[0] + x;
+                int rx = floorDiv(ax, REGION_MCUBE_DEPTH);
+                int lx = ax - rx * REGION_MCUBE_DEPTH;
+
+                int count = REGION_MCUBE_DEPTH - lx;
+                if (count > result->width - x)
+                    count = result->width - x;
+
+                Region* reg = findRegion(anchor, rx, ry, rz);
+
+                if (reg == NULL || reg->regType == FILLED) {
+                    char* cubeID = reg == NULL ? AIR_CUBE : *(reg->data);
+                    for (int i = 0; i < count; i++)
+                        dest[x + i] = cubeID;
+                }
+                else if (reg->regType == MCUBED) {
+                    unpackRegion(reg);
+                    memcpy(&dest[x], &(reg->data[lx + lz * REGION_MCUBE_DEPTH + ly * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH]), count * sizeof(char*));
+                }
+                else {
+                    for (int i = 0; i < count; i++)
+                        dest[x + i] = getMCube(reg, lx + i, ly, lz);
+                }
+
+                x += count;
+            }
+        }
+    }
+
+    return result;
+}
+
+int pasteVolume(Volume* vol, Region* anchor, vec3s at, int skipAir) {
+    int min[3], max[3];
+
+    EditOp op = {.kind = EDIT_PASTE, .vol = vol, .skipAir = skipAir};
+
+    int size[3] = {vol->width, vol->height, vol->depth};
+    for (int i = 0; i < 3; i++) {
+        op.origin[i] = floorf(at.raw[i]);
+        min[i] = op.origin[i];
+        max[i] = op.origin[i] + size[i] - 1;
+    }
+
+    return runEdit(anchor, min, max, &op);
+}
+
+void freeVolume(Volume** volPptr) {
+    Volume* volPtr = *volPptr;
+
+    if (volPtr == NULL)
+        return;
+
+    free(volPtr->data);
+    free(volPtr);
+    *volPptr = NULL;
+}
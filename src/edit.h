@@ -0,0 +1,108 @@
+#include "region.h"
+#include <cglm/struct.h>
+
+#ifndef EDIT_H
+#define EDIT_H
+
+/**
+ * Collects the regions touched by a group of
+ * edits so each one is remeshed only once when
+ * the batch ends.
+ *
+ */
+typedef struct _editBatch {
+    // On the heap, relighting takes and gives
+    // back scratch space while regions are
+    // still being added
+    Region** regions;
+    int size;
+    int capacity;
+} EditBatch;
+
+/**
+ * A copied box of mini cubes indexed like
+ * region data: x + z * width + y * width * depth
+ *
+ */
+typedef struct _volume {
+    int width;
+    int height;
+    int depth;
+    char** data;
+} Volume;
+
+/**
+ * Start and finish a batch of edits. Ending
+ * the batch remeshes everything that was
+ * marked in between. Batches end in the
+ * reverse order they begin.
+ *
+ */
+void beginEdit(EditBatch* batch);
+void endEdit(EditBatch* batch);
+
+/**
+ * Once set, ending a batch starts remeshing its
+ * regions on the job workers instead of building
+ * them before it returns, see remesh.h.
+ *
+ */
+void setEditRemeshAsync(int async);
+
+/**
+ * Marks mini cubes lo to hi (inclusive) of a
+ * region as changed and queues it for remeshing
+ * along with any neighbors it borders. The light
+ * around them is updated too.
+ *
+ */
+void markRegionEdited(EditBatch* batch, Region* reg, int lo[3], int hi[3]);
+
+/**
+ * Same as markRegionEdited without relighting,
+ * for changes that only need remeshing.
+ *
+ */
+void markRegionRemesh(EditBatch* batch, Region* reg, int lo[3], int hi[3]);
+
+/**
+ * Sets mini cubes x0 to x1 (inclusive) of one
+ * row in a region without remeshing.
+ *
+ * Returns 1 if anything changed, 0 otherwise.
+ */
+int setMCubeRow(EditBatch* batch, Region* reg, int y, int z, int x0, int x1, char* cubeID);
+
+/**
+ * Bulk edits, all positions are mini cube
+ * coordinates relative to the anchor region and
+ * may reach into any linked region. Boxes
+ * include both corners.
+ *
+ * Each touched region is remeshed once.
+ *
+ * Returns 1 if anything changed, 0 otherwise.
+ */
+int fillBox(char* cubeID, Region* anchor, vec3s from, vec3s to);
+int fillSphere(char* cubeID, Region* anchor, vec3s center, float radius);
+int replaceBox(char* oldID, char* newID, Region* anchor, vec3s from, vec3s to);
+
+/**
+ * Copies a box of mini cubes out of the world,
+ * unloaded regions read as air.
+ *
+ */
+Volume* copyVolume(Region* anchor, vec3s from, vec3s to);
+
+/**
+ * Writes a copied volume with its lowest corner
+ * at the given position, air in the volume is
+ * left out when skipAir is set.
+ *
+ * Returns 1 if anything changed, 0 otherwise.
+ */
+int pasteVolume(Volume* vol, Region* anchor, vec3s at, int skipAir);
+
+void freeVolume(Volume** volPptr);
+
+#endif
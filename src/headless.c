@@ -0,0 +1,297 @@
+/**
+ * Draws without a window so frames can be timed
+ * on machines with no display, Mesa's software
+ * renderer included.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "headless.h"
+
+/**
+ * Mesa can make a display with no window system
+ * behind it at all, anything else gets the
+ * default display.
+ *
+ */
+static EGLDisplay getHeadlessDisplay() {
+    const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    if (extensions != NULL && strstr(extensions, "EGL_MESA_platform_surfaceless") != NULL &&
+        getPlatformDisplay != NULL) {
+        EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+
+        if (display != EGL_NO_DISPLAY)
+            return display;
+    }
+
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+/**
+ * Creates the context and makes it current,
+ * without a surface if the display allows it.
+ *
+ * Returns 0 on success and -1 otherwise.
+ */
+static int makeHeadlessContext(Headless* headless) {
+    const char* extensions = eglQueryString(headless->display, EGL_EXTENSIONS);
+    int surfaceless = extensions != NULL && strstr(extensions, "EGL_KHR_surfaceless_context") != NULL;
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+
+    EGLConfig config;
+    EGLint configCount = 0;
+
+    if (!eglChooseConfig(headless->display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+        fprintf(stderr, "ERROR: No EGL config can render OpenGL\n");
+        return -1;
+    }
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 1,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+
+    headless->context = eglCreateContext(headless->display, config, EGL_NO_CONTEXT, contextAttributes);
+
+    if (headless->context == EGL_NO_CONTEXT) {
+        fprintf(stderr, "ERROR: Could not create an OpenGL 4.1 context through EGL\n");
+        return -1;
+    }
+
+    // Everything is drawn to the framebuffer so
+    // the pbuffer is never used
+    if (!surfaceless) {
+        const EGLint surfaceAttributes[] = {
+            EGL_WIDTH, 1,
+            EGL_HEIGHT, 1,
+            EGL_NONE
+        };
+
+        headless->surface = eglCreatePbufferSurface(headless->display, config, surfaceAttributes);
+
+        if (headless->surface == EGL_NO_SURFACE) {
+            fprintf(stderr, "ERROR: Could not create an EGL pbuffer\n");
+            return -1;
+        }
+    }
+
+    if (!eglMakeCurrent(headless->display, headless->surface, headless->surface, headless->context)) {
+        fprintf(stderr, "ERROR: Could not make the EGL context current\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int makeHeadlessFramebuffer(Headless* headless) {
+    glGenRenderbuffers(1, &(headless->colorBuffer));
+    glBindRenderbuffer(GL_RENDERBUFFER, headless->colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, headless->width, headless->height);
+
+    glGenRenderbuffers(1, &(headless->depthBuffer));
+    glBindRenderbuffer(GL_RENDERBUFFER, headless->depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, headless->width, headless->height);
+
+    glGenFramebuffers(1, &(headless->framebuffer));
+    glBindFramebuffer(GL_FRAMEBUFFER, headless->framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headless->colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, headless->depthBuffer);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "ERROR: The %dx%d framebuffer is incomplete\n", headless->width, headless->height);
+        return -1;
+    }
+
+    return 0;
+}
+
+Headless* initHeadless(int width, int height) {
+    Headless* result = malloc(sizeof(Headless));
+
+    if (result == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate memory for program!\n");
+        exit(1);
+    }
+
+    memset(result, 0, sizeof(Headless));
+
+    result->width = width;
+    result->height = height;
+    result->surface = EGL_NO_SURFACE;
+    result->context = EGL_NO_CONTEXT;
+
+    result->display = getHeadlessDisplay();
+
+    if (result->display == EGL_NO_DISPLAY || !eglInitialize(result->display, NULL, NULL)) {
+        fprintf(stderr, "ERROR: No EGL display to draw headless with\n");
+        free(result);
+        return NULL;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API) || makeHeadlessContext(result) < 0 ||
+        !gladLoadGLLoader((GLADloadproc) eglGetProcAddress) || makeHeadlessFramebuffer(result) < 0) {
+        freeHeadless(&result);
+        return NULL;
+    }
+
+    glGenQueries(HEADLESS_QUERIES, result->queries);
+
+    fprintf(stderr, "Drawing headless at %dx%d with %s\n", width, height, (const char*) glGetString(GL_RENDERER));
+
+    return result;
+}
+
+/**
+ * Waits for a query if it was used and keeps how
+ * long its frame took.
+ *
+ */
+static void collectQuery(Headless* headless, int slot) {
+    if (!headless->queryPending[slot])
+        return;
+
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(headless->queries[slot], GL_QUERY_RESULT, &nanoseconds);
+
+    addFrameTime(&(headless->gpuTimes), (double) nanoseconds / 1e6);
+    headless->queryPending[slot] = 0;
+}
+
+void beginHeadlessFrame(Headless* headless) {
+    headless->frameStart = SDL_GetPerformanceCounter();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, headless->framebuffer);
+
+    // Some drivers give nonsense for a query
+    // started before anything was drawn
+    if (headless->frames == 0)
+        return;
+
+    // Also keeps the GPU from falling more than a
+    // few frames behind, as swapping would
+    int slot = headless->nextQuery;
+    collectQuery(headless, slot);
+
+    glBeginQuery(GL_TIME_ELAPSED, headless->queries[slot]);
+}
+
+void endHeadlessFrame(Headless* headless) {
+    glFlush();
+
+    if (headless->frames++ == 0)
+        return;
+
+    int slot = headless->nextQuery;
+
+    glEndQuery(GL_TIME_ELAPSED);
+    headless->queryPending[slot] = 1;
+    headless->nextQuery = (slot + 1) % HEADLESS_QUERIES;
+
+    uint64_t elapsed = SDL_GetPerformanceCounter() - headless->frameStart;
+    addFrameTime(&(headless->cpuTimes), (double) elapsed * 1000.0 / (double) SDL_GetPerformanceFrequency());
+}
+
+/**
+ * FNV-1a over the pixels of the framebuffer.
+ *
+ */
+static uint64_t getFrameChecksum(Headless* headless) {
+    size_t size = (size_t) headless->width * headless->height * 4;
+    unsigned char* pixels = malloc(size);
+
+    if (pixels == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate memory for program!\n");
+        exit(1);
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, headless->framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, headless->width, headless->height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= pixels[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    free(pixels);
+
+    return hash;
+}
+
+static void printSummaryTimes(const char* name, FrameTimes* frames) {
+    FrameSummary summary;
+    summarizeFrameTimes(frames, &summary);
+
+    printf("\"%s\":{\"mean\":%.4f,\"min\":%.4f,\"p50\":%.4f,\"p95\":%.4f,\"p99\":%.4f,\"max\":%.4f}",
+            name, summary.mean, summary.min, summary.p50, summary.p95, summary.p99, summary.max);
+}
+
+void printHeadlessSummary(Headless* headless, const char* scene) {
+    glFinish();
+
+    for (int i = 0; i < HEADLESS_QUERIES; i++)
+        collectQuery(headless, (headless->nextQuery + i) % HEADLESS_QUERIES);
+
+    uint64_t checksum = getFrameChecksum(headless);
+
+    printf("{\"scene\":\"%s\",\"width\":%d,\"height\":%d,\"frames\":%d,\"timed\":%d,\"renderer\":\"",
+            scene, headless->width, headless->height, headless->frames, headless->cpuTimes.count);
+
+    // Driver names are printed as they are, less
+    // anything that would end the string
+    for (const char* c = (const char*) glGetString(GL_RENDERER); c != NULL && *c != '\0'; c++) {
+        if (*c != '"' && *c != '\\')
+            putchar(*c);
+    }
+
+    printf("\",");
+    printSummaryTimes("cpu_ms", &(headless->cpuTimes));
+    printf(",");
+    printSummaryTimes("gpu_ms", &(headless->gpuTimes));
+    printf(",\"checksum\":\"%016llx\"}\n", (unsigned long long) checksum);
+
+    fflush(stdout);
+}
+
+void freeHeadless(Headless** headlessPtrPtr) {
+    Headless* headless = *headlessPtrPtr;
+
+    // Only made once GL was loaded
+    if (headless->framebuffer != 0) {
+        glDeleteQueries(HEADLESS_QUERIES, headless->queries);
+        glDeleteFramebuffers(1, &(headless->framebuffer));
+        glDeleteRenderbuffers(1, &(headless->colorBuffer));
+        glDeleteRenderbuffers(1, &(headless->depthBuffer));
+    }
+
+    eglMakeCurrent(headless->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+    if (headless->surface != EGL_NO_SURFACE)
+        eglDestroySurface(headless->display, headless->surface);
+    if (headless->context != EGL_NO_CONTEXT)
+        eglDestroyContext(headless->display, headless->context);
+
+    eglTerminate(headless->display);
+
+    freeFrameTimes(&(headless->cpuTimes));
+    freeFrameTimes(&(headless->gpuTimes));
+    free(headless);
+
+    *headlessPtrPtr = NULL;
+}
@@ -0,0 +1,85 @@
+#include <stdint.h>
+#include <EGL/egl.h>
+#include <glad/glad.h>
+
+#include "pacing.h"
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+// Timer queries in flight before a frame waits
+// for the oldest one
+#define HEADLESS_QUERIES 4
+
+/**
+ * A GL context without a window, made through
+ * EGL, drawing into a framebuffer of its own.
+ * Frames are timed on the CPU and with timer
+ * queries on the GPU.
+ *
+ */
+typedef struct _headless {
+    EGLDisplay display;
+    EGLContext context;
+    // No surface when surfaceless contexts work,
+    // a small pbuffer otherwise
+    EGLSurface surface;
+
+    int width;
+    int height;
+
+    GLuint framebuffer;
+    GLuint colorBuffer;
+    GLuint depthBuffer;
+
+    // Ring of queries, a slot is waited on before
+    // it is used again
+    GLuint queries[HEADLESS_QUERIES];
+    int queryPending[HEADLESS_QUERIES];
+    int nextQuery;
+
+    // Performance counter when the frame began
+    uint64_t frameStart;
+
+    // The first frame compiles shaders and fills
+    // caches so it isn't timed
+    int frames;
+
+    FrameTimes cpuTimes;
+    FrameTimes gpuTimes;
+} Headless;
+
+/**
+ * Makes the context current and loads GL through
+ * it. Returns NULL if no display or context
+ * could be made.
+ *
+ */
+Headless* initHeadless(int width, int height);
+
+/**
+ * Call before drawing anything, the framebuffer
+ * is bound and the frame's GPU timer started
+ * from the second frame on.
+ *
+ */
+void beginHeadlessFrame(Headless* headless);
+
+/**
+ * Stands in for swapping, the frame is flushed
+ * and its CPU time kept.
+ *
+ */
+void endHeadlessFrame(Headless* headless);
+
+/**
+ * Waits for the GPU and prints a summary of the
+ * run as one line of JSON, with a checksum of
+ * the last frame so runs can be told apart.
+ *
+ */
+void printHeadlessSummary(Headless* headless, const char* scene);
+
+void freeHeadless(Headless** headlessPtrPtr);
+
+#endif
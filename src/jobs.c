@@ -0,0 +1,448 @@
+/**
+ * Job system shared by everything that works off
+ * the main thread. Each worker has its own queue
+ * and steals from the others when it runs dry.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "jobs.h"
+#include "arena.h"
+
+// Jobs are made in blocks of this many
+#define JOB_BLOCK_SIZE 256
+
+static const int JOB_QUEUE_SIZE = 256;
+
+// Waiting threads look for work this often
+// even if nothing woke them. Idle workers are
+// woken for every job so they can sleep longer
+static const Uint32 JOB_WAIT_MS = 1;
+static const Uint32 WORKER_IDLE_MS = 10;
+
+typedef struct _job {
+    JobFunction function;
+    void* data;
+    JobCounter* counter;
+    enum JobThread thread;
+
+    // Free list, or waiting list of a counter
+    struct _job* next;
+} Job;
+
+/**
+ * A ring of jobs. The owner pushes and pops the
+ * newest end, thieves take the oldest.
+ *
+ */
+typedef struct _jobQueue {
+    SDL_SpinLock lock;
+    Job** jobs;
+    int head;
+    int count;
+    int capacity;
+} JobQueue;
+
+/**
+ * Counted by the owning thread and taken by
+ * whoever reads the stats.
+ *
+ */
+typedef struct _workerStats {
+    SDL_atomic_t busyMicros;
+    SDL_atomic_t jobs;
+    SDL_atomic_t steals;
+} WorkerStats;
+
+// Queue 0 belongs to the main thread
+static int workerCount = 0;
+static JobQueue queues[JOB_MAX_WORKERS + 1];
+static JobQueue mainQueue;
+static WorkerStats workerStats[JOB_MAX_WORKERS + 1];
+static SDL_Thread* workers[JOB_MAX_WORKERS + 1];
+
+static SDL_sem* wake = NULL;
+static SDL_atomic_t quitting;
+static Uint64 statsStart = 0;
+
+static SDL_SpinLock poolLock = 0;
+static Job* freeJobList = NULL;
+static Job** jobBlocks = NULL;
+static int jobBlockCount = 0;
+
+static _Thread_local int workerIndex = 0;
+
+static Job* allocJob() {
+    SDL_AtomicLock(&poolLock);
+
+    if (freeJobList == NULL) {
+        Job* block = malloc(JOB_BLOCK_SIZE * sizeof(Job));
+        Job** blocks = realloc(jobBlocks, (jobBlockCount + 1) * sizeof(Job*));
+
+        if (block == NULL || blocks == NULL) {
+            fprintf(stderr, "ERROR: Unable to allocate memory for jobs\n");
+            exit(1);
+        }
+
+        jobBlocks = blocks;
+        jobBlocks[jobBlockCount++] = block;
+
+        for (int i = 0; i < JOB_BLOCK_SIZE; i++) {
+            block[i].next = freeJobList;
+            freeJobList = &block[i];
+        }
+    }
+
+    Job* result = freeJobList;
+    freeJobList = result->next;
+
+    SDL_AtomicUnlock(&poolLock);
+    return result;
+}
+
+static void releaseJob(Job* job) {
+    SDL_AtomicLock(&poolLock);
+    job->next = freeJobList;
+    freeJobList = job;
+    SDL_AtomicUnlock(&poolLock);
+}
+
+static void initQueue(JobQueue* queue) {
+    queue->lock = 0;
+    queue->head = 0;
+    queue->count = 0;
+    queue->capacity = JOB_QUEUE_SIZE;
+    queue->jobs = malloc(queue->capacity * sizeof(Job*));
+
+    if (queue->jobs == NULL) {
+        fprintf(stderr, "ERROR: Unable to allocate memory for jobs\n");
+        exit(1);
+    }
+}
+
+static void pushJob(JobQueue* queue, Job* job) {
+    SDL_AtomicLock(&queue->lock);
+
+    // Unroll the ring into a bigger one
+    if (queue->count == queue->capacity) {
+        Job** jobs = malloc(queue->capacity * 2 * sizeof(Job*));
+
+        if (jobs == NULL) {
+            fprintf(stderr, "ERROR: Unable to allocate memory for jobs\n");
+            exit(1);
+        }
+
+        for (int i = 0; i < queue->count; i++)
+            jobs[i] = queue->jobs[(queue->head + i) % queue->capacity];
+
+        free(queue->jobs);
+        queue->jobs = jobs;
+        queue->head = 0;
+        queue->capacity *= 2;
+    }
+
+    queue->jobs[(queue->head + queue->count) % queue->capacity] = job;
+    queue->count++;
+
+    SDL_AtomicUnlock(&queue->lock);
+}
+
+/**
+ * Takes the newest job for the owner or the
+ * oldest one for anyone else.
+ *
+ */
+static Job* popJob(JobQueue* queue, int newest) {
+    Job* result = NULL;
+
+    SDL_AtomicLock(&queue->lock);
+
+    if (queue->count > 0) {
+        queue->count--;
+
+        if (newest) {
+            result = queue->jobs[(queue->head + queue->count) % queue->capacity];
+        }
+        else {
+            result = queue->jobs[queue->head];
+            queue->head = (queue->head + 1) % queue->capacity;
+        }
+    }
+
+    SDL_AtomicUnlock(&queue->lock);
+    return result;
+}
+
+static void queueJob(Job* job) {
+    if (job->thread == JOB_MAIN_THREAD)
+        pushJob(&mainQueue, job);
+    else
+        pushJob(&queues[workerIndex], job);
+
+    if (wake != NULL)
+        SDL_SemPost(wake);
+}
+
+/**
+ * Looks in the thread's own queue, then the main
+ * queue if it is the main thread, then steals.
+ *
+ */
+static Job* findJob() {
+    Job* job = popJob(&queues[workerIndex], 1);
+
+    if (job == NULL && workerIndex == 0)
+        job = popJob(&mainQueue, 0);
+
+    for (int i = 1; job == NULL && i <= workerCount; i++) {
+        job = popJob(&queues[(workerIndex + i) % (workerCount + 1)], 0);
+
+        if (job != NULL)
+            SDL_AtomicAdd(&workerStats[workerIndex].steals, 1);
+    }
+
+    return job;
+}
+
+static void finishCounter(JobCounter* counter) {
+    Job* waiting = NULL;
+
+    // Held until the waiting jobs are taken off,
+    // the counter can't be seen done and freed
+    // while this is still using it
+    SDL_AtomicLock(&counter->lock);
+
+    if (SDL_AtomicAdd(&counter->value, -1) == 1) {
+        waiting = counter->waiting;
+        counter->waiting = NULL;
+    }
+
+    SDL_AtomicUnlock(&counter->lock);
+
+    while (waiting != NULL) {
+        Job* next = waiting->next;
+        queueJob(waiting);
+        waiting = next;
+    }
+}
+
+static void doJob(Job* job) {
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    job->function(job->data);
+
+    Uint64 micros = (SDL_GetPerformanceCounter() - start) * 1000000 / SDL_GetPerformanceFrequency();
+    SDL_AtomicAdd(&workerStats[workerIndex].busyMicros, (int) micros);
+    SDL_AtomicAdd(&workerStats[workerIndex].jobs, 1);
+
+    JobCounter* counter = job->counter;
+    releaseJob(job);
+
+    // Last so waiters never see the counter done
+    // before the job is
+    if (counter != NULL)
+        finishCounter(counter);
+}
+
+static int workerLoop(void* data) {
+    workerIndex = (int) (intptr_t) data;
+
+    while (1) {
+        Job* job = findJob();
+
+        if (job != NULL) {
+            doJob(job);
+            continue;
+        }
+
+        if (SDL_AtomicGet(&quitting))
+            break;
+
+        SDL_SemWaitTimeout(wake, WORKER_IDLE_MS);
+    }
+
+    freeThreadArenas();
+    return 0;
+}
+
+int initJobs(int count) {
+    if (count <= 0)
+        count = SDL_GetCPUCount() - 1;
+    if (count < 1)
+        count = 1;
+    if (count > JOB_MAX_WORKERS)
+        count = JOB_MAX_WORKERS;
+
+    for (int i = 0; i <= count; i++) {
+        initQueue(&queues[i]);
+        SDL_AtomicSet(&workerStats[i].busyMicros, 0);
+        SDL_AtomicSet(&workerStats[i].jobs, 0);
+        SDL_AtomicSet(&workerStats[i].steals, 0);
+    }
+    initQueue(&mainQueue);
+
+    wake = SDL_CreateSemaphore(0);
+    SDL_AtomicSet(&quitting, 0);
+    statsStart = SDL_GetPerformanceCounter();
+    workerIndex = 0;
+
+    // Set before any worker reads it. Queues of
+    // workers that fail to start stay empty, with
+    // none the main thread runs everything while
+    // it waits
+    workerCount = count;
+    int started = 0;
+
+    for (int i = 1; i <= count; i++) {
+        workers[i] = SDL_CreateThread(workerLoop, "worker", (void*) (intptr_t) i);
+
+        if (workers[i] != NULL)
+            started++;
+    }
+
+    return started;
+}
+
+void initJobCounter(JobCounter* counter) {
+    SDL_AtomicSet(&counter->value, 0);
+    counter->lock = 0;
+    counter->waiting = NULL;
+}
+
+int isJobCounterDone(JobCounter* counter) {
+    // Read under the lock so whoever brought it
+    // to zero is done with it
+    SDL_AtomicLock(&counter->lock);
+    int done = SDL_AtomicGet(&counter->value) == 0;
+    SDL_AtomicUnlock(&counter->lock);
+
+    return done;
+}
+
+void runJobAfter(JobCounter* after, enum JobThread thread, JobFunction function, void* data, JobCounter* counter) {
+    Job* job = allocJob();
+    job->function = function;
+    job->data = data;
+    job->counter = counter;
+    job->thread = thread;
+    job->next = NULL;
+
+    if (counter != NULL)
+        SDL_AtomicAdd(&counter->value, 1);
+
+    if (after != NULL) {
+        SDL_AtomicLock(&after->lock);
+
+        // Checked under the lock so it can't reach
+        // zero between here and being added
+        if (SDL_AtomicGet(&after->value) > 0) {
+            job->next = after->waiting;
+            after->waiting = job;
+            SDL_AtomicUnlock(&after->lock);
+            return;
+        }
+
+        SDL_AtomicUnlock(&after->lock);
+    }
+
+    queueJob(job);
+}
+
+void runJob(JobFunction function, void* data, JobCounter* counter) {
+    runJobAfter(NULL, JOB_ANY_THREAD, function, data, counter);
+}
+
+void runMainJob(JobFunction function, void* data, JobCounter* counter) {
+    runJobAfter(NULL, JOB_MAIN_THREAD, function, data, counter);
+}
+
+void waitForJobs(JobCounter* counter) {
+    while (!isJobCounterDone(counter)) {
+        Job* job = findJob();
+
+        if (job != NULL)
+            doJob(job);
+        else
+            SDL_SemWaitTimeout(wake, JOB_WAIT_MS);
+    }
+}
+
+int runMainJobs() {
+    int count = 0;
+    Job* job;
+
+    while ((job = popJob(&mainQueue, 0)) != NULL) {
+        doJob(job);
+        count++;
+    }
+
+    return count;
+}
+
+JobStats getJobStats() {
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    JobStats result;
+    result.workers = workerCount;
+    result.seconds = (double) (now - statsStart) / (double) SDL_GetPerformanceFrequency();
+    result.jobs = 0;
+    result.steals = 0;
+
+    for (int i = 0; i <= workerCount; i++) {
+        // Taken away rather than zeroed so nothing
+        // added in between is lost
+        int busy = SDL_AtomicGet(&workerStats[i].busyMicros);
+        int jobs = SDL_AtomicGet(&workerStats[i].jobs);
+        int steals = SDL_AtomicGet(&workerStats[i].steals);
+        SDL_AtomicAdd(&workerStats[i].busyMicros, -busy);
+        SDL_AtomicAdd(&workerStats[i].jobs, -jobs);
+        SDL_AtomicAdd(&workerStats[i].steals, -steals);
+
+        result.busy[i] = result.seconds > 0.0 ? (double) busy / (result.seconds * 1000000.0) : 0.0;
+        result.jobs += jobs;
+        result.steals += steals;
+    }
+
+    statsStart = now;
+    return result;
+}
+
+void printJobStats(JobStats* stats) {
+    fprintf(stderr, "Jobs %d (%d stolen) over %.1f s, busy main %.0f%%",
+            stats->jobs, stats->steals, stats->seconds, stats->busy[0] * 100.0);
+
+    for (int i = 1; i <= stats->workers; i++)
+        fprintf(stderr, " %d:%.0f%%", i, stats->busy[i] * 100.0);
+
+    fprintf(stderr, "\n");
+}
+
+void freeJobs() {
+    SDL_AtomicSet(&quitting, 1);
+
+    for (int i = 1; i <= workerCount; i++)
+        SDL_SemPost(wake);
+
+    for (int i = 1; i <= workerCount; i++) {
+        if (workers[i] != NULL)
+            SDL_WaitThread(workers[i], NULL);
+    }
+
+    for (int i = 0; i <= workerCount; i++)
+        free(queues[i].jobs);
+    free(mainQueue.jobs);
+
+    for (int i = 0; i < jobBlockCount; i++)
+        free(jobBlocks[i]);
+    free(jobBlocks);
+
+    jobBlocks = NULL;
+    jobBlockCount = 0;
+    freeJobList = NULL;
+    workerCount = 0;
+
+    SDL_DestroySemaphore(wake);
+    wake = NULL;
+}
@@ -0,0 +1,114 @@
+#include <SDL2/SDL.h>
+
+#ifndef JOBS_H
+#define JOBS_H
+
+// Most workers that can be started, the main
+// thread is counted on top of these
+#define JOB_MAX_WORKERS 64
+
+typedef void (*JobFunction)(void* data);
+
+/**
+ * Counts the jobs started against it that have
+ * not finished yet. Jobs can wait for a counter
+ * to reach zero before they start.
+ *
+ */
+typedef struct _jobCounter {
+    SDL_atomic_t value;
+    SDL_SpinLock lock;
+
+    // Started when the count reaches zero
+    struct _job* waiting;
+} JobCounter;
+
+/**
+ * Which threads a job may run on. GL calls have
+ * to be made on the main thread.
+ *
+ */
+enum JobThread {
+    JOB_ANY_THREAD,
+    JOB_MAIN_THREAD
+};
+
+/**
+ * What the workers did since the stats were last
+ * read. Index 0 is the main thread, which only
+ * runs jobs while it waits or drains its own.
+ *
+ */
+typedef struct _jobStats {
+    int workers;
+    double seconds;
+
+    // Fraction of the time spent running jobs
+    double busy[JOB_MAX_WORKERS + 1];
+
+    int jobs;
+    int steals;
+} JobStats;
+
+/**
+ * Starts the workers, 0 picks one less than the
+ * number of cores. Has to be called from the main
+ * thread.
+ *
+ * Returns the number of workers started.
+ */
+int initJobs(int workers);
+
+void initJobCounter(JobCounter* counter);
+int isJobCounterDone(JobCounter* counter);
+
+/**
+ * Queues a job, counter can be NULL. Workers take
+ * jobs from the thread that queued them first and
+ * steal from the others when they run out.
+ *
+ */
+void runJob(JobFunction function, void* data, JobCounter* counter);
+
+/**
+ * Queues a job that only the main thread runs,
+ * from runMainJobs or while it waits.
+ *
+ */
+void runMainJob(JobFunction function, void* data, JobCounter* counter);
+
+/**
+ * Queues a job once the after counter reaches
+ * zero, or now if it already has. counter counts
+ * the job from now.
+ *
+ */
+void runJobAfter(JobCounter* after, enum JobThread thread, JobFunction function, void* data, JobCounter* counter);
+
+/**
+ * Runs other jobs until the counter reaches zero.
+ *
+ */
+void waitForJobs(JobCounter* counter);
+
+/**
+ * Runs every job queued for the main thread.
+ *
+ * Returns the number of jobs run.
+ */
+int runMainJobs();
+
+/**
+ * Reads and restarts the stats.
+ *
+ */
+JobStats getJobStats();
+void printJobStats(JobStats* stats);
+
+/**
+ * Stops the workers once their queues are empty.
+ *
+ */
+void freeJobs();
+
+#endif
@@ -0,0 +1,494 @@
+/**
+ * Undo and redo history for region edits.
+ *
+ * Changes are stored as runs of mini cubes that
+ * went from one palette ID to another, fills
+ * that replace a whole region keep a reference
+ * to the old region data instead of copying it.
+ * Undo and redo go through an edit batch so
+ * every region is remeshed once.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "journal.h"
+#include "edit.h"
+#include "palette.h"
+#include "compress.h"
+
+const size_t JOURNAL_DEFAULT_BUDGET = 16 * 1024 * 1024;
+
+static Journal* activeJournal = NULL;
+
+// Set once the outermost open step has
+// recorded something
+static int stepStarted = 0;
+
+Journal* initJournal(size_t budget) {
+    Journal* result = malloc(sizeof(Journal));
+
+    if (result == NULL) {
+        fprintf(stderr, "ERROR: Cannot allocate space for Journal!\n");
+        exit(1);
+    }
+
+    result->steps = NULL;
+    result->stepCount = 0;
+    result->stepCapacity = 0;
+    result->cursor = 0;
+
+    result->bytes = 0;
+    result->budget = budget;
+
+    result->depth = 0;
+    result->replaying = 0;
+
+    return result;
+}
+
+void setActiveJournal(Journal* journal) {
+    activeJournal = journal;
+    stepStarted = 0;
+}
+
+Journal* getActiveJournal() {
+    return activeJournal;
+}
+
+/**
+ * Size of the data array of a region type.
+ *
+ */
+static size_t regionDataBytes(enum RegionType type) {
+    switch (type) {
+        case FILLED:
+            return sizeof(char*);
+        case CUBED:
+            return REGION_CUBE_DEPTH * REGION_CUBE_DEPTH * REGION_CUBE_DEPTH * sizeof(char*);
+        case MCUBED:
+            return REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH * sizeof(char*);
+    }
+    return 0;
+}
+
+static void freeStep(JournalStep* step) {
+    for (int i = 0; i < step->chunkCount; i++) {
+        // Only set while the journal owns it
+        if (step->chunks[i].whole)
+            releaseRegionBlock(step->chunks[i].oldData);
+    }
+
+    free(step->chunks);
+    free(step->runs);
+}
+
+/**
+ * Drops steps from the oldest one until the
+ * journal fits in its budget.
+ *
+ */
+static void trimJournal(Journal* journal) {
+    int drop = 0;
+
+    while (drop < journal->stepCount && journal->bytes > journal->budget) {
+        journal->bytes -= journal->steps[drop].bytes;
+        freeStep(&(journal->steps[drop]));
+        drop++;
+    }
+
+    if (drop == 0)
+        return;
+
+    journal->stepCount -= drop;
+    journal->cursor = journal->cursor > drop ? journal->cursor - drop : 0;
+    memmove(journal->steps, journal->steps + drop, journal->stepCount * sizeof(JournalStep));
+}
+
+/**
+ * Gets the step being recorded, creating it
+ * and throwing away the redo history the
+ * first time.
+ *
+ */
+static JournalStep* currentStep(Journal* journal) {
+    if (stepStarted)
+        return &(journal->steps[journal->cursor - 1]);
+
+    for (int i = journal->cursor; i < journal->stepCount; i++) {
+        journal->bytes -= journal->steps[i].bytes;
+        freeStep(&(journal->steps[i]));
+    }
+    journal->stepCount = journal->cursor;
+
+    if (journal->stepCount == journal->stepCapacity) {
+        journal->stepCapacity = journal->stepCapacity == 0 ? 16 : journal->stepCapacity * 2;
+        journal->steps = realloc(journal->steps, journal->stepCapacity * sizeof(JournalStep));
+
+        if (journal->steps == NULL) {
+            fprintf(stderr, "ERROR: Unable to allocate memory for journal\n");
+            exit(1);
+        }
+    }
+
+    JournalStep* step = &(journal->steps[journal->stepCount]);
+    memset(step, 0, sizeof(JournalStep));
+
+    journal->stepCount++;
+    journal->cursor = journal->stepCount;
+    stepStarted = 1;
+
+    return step;
+}
+
+static int isRecording() {
+    return activeJournal != NULL && !activeJournal->replaying;
+}
+
+void beginJournalStep() {
+    if (!isRecording())
+        return;
+
+    activeJournal->depth++;
+}
+
+void endJournalStep() {
+    if (!isRecording() || activeJournal->depth == 0)
+        return;
+
+    activeJournal->depth--;
+
+    if (activeJournal->depth == 0) {
+        stepStarted = 0;
+        trimJournal(activeJournal);
+    }
+}
+
+static void addBytes(Journal* journal, JournalStep* step, size_t bytes) {
+    step->bytes += bytes;
+    journal->bytes += bytes;
+}
+
+static JournalChunk* pushChunk(Journal* journal, JournalStep* step, Region* reg) {
+    if (step->chunkCount == step->chunkCapacity) {
+        step->chunkCapacity = step->chunkCapacity == 0 ? 4 : step->chunkCapacity * 2;
+        step->chunks = realloc(step->chunks, step->chunkCapacity * sizeof(JournalChunk));
+
+        if (step->chunks == NULL) {
+            fprintf(stderr, "ERROR: Unable to allocate memory for journal\n");
+            exit(1);
+        }
+    }
+
+    JournalChunk* chunk = &(step->chunks[step->chunkCount++]);
+    memset(chunk, 0, sizeof(JournalChunk));
+    chunk->region = reg;
+    chunk->runStart = step->runCount;
+
+    addBytes(journal, step, sizeof(JournalChunk));
+
+    return chunk;
+}
+
+/**
+ * Adds a single mini cube change, merging it
+ * into the last run when it continues it.
+ *
+ */
+static void pushCell(Journal* journal, JournalStep* step, Region* reg, int index, uint16_t oldID, uint16_t newID) {
+    JournalChunk* chunk = NULL;
+
+    if (step->chunkCount > 0) {
+        chunk = &(step->chunks[step->chunkCount - 1]);
+        if (chunk->region != reg || chunk->whole)
+            chunk = NULL;
+    }
+
+    if (chunk == NULL)
+        chunk = pushChunk(journal, step, reg);
+
+    if (chunk->runCount > 0) {
+        JournalRun* last = &(step->runs[step->runCount - 1]);
+
+        if (last->start + last->length == index && last->length < UINT16_MAX &&
+            last->oldID == oldID && last->newID == newID) {
+            last->length++;
+            return;
+        }
+    }
+
+    if (step->runCount == step->runCapacity) {
+        step->runCapacity = step->runCapacity == 0 ? 16 : step->runCapacity * 2;
+        step->runs = realloc(step->runs, step->runCapacity * sizeof(JournalRun));
+
+        if (step->runs == NULL) {
+            fprintf(stderr, "ERROR: Unable to allocate memory for journal\n");
+            exit(1);
+        }
+    }
+
+    step->runs[step->runCount++] = (JournalRun) {.start = index, .length = 1, .oldID = oldID, .newID = newID};
+    chunk->runCount++;
+
+    addBytes(journal, step, sizeof(JournalRun));
+}
+
+/**
+ * Records a run of cells being overwritten with
+ * newIDs[i - start], or newID for all of them
+ * when newIDs is NULL.
+ *
+ */
+static void recordCells(Region* reg, int start, int length, char* newID, char** newIDs) {
+    if (!isRecording())
+        return;
+
+    // Edits made outside of a step are a
+    // step on their own
+    int wrap = activeJournal->depth == 0;
+    if (wrap)
+        beginJournalStep();
+
+    JournalStep* step = currentStep(activeJournal);
+    uint16_t newPalette = newIDs == NULL ? getPaletteID(newID) : 0;
+
+    char* lastCube = NULL;
+    uint16_t lastPalette = 0;
+
+    char* lastNew = newID;
+
+    for (int i = start; i < start + length; i++) {
+        char* oldCube;
+
+        switch (reg->regType) {
+            case FILLED:
+                oldCube = *(reg->data);
+                break;
+            case MCUBED:
+                unpackRegion(reg);
+                oldCube = reg->data[i];
+                break;
+            default:
+                oldCube = getMCube(reg, i % REGION_MCUBE_DEPTH,
+                                   i / (REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH),
+                                   (i / REGION_MCUBE_DEPTH) % REGION_MCUBE_DEPTH);
+                break;
+        }
+
+        // Runs tend to have the same cube
+        if (oldCube != lastCube) {
+            lastCube = oldCube;
+            lastPalette = getPaletteID(oldCube);
+        }
+
+        if (newIDs != NULL && (i == start || newIDs[i - start] != lastNew)) {
+            lastNew = newIDs[i - start];
+            newPalette = getPaletteID(lastNew);
+        }
+
+        if (lastPalette != newPalette)
+            pushCell(activeJournal, step, reg, i, lastPalette, newPalette);
+    }
+
+    if (wrap)
+        endJournalStep();
+}
+
+void journalRecordCells(Region* reg, int start, int length, char* newID) {
+    recordCells(reg, start, length, newID, NULL);
+}
+
+void journalRecordCubes(Region* reg, int start, int length, char** newIDs) {
+    recordCells(reg, start, length, NULL, newIDs);
+}
+
+int journalRecordFill(Region* reg, char* newID) {
+    if (!isRecording())
+        return 0;
+
+    int wrap = activeJournal->depth == 0;
+    if (wrap)
+        beginJournalStep();
+
+    JournalStep* step = currentStep(activeJournal);
+    JournalChunk* chunk = pushChunk(activeJournal, step, reg);
+
+    chunk->whole = 1;
+    chunk->oldType = reg->regType;
+    chunk->oldData = reg->data;
+    chunk->newID = getPaletteID(newID);
+
+    addBytes(activeJournal, step, regionDataBytes(reg->regType));
+
+    if (wrap)
+        endJournalStep();
+
+    return 1;
+}
+
+void journalForgetRegion(Region* reg) {
+    Journal* journal = activeJournal;
+
+    if (journal == NULL)
+        return;
+
+    for (int i = 0; i < journal->stepCount; i++) {
+        JournalStep* step = &(journal->steps[i]);
+
+        for (int j = 0; j < step->chunkCount; j++) {
+            if (step->chunks[j].region != reg)
+                continue;
+
+            // The history can't be replayed without
+            // the region so all of it goes
+            for (int k = 0; k < journal->stepCount; k++)
+                freeStep(&(journal->steps[k]));
+
+            journal->stepCount = 0;
+            journal->cursor = 0;
+            journal->bytes = 0;
+            stepStarted = 0;
+            return;
+        }
+    }
+}
+
+/**
+ * Writes a run back through the edit batch a
+ * row at a time.
+ *
+ */
+static void writeRun(EditBatch* batch, Region* reg, int start, int length, uint16_t paletteID) {
+    char* cubeID = getPaletteCube(paletteID);
+
+    while (length > 0) {
+        int x = start % REGION_MCUBE_DEPTH;
+        int z = (start / REGION_MCUBE_DEPTH) % REGION_MCUBE_DEPTH;
+        int y = start / (REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH);
+
+        int count = REGION_MCUBE_DEPTH - x;
+        if (count > length)
+            count = length;
+
+        setMCubeRow(batch, reg, y, z, x, x + count - 1, cubeID);
+
+        start += count;
+        length -= count;
+    }
+}
+
+/**
+ * Swaps the data held by a whole region chunk
+ * with the region, going back to the old data
+ * on undo and to the fill on redo.
+ *
+ */
+static void swapWhole(Journal* journal, EditBatch* batch, JournalStep* step, JournalChunk* chunk, int undo) {
+    Region* reg = chunk->region;
+
+    // Whole chunks hold unpacked data
+    unpackRegion(reg);
+
+    // The journal only counts the data while it
+    // holds it
+    if (undo) {
+        step->bytes -= regionDataBytes(chunk->oldType);
+        journal->bytes -= regionDataBytes(chunk->oldType);
+
+        releaseRegionBlock(reg->data);
+        reg->data = chunk->oldData;
+        reg->regType = chunk->oldType;
+        chunk->oldData = NULL;
+    }
+    else {
+        char** newData = allocRegionBlock(sizeof(char*));
+        newData[0] = getPaletteCube(chunk->newID);
+
+        chunk->oldType = reg->regType;
+        chunk->oldData = reg->data;
+        addBytes(journal, step, regionDataBytes(reg->regType));
+
+        reg->data = newData;
+        reg->regType = FILLED;
+    }
+
+    updateRegionOccupancy(reg);
+
+    int lo[3] = {0, 0, 0};
+    int hi[3] = {REGION_MCUBE_DEPTH - 1, REGION_MCUBE_DEPTH - 1, REGION_MCUBE_DEPTH - 1};
+    markRegionEdited(batch, reg, lo, hi);
+}
+
+static void replayChunk(Journal* journal, EditBatch* batch, JournalStep* step, JournalChunk* chunk, int undo) {
+    if (chunk->whole) {
+        swapWhole(journal, batch, step, chunk, undo);
+        return;
+    }
+
+    for (int i = 0; i < chunk->runCount; i++) {
+        // Undo has to go backwards in case
+        // cells were changed more than once
+        int index = undo ? chunk->runStart + chunk->runCount - 1 - i : chunk->runStart + i;
+        JournalRun* run = &(step->runs[index]);
+
+        writeRun(batch, chunk->region, run->start, run->length, undo ? run->oldID : run->newID);
+    }
+}
+
+int undoEdit(Journal* journal) {
+    if (journal->cursor == 0 || journal->depth > 0)
+        return 0;
+
+    JournalStep* step = &(journal->steps[journal->cursor - 1]);
+
+    EditBatch batch;
+    beginEdit(&batch);
+    journal->replaying = 1;
+
+    for (int i = step->chunkCount - 1; i >= 0; i--)
+        replayChunk(journal, &batch, step, &(step->chunks[i]), 1);
+
+    journal->replaying = 0;
+    endEdit(&batch);
+
+    journal->cursor--;
+    return 1;
+}
+
+int redoEdit(Journal* journal) {
+    if (journal->cursor == journal->stepCount || journal->depth > 0)
+        return 0;
+
+    JournalStep* step = &(journal->steps[journal->cursor]);
+
+    EditBatch batch;
+    beginEdit(&batch);
+    journal->replaying = 1;
+
+    for (int i = 0; i < step->chunkCount; i++)
+        replayChunk(journal, &batch, step, &(step->chunks[i]), 0);
+
+    journal->replaying = 0;
+    endEdit(&batch);
+
+    journal->cursor++;
+    return 1;
+}
+
+void freeJournal(Journal** journalPptr) {
+    Journal* journalPtr = *journalPptr;
+
+    if (journalPtr == NULL)
+        return;
+
+    if (activeJournal == journalPtr)
+        setActiveJournal(NULL);
+
+    for (int i = 0; i < journalPtr->stepCount; i++)
+        freeStep(&(journalPtr->steps[i]));
+
+    free(journalPtr->steps);
+    free(journalPtr);
+    *journalPptr = NULL;
+}
@@ -0,0 +1,132 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "region.h"
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+extern const size_t JOURNAL_DEFAULT_BUDGET;
+
+/**
+ * A run of mini cubes in one region that all
+ * went from oldID to newID. start indexes the
+ * region data the same way as MCUBED regions.
+ *
+ */
+typedef struct _journalRun {
+    RegionIndex start;
+    uint16_t length;
+    uint16_t oldID;
+    uint16_t newID;
+} JournalRun;
+
+/**
+ * The changes made to one region, either a list
+ * of runs or the whole previous data of a region
+ * that was replaced by a fill.
+ *
+ */
+typedef struct _journalChunk {
+    Region* region;
+
+    int whole;
+    enum RegionType oldType;
+    char** oldData;
+    uint16_t newID;
+
+    int runStart;
+    int runCount;
+} JournalChunk;
+
+/**
+ * Everything done by one edit, undone and
+ * redone together.
+ *
+ */
+typedef struct _journalStep {
+    JournalChunk* chunks;
+    int chunkCount;
+    int chunkCapacity;
+
+    JournalRun* runs;
+    int runCount;
+    int runCapacity;
+
+    size_t bytes;
+} JournalStep;
+
+typedef struct _journal {
+    JournalStep* steps;
+    int stepCount;
+    int stepCapacity;
+
+    // Steps before this are applied, the ones
+    // after can be redone
+    int cursor;
+
+    size_t bytes;
+    size_t budget;
+
+    // How many steps are open, only the
+    // outermost one counts
+    int depth;
+    int replaying;
+} Journal;
+
+/**
+ * Creates a journal that drops its oldest steps
+ * once it holds more than budget bytes.
+ *
+ */
+Journal* initJournal(size_t budget);
+
+/**
+ * Sets the journal edits are recorded into,
+ * NULL stops recording.
+ *
+ */
+void setActiveJournal(Journal* journal);
+Journal* getActiveJournal();
+
+/**
+ * Groups every edit in between into a single
+ * undo step, these can be nested.
+ *
+ */
+void beginJournalStep();
+void endJournalStep();
+
+/**
+ * Called by the edit functions before any
+ * mini cubes are overwritten. journalRecordCubes
+ * takes a new cube for each cell of the run.
+ *
+ * journalRecordFill returns 1 when the journal
+ * has taken the old region data, the caller
+ * must not free it.
+ */
+void journalRecordCells(Region* reg, int start, int length, char* newID);
+void journalRecordCubes(Region* reg, int start, int length, char** newIDs);
+int journalRecordFill(Region* reg, char* newID);
+
+/**
+ * Drops any history that refers to a region
+ * that is about to be freed.
+ *
+ */
+void journalForgetRegion(Region* reg);
+
+/**
+ * Undoes or redoes one step, every region is
+ * remeshed once.
+ *
+ * Returns 1 if success, 0 if there is nothing
+ * to undo or redo.
+ */
+int undoEdit(Journal* journal);
+int redoEdit(Journal* journal);
+
+void freeJournal(Journal** journalPptr);
+
+#endif
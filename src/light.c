@@ -0,0 +1,474 @@
+/**
+ * Flood fill lighting. Changes are spread with a
+ * removal pass that clears the light that came
+ * through the changed mini cubes and an add pass
+ * that fills it back in from what is left.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "light.h"
+#include "palette.h"
+#include "arena.h"
+
+static const int LIGHT_QUEUE_SIZE = 1024;
+
+// Step to the neighbor on each CubeFace
+static const int FACE_STEPS[6][3] = {
+    {0, 0, 1}, {0, 0, -1},
+    {-1, 0, 0}, {1, 0, 0},
+    {0, 1, 0}, {0, -1, 0}
+};
+
+// Corners of each face in the same order as
+// addFace, 0 is the low side and 1 the high side
+static const int FACE_CORNERS[6][4][3] = {
+    {{0, 1, 1}, {1, 1, 1}, {0, 0, 1}, {1, 0, 1}},
+    {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 0}},
+    {{0, 0, 0}, {0, 1, 0}, {0, 0, 1}, {0, 1, 1}},
+    {{1, 0, 1}, {1, 1, 1}, {1, 0, 0}, {1, 1, 0}},
+    {{0, 1, 0}, {1, 1, 0}, {0, 1, 1}, {1, 1, 1}},
+    {{0, 0, 1}, {1, 0, 1}, {0, 0, 0}, {1, 0, 0}}
+};
+
+// Which half of the byte each channel is in
+enum LightChannel {
+    CUBE_LIGHT = 0,
+    SKY_LIGHT = 4
+};
+
+typedef struct _lightNode {
+    Region* reg;
+    int index;
+    int level;
+} LightNode;
+
+/**
+ * A ring of mini cubes still to spread from, kept
+ * in scratch space.
+ *
+ */
+typedef struct _lightQueue {
+    Arena* arena;
+    LightNode* nodes;
+    int head;
+    int count;
+    int capacity;
+} LightQueue;
+
+static void initLightQueue(LightQueue* queue, Arena* arena) {
+    queue->arena = arena;
+    queue->capacity = LIGHT_QUEUE_SIZE;
+    queue->nodes = arenaAlloc(arena, queue->capacity * sizeof(LightNode));
+    queue->head = 0;
+    queue->count = 0;
+}
+
+static void pushLight(LightQueue* queue, Region* reg, int index, int level) {
+    // Unroll the ring into a bigger one, the old
+    // one goes back with the arena
+    if (queue->count == queue->capacity) {
+        LightNode* nodes = arenaAlloc(queue->arena, queue->capacity * 2 * sizeof(LightNode));
+
+        for (int i = 0; i < queue->count; i++)
+            nodes[i] = queue->nodes[(queue->head + i) % queue->capacity];
+
+        queue->nodes = nodes;
+        queue->head = 0;
+        queue->capacity *= 2;
+    }
+
+    LightNode* node = &(queue->nodes[(queue->head + queue->count) % queue->capacity]);
+    node->reg = reg;
+    node->index = index;
+    node->level = level;
+    queue->count++;
+}
+
+static int popLight(LightQueue* queue, LightNode* node) {
+    if (queue->count == 0)
+        return 0;
+
+    *node = queue->nodes[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+
+    return 1;
+}
+
+static int getChannel(Region* reg, int index, enum LightChannel channel) {
+    return (reg->light[index] >> channel) & LIGHT_MAX;
+}
+
+static void setChannel(Region* reg, int index, enum LightChannel channel, int level) {
+    makeRegionWritable(reg, REGION_BLOCK_LIGHT);
+    reg->light[index] = (reg->light[index] & ~(LIGHT_MAX << channel)) | (level << channel);
+}
+
+/**
+ * Light goes through air and transparent mini
+ * cubes, only opaque ones stop it.
+ *
+ */
+static int isIndexOpaque(Region* reg, int index) {
+    int x = index % REGION_MCUBE_DEPTH;
+    int row = index / REGION_MCUBE_DEPTH;
+
+    return (getOccupancyPlane(reg, OCCUPANCY_OPAQUE)[row] >> x) & 1u;
+}
+
+static int getIndexEmitted(Region* reg, int index) {
+    int x = index % REGION_MCUBE_DEPTH;
+    int y = index / (REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH);
+    int z = (index / REGION_MCUBE_DEPTH) % REGION_MCUBE_DEPTH;
+
+    if (!isMCubeSolid(reg, x, y, z))
+        return 0;
+
+    return getPaletteLight(findPaletteID(getMCube(reg, x, y, z)));
+}
+
+/**
+ * Moves to the neighbor on a face, following the
+ * region links at the borders.
+ *
+ * Returns 0 if there is no region there.
+ */
+static int stepCell(Region** reg, int* index, enum CubeFace face) {
+    int pos[3] = {
+        *index % REGION_MCUBE_DEPTH,
+        *index / (REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH),
+        (*index / REGION_MCUBE_DEPTH) % REGION_MCUBE_DEPTH
+    };
+    const int steps[3] = {FACE_STEPS[face][0], FACE_STEPS[face][1], FACE_STEPS[face][2]};
+
+    Region* next = *reg;
+    for (int axis = 0; axis < 3; axis++) {
+        pos[axis] += steps[axis];
+
+        if (pos[axis] < 0 || pos[axis] >= REGION_MCUBE_DEPTH) {
+            next = getNeighbor(next, face);
+            pos[axis] -= steps[axis] * REGION_MCUBE_DEPTH;
+        }
+    }
+
+    if (next == NULL)
+        return 0;
+
+    *reg = next;
+    *index = pos[0] + pos[2] * REGION_MCUBE_DEPTH + pos[1] * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH;
+    return 1;
+}
+
+static void markLightChanged(EditBatch* batch, Region* reg, int index) {
+    if (batch == NULL)
+        return;
+
+    int pos[3] = {
+        index % REGION_MCUBE_DEPTH,
+        index / (REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH),
+        (index / REGION_MCUBE_DEPTH) % REGION_MCUBE_DEPTH
+    };
+    markRegionRemesh(batch, reg, pos, pos);
+}
+
+/**
+ * Clears light that came through removed mini
+ * cubes. Neighbors lit from somewhere else are
+ * queued to be spread again.
+ *
+ */
+static void removeLight(EditBatch* batch, LightQueue* removals, LightQueue* adds, enum LightChannel channel) {
+    LightNode node;
+
+    while (popLight(removals, &node)) {
+        for (int face = FRONT; face <= BOTTOM; face++) {
+            Region* reg = node.reg;
+            int index = node.index;
+
+            if (!stepCell(&reg, &index, face))
+                continue;
+
+            int level = getChannel(reg, index, channel);
+            if (level == 0)
+                continue;
+
+            // Opaque mini cubes are only lit when
+            // they give off light, they keep it the
+            // same as transparent ones that do
+            if (isIndexOpaque(reg, index) ||
+                (channel == CUBE_LIGHT && getIndexEmitted(reg, index) == level)) {
+                pushLight(adds, reg, index, level);
+                continue;
+            }
+
+            // Sky light going straight down doesn't
+            // fade so it can be as bright as its source
+            int fromAbove = channel == SKY_LIGHT && face == BOTTOM && node.level == LIGHT_MAX;
+
+            if (level < node.level || (fromAbove && level == LIGHT_MAX)) {
+                setChannel(reg, index, channel, 0);
+                markLightChanged(batch, reg, index);
+                pushLight(removals, reg, index, level);
+            }
+            else {
+                pushLight(adds, reg, index, level);
+            }
+        }
+    }
+}
+
+static void addLight(EditBatch* batch, LightQueue* adds, enum LightChannel channel) {
+    LightNode node;
+
+    while (popLight(adds, &node)) {
+        // Raised again after it was queued
+        if (getChannel(node.reg, node.index, channel) != node.level)
+            continue;
+
+        for (int face = FRONT; face <= BOTTOM; face++) {
+            Region* reg = node.reg;
+            int index = node.index;
+
+            if (!stepCell(&reg, &index, face) || isIndexOpaque(reg, index))
+                continue;
+
+            int level = node.level - 1;
+            if (channel == SKY_LIGHT && face == BOTTOM && node.level == LIGHT_MAX)
+                level = LIGHT_MAX;
+
+            if (level > getChannel(reg, index, channel)) {
+                setChannel(reg, index, channel, level);
+                markLightChanged(batch, reg, index);
+                pushLight(adds, reg, index, level);
+            }
+        }
+    }
+}
+
+/**
+ * The queues of one update, in scratch space
+ * from when it begins until it finishes.
+ *
+ */
+typedef struct _lightUpdate {
+    EditBatch* batch;
+    Region* reg;
+
+    Arena* scratch;
+    size_t mark;
+
+    LightQueue skyRemovals;
+    LightQueue skyAdds;
+    LightQueue cubeRemovals;
+    LightQueue cubeAdds;
+
+    // With nothing above the top layer is open
+    // sky, -1 otherwise
+    int skyLayer;
+} LightUpdate;
+
+static void beginLightUpdate(LightUpdate* update, EditBatch* batch, Region* reg) {
+    update->batch = batch;
+    update->reg = reg;
+    update->scratch = getScratchArena();
+    update->mark = getArenaMark(update->scratch);
+
+    initLightQueue(&(update->skyRemovals), update->scratch);
+    initLightQueue(&(update->skyAdds), update->scratch);
+    initLightQueue(&(update->cubeRemovals), update->scratch);
+    initLightQueue(&(update->cubeAdds), update->scratch);
+
+    update->skyLayer = reg->up == NULL ? REGION_MCUBE_DEPTH - 1 : -1;
+}
+
+/**
+ * Clears a changed mini cube so it is spread
+ * again from its neighbors, even dark mini cubes
+ * may be lit by them now.
+ *
+ */
+static void seedLight(LightUpdate* update, int index) {
+    Region* reg = update->reg;
+
+    pushLight(&(update->skyRemovals), reg, index, getChannel(reg, index, SKY_LIGHT));
+    pushLight(&(update->cubeRemovals), reg, index, getChannel(reg, index, CUBE_LIGHT));
+    makeRegionWritable(reg, REGION_BLOCK_LIGHT);
+    reg->light[index] = 0;
+
+    int emitted = getIndexEmitted(reg, index);
+
+    if (emitted > 0) {
+        setChannel(reg, index, CUBE_LIGHT, emitted);
+        pushLight(&(update->cubeAdds), reg, index, emitted);
+    }
+
+    if (index / (REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH) == update->skyLayer && !isIndexOpaque(reg, index)) {
+        setChannel(reg, index, SKY_LIGHT, LIGHT_MAX);
+        pushLight(&(update->skyAdds), reg, index, LIGHT_MAX);
+    }
+
+    markLightChanged(update->batch, reg, index);
+}
+
+static void finishLightUpdate(LightUpdate* update) {
+    removeLight(update->batch, &(update->skyRemovals), &(update->skyAdds), SKY_LIGHT);
+    addLight(update->batch, &(update->skyAdds), SKY_LIGHT);
+
+    removeLight(update->batch, &(update->cubeRemovals), &(update->cubeAdds), CUBE_LIGHT);
+    addLight(update->batch, &(update->cubeAdds), CUBE_LIGHT);
+
+    rewindArena(update->scratch, update->mark);
+}
+
+void updateLight(EditBatch* batch, Region* reg, int lo[3], int hi[3]) {
+    LightUpdate update;
+    beginLightUpdate(&update, batch, reg);
+
+    for (int y = lo[1]; y <= hi[1]; y++) {
+        for (int z = lo[2]; z <= hi[2]; z++) {
+            for (int x = lo[0]; x <= hi[0]; x++)
+                seedLight(&update, x + z * REGION_MCUBE_DEPTH + y * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH);
+        }
+    }
+
+    finishLightUpdate(&update);
+}
+
+void updateLightRuns(EditBatch* batch, Region* reg, CellRun* runs, int count) {
+    if (count == 0)
+        return;
+
+    LightUpdate update;
+    beginLightUpdate(&update, batch, reg);
+
+    for (int i = 0; i < count; i++) {
+        for (int index = runs[i].start; index < runs[i].start + runs[i].length; index++)
+            seedLight(&update, index);
+    }
+
+    finishLightUpdate(&update);
+}
+
+int getCubeLightClass(char* cubeID) {
+    if (isSameCube(cubeID, AIR_CUBE))
+        return 0;
+
+    uint16_t paletteID = findPaletteID(cubeID);
+    int opaque = !isPaletteTransparent(paletteID);
+
+    return getPaletteLight(paletteID) << 1 | opaque;
+}
+
+void lightRegion(Region* reg) {
+    int lo[3] = {0, 0, 0};
+    int hi[3] = {REGION_MCUBE_DEPTH - 1, REGION_MCUBE_DEPTH - 1, REGION_MCUBE_DEPTH - 1};
+
+    updateLight(NULL, reg, lo, hi);
+
+    // Most regions are all sky or all dark and
+    // can give their own light back
+    shareUniformLight(reg);
+}
+
+/**
+ * Follows the region links until x, y and z are
+ * inside the region.
+ *
+ * Returns NULL if a region on the way is missing.
+ */
+static Region* findCell(Region* reg, int* x, int* y, int* z) {
+    int* pos[3] = {x, y, z};
+    const enum CubeFace lowFaces[3] = {LEFT, BOTTOM, BACK};
+    const enum CubeFace highFaces[3] = {RIGHT, TOP, FRONT};
+
+    for (int axis = 0; axis < 3 && reg != NULL; axis++) {
+        if (*pos[axis] < 0) {
+            reg = getNeighbor(reg, lowFaces[axis]);
+            *pos[axis] += REGION_MCUBE_DEPTH;
+        }
+        else if (*pos[axis] >= REGION_MCUBE_DEPTH) {
+            reg = getNeighbor(reg, highFaces[axis]);
+            *pos[axis] -= REGION_MCUBE_DEPTH;
+        }
+    }
+
+    return reg;
+}
+
+uint8_t getLight(Region* reg, int x, int y, int z) {
+    reg = findCell(reg, &x, &y, &z);
+
+    if (reg == NULL)
+        return LIGHT_SKY_FULL;
+
+    return reg->light[x + z * REGION_MCUBE_DEPTH + y * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH];
+}
+
+/**
+ * Light of a mini cube a face samples, opaque ones
+ * count as dark. Faces under water take the light
+ * that came through it.
+ *
+ */
+static uint8_t sampleLight(Region* reg, int x, int y, int z) {
+    // Most samples are inside the region
+    if ((unsigned) x >= (unsigned) REGION_MCUBE_DEPTH ||
+        (unsigned) y >= (unsigned) REGION_MCUBE_DEPTH ||
+        (unsigned) z >= (unsigned) REGION_MCUBE_DEPTH) {
+        reg = findCell(reg, &x, &y, &z);
+
+        if (reg == NULL)
+            return LIGHT_SKY_FULL;
+    }
+
+    if (isIndexOpaque(reg, x + z * REGION_MCUBE_DEPTH + y * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH))
+        return 0;
+
+    return reg->light[x + z * REGION_MCUBE_DEPTH + y * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH];
+}
+
+uint32_t getFaceLight(Region* reg, int x, int y, int z, enum CubeFace face) {
+    // The mini cube the face looks into
+    int front[3] = {x + FACE_STEPS[face][0], y + FACE_STEPS[face][1], z + FACE_STEPS[face][2]};
+
+    // The two axes the face lies in
+    int normal = FACE_STEPS[face][0] != 0 ? 0 : (FACE_STEPS[face][1] != 0 ? 1 : 2);
+    int u = (normal + 1) % 3;
+    int v = (normal + 2) % 3;
+
+    // The front mini cube and the eight around it
+    // in the plane of the face
+    uint8_t samples[3][3];
+    for (int su = 0; su < 3; su++) {
+        for (int sv = 0; sv < 3; sv++) {
+            int pos[3] = {front[0], front[1], front[2]};
+            pos[u] += su - 1;
+            pos[v] += sv - 1;
+
+            samples[su][sv] = sampleLight(reg, pos[0], pos[1], pos[2]);
+        }
+    }
+
+    uint32_t result = 0;
+
+    for (int corner = 0; corner < 4; corner++) {
+        // Each corner is shared with the mini cubes
+        // beside and diagonal to the front one
+        int cu = FACE_CORNERS[face][corner][u] ? 2 : 0;
+        int cv = FACE_CORNERS[face][corner][v] ? 2 : 0;
+
+        uint8_t centre = samples[1][1];
+        uint8_t side1 = samples[cu][1];
+        uint8_t side2 = samples[1][cv];
+        uint8_t diagonal = samples[cu][cv];
+
+        int sky = ((centre >> 4) + (side1 >> 4) + (side2 >> 4) + (diagonal >> 4) + 2) / 4;
+        int cube = ((centre & LIGHT_MAX) + (side1 & LIGHT_MAX) + (side2 & LIGHT_MAX) + (diagonal & LIGHT_MAX) + 2) / 4;
+
+        result |= (uint32_t) ((sky << 4) | cube) << (corner * 8);
+    }
+
+    return result;
+}
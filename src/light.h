@@ -0,0 +1,81 @@
+#include <stdint.h>
+
+#include "region.h"
+#include "edit.h"
+
+#ifndef LIGHT_H
+#define LIGHT_H
+
+/**
+ * Light is kept per mini cube in one byte, sky
+ * light in the high 4 bits and cube light in the
+ * low 4. Sky light comes down from regions with
+ * nothing above them without fading, everything
+ * else loses a level per mini cube it spreads.
+ *
+ */
+#define LIGHT_MAX 15
+#define LIGHT_SKY_FULL ((uint8_t) (LIGHT_MAX << 4))
+
+/**
+ * Relights the mini cubes lo to hi (inclusive)
+ * after they changed, along with whatever got its
+ * light through them. Only light that can have
+ * changed is touched. Regions whose faces see a
+ * change are queued on the batch, which can be
+ * NULL when nothing is meshed yet.
+ *
+ */
+void updateLight(EditBatch* batch, Region* reg, int lo[3], int hi[3]);
+
+/**
+ * Cells start to start + length - 1 of a region,
+ * runs along x can carry on into the next row.
+ *
+ */
+typedef struct _cellRun {
+    int start;
+    int length;
+} CellRun;
+
+/**
+ * Same as updateLight for only the runs of mini
+ * cubes given, the rest of the box an edit
+ * covered is left as it is.
+ *
+ */
+void updateLightRuns(EditBatch* batch, Region* reg, CellRun* runs, int count);
+
+/**
+ * What light sees of a cube, whether it stops
+ * light and how much it gives off. Mini cubes
+ * can change between cubes of the same class
+ * without any light changing.
+ *
+ */
+int getCubeLightClass(char* cubeID);
+
+/**
+ * Lights a whole region from scratch, for regions
+ * made without edits.
+ *
+ */
+void lightRegion(Region* reg);
+
+/**
+ * Light of any mini cube up to a region away, the
+ * neighbors are followed on each axis. Missing
+ * regions are open sky.
+ *
+ */
+uint8_t getLight(Region* reg, int x, int y, int z);
+
+/**
+ * Light at the four corners of a face, one byte
+ * each in the order addFace makes them. Corners
+ * next to solid mini cubes are darker.
+ *
+ */
+uint32_t getFaceLight(Region* reg, int x, int y, int z, enum CubeFace face);
+
+#endif
@@ -3,104 +3,821 @@
  *
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <SDL2/SDL.h>
 #include <glad/glad.h>
 #include <cglm/struct.h>
 #include <cglm/util.h>
 
 #include "shader.h"
+#include "asset.h"
 #include "camera.h"
 #include "mesh.h"
 #include "region.h"
+#include "palette.h"
+#include "pacing.h"
+#include "physics.h"
+#include "memstats.h"
+#include "arena.h"
+#include "jobs.h"
+#include "remesh.h"
+#include "compress.h"
+#include "cull.h"
+#include "light.h"
+#include "raycast.h"
+#include "edit.h"
+#include "journal.h"
+#include "replay.h"
+#include "headless.h"
+#include "bench.h"
+#include "radix.h"
 
-int main() {
-    printf("Hello world!\n");
+#define WORLD_REGIONS 5
 
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        fprintf(stderr, "ERROR: SDL could not be initialized\n");
-        return 1;
-    }
+// Simulation ticks per second unless set
+// with --tick-rate
+static const int DEFAULT_TICK_RATE = 60;
 
-    SDL_Window* window = SDL_CreateWindow(
-            "Mini Cubes",
-            SDL_WINDOWPOS_CENTERED,
-            SDL_WINDOWPOS_CENTERED,
-            800, 800,
-            SDL_WINDOW_OPENGL
-            );
+// Frame rate for --present capped unless set
+// with --fps
+static const double DEFAULT_CAPPED_FPS = 60.0;
 
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
-    SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
-    
-    //SDL_GLContext context = SDL_GL_CreateContext(window);
-    SDL_GL_CreateContext(window);
-    gladLoadGLLoader(SDL_GL_GetProcAddress);
+// Seconds between frame time reports
+static const double FRAME_REPORT_SECONDS = 5.0;
 
-    GLuint verShaderID, fragShaderID;
+// Where the world is drawn from the region
+// positions, the camera is in drawn space
+static const vec3s WORLD_OFFSET = {.x = 0.0f, .y = -16.0f, .z = 0.0f};
 
-    compileShader(&verShaderID, GL_VERTEX_SHADER, "assets/vertex.glsl");
-    compileShader(&fragShaderID, GL_FRAGMENT_SHADER, "assets/frag.glsl");
+// Box the camera collides with, the eyes are
+// this far above its center
+static const vec3s PLAYER_HALF_SIZE = {.x = 0.3f, .y = 0.9f, .z = 0.3f};
+static const float PLAYER_EYE_HEIGHT = 0.7f;
 
-    GLuint programID = linkShader(verShaderID, fragShaderID);
+// How much of what is behind transparent cubes
+// shows through them
+static const float CLEAR_ALPHA = 0.5f;
 
-    Camera* cam = initCamera();
+// Size of the window, headless runs pick their
+// own with --headless
+static const int WINDOW_WIDTH = 800;
+static const int WINDOW_HEIGHT = 800;
+
+// Frames drawn headless when there is no trace
+// or --frames to say otherwise
+static const int DEFAULT_HEADLESS_FRAMES = 600;
+
+// Degrees the camera turns each tick in the
+// headless scene so every side of the world
+// gets drawn, looking down at it
+static const float HEADLESS_TURN = 0.6f;
+static const float HEADLESS_PITCH = 35.0f;
+
+// Prints the memory stats when pressed
+static const SDL_Scancode MEMORY_REPORT_KEY = SDL_SCANCODE_F3;
+
+// Undo and redo the player's edits
+static const SDL_Scancode UNDO_KEY = SDL_SCANCODE_Z;
+static const SDL_Scancode REDO_KEY = SDL_SCANCODE_Y;
+
+// How far from the eyes the mouse buttons edit,
+// in world units
+static const float EDIT_REACH = 6.0f;
+
+// The left button digs a ball this many mini
+// cubes across and the right one places a cube
+static const float DIG_RADIUS = 2.5f;
+static char* PLACE_CUBE_ID = "1";
+
+// Mini cube next to each face of another
+static const int FACE_NORMALS[6][3] = {
+    {0, 0, 1}, {0, 0, -1},
+    {-1, 0, 0}, {1, 0, 0},
+    {0, 1, 0}, {0, -1, 0}
+};
+
+enum EditAction {
+    EDIT_NONE,
+    EDIT_DIG,
+    EDIT_PLACE,
+    EDIT_UNDO,
+    EDIT_REDO
+};
+
+/**
+ * The regions loaded at startup. They are made
+ * and meshed as jobs while the window and
+ * shaders are set up.
+ *
+ */
+typedef struct _world {
+    Region** regions;
+    int count;
+
+    // Indices of the regions nearest the eye
+    // first, sorted again when it moves into
+    // another region (see orderRegions)
+    uint32_t* drawOrder;
+    int orderCell[3];
+
+    // Generated for --bench instead of the test
+    // regions when set
+    const BenchScene* scene;
+
+    // Done once every region is made and meshed
+    JobCounter loaded;
+    JobCounter meshed;
+
+    // Performance counters when loading started,
+    // when the regions were made and lit and when
+    // they were all meshed
+    Uint64 started;
+    Uint64 made;
+    Uint64 ready;
+} World;
+
+static double elapsedMs(Uint64 start) {
+    return (double) (SDL_GetPerformanceCounter() - start) * 1000.0 / (double) SDL_GetPerformanceFrequency();
+}
+
+/**
+ * Each region only writes its own mesh so they
+ * can be built side by side.
+ *
+ */
+static void meshRegion(void* data) {
+    updateRegionMesh(data);
+}
+
+static void markWorldReady(void* data) {
+    World* world = data;
+    world->ready = SDL_GetPerformanceCounter();
+}
+
+/**
+ * Sorts the draw order by the distance from the
+ * eye (in region space) to the middle of each
+ * region. Regions don't overlap so the order only
+ * changes when the eye crosses into another one.
+ *
+ */
+static void orderRegions(World* world, vec3s eye) {
+    const float size = REGION_MCUBE_DEPTH * REGION_MCUBE_SIZE;
+    int cell[3] = {
+        (int) floorf(eye.x / size),
+        (int) floorf(eye.y / size),
+        (int) floorf(eye.z / size)
+    };
+
+    if (world->drawOrder != NULL && memcmp(cell, world->orderCell, sizeof(cell)) == 0)
+        return;
+
+    if (world->drawOrder == NULL) {
+        world->drawOrder = malloc(world->count * sizeof(uint32_t));
+
+        if (world->drawOrder == NULL) {
+            fprintf(stderr, "ERROR: unable to allocate memory for program!\n");
+            exit(1);
+        }
+    }
+
+    memcpy(world->orderCell, cell, sizeof(cell));
+
+    Arena* scratch = getScratchArena();
+    size_t mark = getArenaMark(scratch);
+    uint32_t* keys = arenaAlloc(scratch, world->count * sizeof(uint32_t));
+    const vec3s half = {.x = size / 2.0f, .y = size / 2.0f, .z = size / 2.0f};
 
+    for (int i = 0; i < world->count; i++) {
+        vec3s middle = glms_vec3_add(world->regions[i]->meshPtr->position, half);
+        vec3s offset = glms_vec3_sub(middle, eye);
+
+        keys[i] = getDistanceKey(glms_vec3_dot(offset, offset));
+        world->drawOrder[i] = i;
+    }
+
+    radixSort(keys, world->drawOrder, world->count, scratch);
+    rewindArena(scratch, mark);
+}
+
+static void makeTestWorld(World* world) {
     // Test regions
+    const float size = REGION_MCUBE_DEPTH * REGION_MCUBE_SIZE;
+
     Region* test = initRegion((vec3s) {.x = 0.0f, .y = 0.0f, .z = 0.0f});
-    Region* testfront = initRegion((vec3s) {.x = 0.0f, .y = 0.0f, .z = 8.0f});
-    Region* testback = initRegion((vec3s) {.x = 0.0f, .y = 0.0f, .z = -8.0f});
-    Region* testleft = initRegion((vec3s) {.x = -8.0f, .y = 0.0f, .z = 0.0f});
-    Region* testright = initRegion((vec3s) {.x = 8.0f, .y = 0.0f, .z = 0.0f});
+    Region* testfront = initRegion((vec3s) {.x = 0.0f, .y = 0.0f, .z = size});
+    Region* testback = initRegion((vec3s) {.x = 0.0f, .y = 0.0f, .z = -size});
+    Region* testleft = initRegion((vec3s) {.x = -size, .y = 0.0f, .z = 0.0f});
+    Region* testright = initRegion((vec3s) {.x = size, .y = 0.0f, .z = 0.0f});
 
     connectRegions(test, testfront, FRONT);
     connectRegions(test, testback, BACK);
     connectRegions(test, testleft, LEFT);
     connectRegions(test, testright, RIGHT);
 
-    fillRegion("1", test);
-    //fillRegion("1", testfront);
+    // Cube IDs go in the palette before meshing
+    // so the meshers only ever read it
+    getPaletteID("1");
+
+    // Meshed all at once below
+    setRegionFill("1", test);
     setMCube("1", testfront, (vec3s) {.x = 0.0f, .y = 0.0f, .z = 0.0f});
-    fillRegion("1", testback);
-    fillRegion("1", testleft);
-    fillRegion("1", testright);
+    setRegionFill("1", testback);
+    setRegionFill("1", testleft);
+    setRegionFill("1", testright);
+
+    world->regions = malloc(WORLD_REGIONS * sizeof(Region*));
+
+    if (world->regions == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate memory for program!\n");
+        exit(1);
+    }
+
+    world->regions[0] = test;
+    world->regions[1] = testfront;
+    world->regions[2] = testback;
+    world->regions[3] = testleft;
+    world->regions[4] = testright;
+    world->count = 5;
+
+    // Light spreads between regions so it is done
+    // before any of them are meshed
+    for (int i = 0; i < world->count; i++)
+        lightRegion(world->regions[i]);
+}
+
+static void loadWorld(void* data) {
+    World* world = data;
+    world->started = SDL_GetPerformanceCounter();
+
+    if (world->scene != NULL)
+        world->regions = generateBenchWorld(world->scene, &(world->count));
+    else
+        makeTestWorld(world);
+
+    world->made = SDL_GetPerformanceCounter();
+
+    for (int i = 0; i < world->count; i++)
+        runJob(meshRegion, world->regions[i], &(world->meshed));
+
+    // Counted on loaded so waiting for the world
+    // covers the meshing too
+    runJobAfter(&(world->meshed), JOB_ANY_THREAD, markWorldReady, world, &(world->loaded));
+}
+
+/**
+ * Gives up on starting when the window can't be
+ * made. The workers are still building the world
+ * so it has to finish before they are stopped.
+ *
+ */
+static void abandonStartup(World* world, Trace** trace) {
+    waitForJobs(&(world->loaded));
+
+    if (*trace != NULL)
+        freeTrace(trace);
+
+    freeJobs();
+}
+
+/**
+ * Works out the edit a mouse button makes where
+ * the camera is looking. Edits are kept in the
+ * form they are recorded in so replays make
+ * them the same way.
+ *
+ * Returns 0 if nothing is in reach.
+ */
+static int aimEdit(World* world, Camera* cam, enum EditAction action, TraceEdit* edit) {
+    RayHit hit;
+    vec3s origin = glms_vec3_sub(cam->position, WORLD_OFFSET);
+
+    if (!raycast(world->regions[0], origin, cam->front, EDIT_REACH, &hit))
+        return 0;
+
+    int anchor = -1;
+    for (int i = 0; i < world->count; i++) {
+        if (world->regions[i] == hit.region)
+            anchor = i;
+    }
+
+    if (anchor < 0)
+        return 0;
+
+    memset(edit, 0, sizeof(TraceEdit));
+    edit->anchor = anchor;
+
+    int cell[3] = {hit.x, hit.y, hit.z};
+
+    if (action == EDIT_DIG) {
+        edit->kind = TRACE_FILL_SPHERE;
+        edit->radius = DIG_RADIUS;
+    }
+    else {
+        edit->kind = TRACE_FILL_BOX;
+        strncpy(edit->cubeID, PLACE_CUBE_ID, TRACE_CUBE_ID_LENGTH - 1);
+
+        for (int i = 0; i < 3; i++)
+            cell[i] += FACE_NORMALS[hit.face][i];
+    }
+
+    for (int i = 0; i < 3; i++) {
+        edit->from[i] = cell[i];
+        edit->to[i] = cell[i];
+    }
+
+    return 1;
+}
+
+/**
+ * Measures everything the world holds and
+ * prints it.
+ *
+ */
+static void measureMemory(World* world, MemoryStats* stats) {
+    clearMemoryStats(stats);
+
+    for (int i = 0; i < world->count; i++)
+        addRegionMemory(stats, world->regions[i]);
+    addSharedMeshMemory(stats);
+    addJournalMemory(stats, getActiveJournal());
+    addArenaMemory(stats);
+}
+
+static void reportMemory(World* world) {
+    MemoryStats stats;
+    measureMemory(world, &stats);
+
+    printMemoryStats(&stats);
+}
+
+/**
+ * Fills in what a --bench run measured once it
+ * is over.
+ *
+ */
+static void finishBench(World* world, BenchResult* result, Headless* offscreen) {
+    double frequency = (double) SDL_GetPerformanceFrequency();
+
+    result->scene = world->scene;
+    result->regionCount = world->count;
+    result->generateTime = (double) (world->made - world->started) * 1000.0 / frequency;
+    result->meshTime = (double) (world->ready - world->made) * 1000.0 / frequency;
+
+    result->faces = 0;
+    result->clearFaces = 0;
+    for (int i = 0; i < world->count; i++) {
+        Mesh* meshPtr = world->regions[i]->meshPtr;
+
+        for (int j = 0; j < meshPtr->sectionCount; j++) {
+            result->faces += meshPtr->sections[j].faceCount;
+            result->clearFaces += meshPtr->sections[j].clearCount;
+        }
+    }
+
+    result->cpuTimes = offscreen != NULL ? &(offscreen->cpuTimes) : NULL;
+    result->gpuTimes = offscreen != NULL ? &(offscreen->gpuTimes) : NULL;
+    result->counters = getMeshCounters();
+
+    measureMemory(world, &(result->memory));
+    measureCullKernels(result, world->regions, world->count);
+    measureMeshing(result, world->regions, world->count);
+    measurePhysics(result, world->regions, world->count);
+
+    // Last since it edits the world
+    measureEdits(result, world->regions, world->count);
+}
+
+int main(int argc, char** argv) {
+    Uint64 startTime = SDL_GetPerformanceCounter();
+
+    fprintf(stderr, "Hello world!\n");
+
+    int tickRate = DEFAULT_TICK_RATE;
+    int presentMode = PRESENT_VSYNC;
+    double targetFps = DEFAULT_CAPPED_FPS;
+    int noclip = 0;
+    double memoryReportSeconds = 0.0;
+    const char* recordPath = NULL;
+    const char* replayPath = NULL;
+    int headless = 0;
+    int width = WINDOW_WIDTH;
+    int height = WINDOW_HEIGHT;
+    int frameLimit = 0;
+    const BenchScene* benchScene = NULL;
+    const char* bundlePath = NULL;
+
+    // --faces draws with one record per face
+    // instead of four vertices
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--faces") == 0)
+            setMeshMode(MESH_FACES);
+        else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc)
+            tickRate = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--present") == 0 && i + 1 < argc)
+            presentMode = getPresentMode(argv[++i]);
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+            targetFps = atof(argv[++i]);
+        else if (strcmp(argv[i], "--noclip") == 0)
+            noclip = 1;
+        else if (strcmp(argv[i], "--mem-report") == 0 && i + 1 < argc)
+            memoryReportSeconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--region-memory") == 0 && i + 1 < argc)
+            setColdRegionTarget((size_t) (atof(argv[++i]) * 1024.0 * 1024.0));
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            replayPath = argv[++i];
+        else if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+            headless = 1;
+            if (sscanf(argv[++i], "%dx%d", &width, &height) != 2)
+                width = height = 0;
+        }
+        else if (strcmp(argv[i], "--cull") == 0 && i + 1 < argc) {
+            int kernel = findCullKernel(argv[++i]);
+
+            if (kernel < 0 || !setCullKernel(kernel)) {
+                fprintf(stderr, "ERROR: Culling kernel %s isn't available on this CPU\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--bundle") == 0 && i + 1 < argc)
+            bundlePath = argv[++i];
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frameLimit = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            benchScene = getBenchScene(argv[++i]);
+
+            if (benchScene == NULL) {
+                fprintf(stderr, "ERROR: No bench scene %s, the scenes are\n", argv[i]);
+                printBenchScenes();
+                return 1;
+            }
+        }
+    }
+
+    if (presentMode < 0) {
+        fprintf(stderr, "ERROR: Present mode has to be vsync, adaptive, uncapped or capped\n");
+        return 1;
+    }
+
+    if (tickRate <= 0) {
+        fprintf(stderr, "ERROR: Tick rate has to be above 0\n");
+        return 1;
+    }
+
+    if (width <= 0 || height <= 0) {
+        fprintf(stderr, "ERROR: Headless size has to be given as WIDTHxHEIGHT\n");
+        return 1;
+    }
+
+    if (recordPath != NULL && replayPath != NULL) {
+        fprintf(stderr, "ERROR: Can't record and replay at once\n");
+        return 1;
+    }
+
+    if (benchScene != NULL && (recordPath != NULL || replayPath != NULL)) {
+        fprintf(stderr, "ERROR: Bench scenes fly their own path, they can't be recorded or replayed\n");
+        return 1;
+    }
+
+    // The bench camera flies through the terrain
+    // for a set number of frames
+    int benchmarking = benchScene != NULL;
+    BenchResult benchResult;
+    memset(&benchResult, 0, sizeof(BenchResult));
+
+    if (benchmarking) {
+        noclip = 1;
+
+        if (frameLimit <= 0)
+            frameLimit = benchScene->ticks;
+    }
+
+    // A replay runs at the tick rate it was
+    // recorded at and takes no input
+    Trace* trace = NULL;
+    int replaying = replayPath != NULL;
+
+    if (replaying) {
+        trace = startReplay(replayPath);
+        if (trace == NULL)
+            return 1;
+
+        tickRate = trace->tickRate;
+        noclip = (trace->flags & TRACE_NOCLIP) != 0;
+    }
+    else if (recordPath != NULL) {
+        trace = startRecording(recordPath, tickRate, noclip ? TRACE_NOCLIP : 0);
+        if (trace == NULL)
+            return 1;
+    }
+
+    // Leaves a core for the window and shaders
+    initJobs(0);
+
+    fprintf(stderr, "Culling faces with %s\n", getCullKernelName(getCullKernel()));
+
+    // The world is made while everything else
+    // starts up
+    World world;
+    world.regions = NULL;
+    world.count = 0;
+    world.drawOrder = NULL;
+    world.scene = benchScene;
+    initJobCounter(&(world.loaded));
+    initJobCounter(&(world.meshed));
+
+    runJob(loadWorld, &world, &(world.loaded));
+
+    SDL_Window* window = NULL;
+    Headless* offscreen = NULL;
+
+    // Headless runs never touch SDL video, the
+    // context comes from EGL instead
+    if (headless) {
+        offscreen = initHeadless(width, height);
+        if (offscreen == NULL) {
+            abandonStartup(&world, &trace);
+            return 1;
+        }
+
+        // Nothing to wait for without a display
+        presentMode = PRESENT_UNCAPPED;
+
+        if (frameLimit <= 0 && !replaying)
+            frameLimit = DEFAULT_HEADLESS_FRAMES;
+    }
+    else {
+        if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+            fprintf(stderr, "ERROR: SDL could not be initialized\n");
+            abandonStartup(&world, &trace);
+            return 1;
+        }
+
+        window = SDL_CreateWindow(
+                "Mini Cubes",
+                SDL_WINDOWPOS_CENTERED,
+                SDL_WINDOWPOS_CENTERED,
+                width, height,
+                SDL_WINDOW_OPENGL
+                );
+
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
+        SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+        SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+
+        //SDL_GLContext context = SDL_GL_CreateContext(window);
+        SDL_GL_CreateContext(window);
+        gladLoadGLLoader(SDL_GL_GetProcAddress);
+    }
+
+    // Let the driver compile on its own threads
+    if (GLAD_GL_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+    // Made with make bundle and only used when
+    // asked for, loose files in assets otherwise
+    if (bundlePath != NULL) {
+        if (openAssetBundle(bundlePath) == 0)
+            fprintf(stderr, "Using asset bundle %s\n", bundlePath);
+        else
+            fprintf(stderr, "WARNING: Cannot open asset bundle %s, using the loose files\n", bundlePath);
+    }
+
+    const char* vertexPath = getMeshMode() == MESH_FACES ? "assets/face_vertex.glsl" : "assets/vertex.glsl";
+
+    ProgramBuild build;
+    startProgram(&build, vertexPath, "assets/frag.glsl");
+
+    Camera* cam = initCamera();
+
+    waitForJobs(&(world.loaded));
+
+    // Only edits made after the world is built
+    // can be undone
+    Journal* journal = initJournal(JOURNAL_DEFAULT_BUDGET);
+    setActiveJournal(journal);
+
+    // Edits from here on are meshed by the workers
+    // while the frames carry on
+    setEditRemeshAsync(1);
+
+    fprintf(stderr, "World ready after %.2f ms\n", (double) (world.ready - startTime) * 1000.0 / (double) SDL_GetPerformanceFrequency());
+
+    GLuint programID = finishProgram(&build);
 
     // Declare transform matrices
     mat4s model = glms_mat4_identity();
-    glm_translate(model.raw, (vec3s) {.x = 0.0f, .y = -16.0f, .z = 0.0f}.raw);
+    model = glms_translate(model, WORLD_OFFSET);
     mat4s view = glms_mat4_zero();
     mat4s projection = glms_mat4_zero();
 
-    SDL_SetRelativeMouseMode(SDL_TRUE);
-    Uint32 lastUpdate = SDL_GetTicks();
+    Body player = {
+        .position = glms_vec3_sub(cam->position, WORLD_OFFSET),
+        .halfSize = PLAYER_HALF_SIZE,
+        .velocity = {.x = 0.0f, .y = 0.0f, .z = 0.0f},
+        .contacts = 0
+    };
+    player.position.y -= PLAYER_EYE_HEIGHT;
+
+    if (!headless)
+        SDL_SetRelativeMouseMode(SDL_TRUE);
+
+    FramePacer* pacer = initFramePacer(presentMode, targetFps, FRAME_REPORT_SECONDS);
+
+    // The simulation runs in fixed ticks kept in
+    // performance counter units so time isn't
+    // lost to rounding
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 tickLength = frequency / tickRate;
+    float tickSeconds = (float) tickLength / (float) frequency;
+
+    // Past this a stalled frame is dropped rather
+    // than caught up on
+    Uint64 maxFrameTime = frequency / 4;
+
+    // Memory is only reported on the key unless
+    // --mem-report sets an interval
+    Uint64 memoryReportLength = (Uint64) (frequency * memoryReportSeconds);
+    Uint64 lastMemoryReport = SDL_GetPerformanceCounter();
+
+    // Worker use is reported with the frame times
+    Uint64 jobReportLength = (Uint64) (frequency * FRAME_REPORT_SECONDS);
+    Uint64 lastJobReport = SDL_GetPerformanceCounter();
+
+    Uint64 accumulator = 0;
+    Uint64 lastUpdate = SDL_GetPerformanceCounter();
+
+    uint32_t tickCount = 0;
+    enum EditAction pendingEdit = EDIT_NONE;
 
     int exited = 0;
+    int firstFrame = 1;
+    int frames = 0;
 
     while (!exited) {
-        Uint32 current = SDL_GetTicks();
-        float deltaTime = (current - lastUpdate) / 1000.0f;
+        // Waiting happens before input is read so
+        // it doesn't add to the latency
+        waitForFrame(pacer);
+
+        if (headless)
+            beginHeadlessFrame(offscreen);
+
+        glViewport(0, 0, width, height);
+
+        glClearColor(0.3f, 0.3f, 0.6f, 1.f);
+        glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+
+        Uint64 current = SDL_GetPerformanceCounter();
+        Uint64 frameTime = current - lastUpdate;
+        lastUpdate = current;
+
+        if (frameTime > maxFrameTime)
+            frameTime = maxFrameTime;
+        accumulator += frameTime;
 
-        glViewport(0, 0, 800, 800);
-    
         SDL_Event event;
 
-        while (SDL_PollEvent(&event)) {
+        while (!headless && SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) {
                 exited = 1;
             }
-            updateCameraLook(cam, event, deltaTime);
+            else if (event.type == SDL_KEYDOWN && !event.key.repeat &&
+                     event.key.keysym.scancode == MEMORY_REPORT_KEY) {
+                reportMemory(&world);
+            }
+
+            if (replaying || benchmarking)
+                continue;
+
+            // Made on the next tick so they land in
+            // the same place when replayed
+            if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT)
+                pendingEdit = EDIT_DIG;
+            else if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_RIGHT)
+                pendingEdit = EDIT_PLACE;
+
+            // Traces can't hold undos so they are
+            // left out while recording
+            if (trace == NULL && event.type == SDL_KEYDOWN && !event.key.repeat) {
+                if (event.key.keysym.scancode == UNDO_KEY)
+                    pendingEdit = EDIT_UNDO;
+                else if (event.key.keysym.scancode == REDO_KEY)
+                    pendingEdit = EDIT_REDO;
+            }
+
+            updateCameraLook(cam, event);
         }
 
-        updateCameraMovement(cam, deltaTime);
+        markInputSampled(pacer);
 
-        glClearColor(0.3f, 0.3f, 0.6f, 1.f);
-        glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+        // GL work queued by other threads
+        runMainJobs();
+
+        // Replays, benches and headless runs go one
+        // tick a frame so every build draws the
+        // same frames
+        if (replaying || benchmarking || headless)
+            accumulator = tickLength;
+
+        while (accumulator >= tickLength) {
+            TraceTick tick = {
+                .tick = tickCount,
+                .yaw = cam->yaw,
+                .pitch = cam->pitch,
+                .keys = headless || benchmarking ? 0 : getCameraKeys()
+            };
+
+            TraceEdit edit;
+
+            // Without a trace the headless scene just
+            // turns on the spot
+            if (headless && !replaying && !benchmarking) {
+                tick.yaw += HEADLESS_TURN;
+                tick.pitch = HEADLESS_PITCH;
+            }
+
+            if (benchmarking) {
+                vec3s eye;
+                getBenchCamera(world.scene, tickCount, &eye, &(tick.yaw), &(tick.pitch));
+
+                player.position = eye;
+                player.position.y -= PLAYER_EYE_HEIGHT;
+            }
+
+            if (replaying) {
+                while (readTraceEdit(trace, &edit))
+                    applyTraceEdit(&edit, world.regions, world.count);
+
+                if (!readTraceTick(trace, &tick)) {
+                    exited = 1;
+                    break;
+                }
+            }
+            else if (pendingEdit == EDIT_UNDO) {
+                undoEdit(journal);
+                pendingEdit = EDIT_NONE;
+            }
+            else if (pendingEdit == EDIT_REDO) {
+                redoEdit(journal);
+                pendingEdit = EDIT_NONE;
+            }
+            else if (pendingEdit != EDIT_NONE) {
+                if (aimEdit(&world, cam, pendingEdit, &edit)) {
+                    applyTraceEdit(&edit, world.regions, world.count);
+
+                    if (trace != NULL) {
+                        edit.tick = tickCount;
+                        recordEdit(trace, &edit);
+                    }
+                }
+
+                pendingEdit = EDIT_NONE;
+            }
+
+            turnCamera(cam, tick.yaw, tick.pitch);
+            vec3s move = getCameraMovement(cam, tick.keys, tickSeconds);
+
+            if (noclip)
+                player.position = glms_vec3_add(player.position, move);
+            else
+                moveBody(world.regions[0], &player, move);
+
+            vec3s eye = glms_vec3_add(player.position, WORLD_OFFSET);
+            eye.y += PLAYER_EYE_HEIGHT;
+            moveCamera(cam, eye);
+
+            if (trace != NULL) {
+                float position[3] = {player.position.x, player.position.y, player.position.z};
+
+                if (replaying) {
+                    checkTraceTick(trace, &tick, position);
+                }
+                else {
+                    memcpy(tick.position, position, sizeof(position));
+                    recordTick(trace, &tick);
+                }
+            }
+
+            tickCount++;
+            accumulator -= tickLength;
+        }
+
+        // Data nobody has used in a while is packed
+        // away as the frames go by
+        updateColdRegions(world.regions, world.count, player.position);
+
+        // How far between the last two ticks
+        // this frame is
+        float alpha = (float) accumulator / (float) tickLength;
 
         // Set transform matrices
-        getView(cam, view.raw);
-        glm_perspective(glm_rad(60.0f), 1.0f, 0.1f, 100.0f, projection.raw);
+        getView(cam, alpha, view.raw);
+        glm_perspective(glm_rad(60.0f), (float) width / (float) height, 0.1f, 100.0f, projection.raw);
 
         glUseProgram(programID);
 
@@ -112,17 +829,103 @@ int main() {
         glUniformMatrix4fv(viewLoc, 1, GL_FALSE, &view.raw[0][0]);
         glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, &projection.raw[0][0]);
 
-        // Draw meshes
-        drawMesh(*(test->meshPtr));
-        drawMesh(*(testfront->meshPtr));
-        drawMesh(*(testback->meshPtr));
-        drawMesh(*(testleft->meshPtr));
-        drawMesh(*(testright->meshPtr));
+        // Only in the face shader
+        glUniform1f(glGetUniformLocation(programID, "mcubeSize"), REGION_MCUBE_SIZE);
 
-        SDL_GL_SwapWindow(window);
-        lastUpdate = current;
+        // Opaque faces nearest first so the depth
+        // test throws away more of what is behind
+        vec3s viewEye = glms_vec3_sub(cam->position, WORLD_OFFSET);
+        orderRegions(&world, viewEye);
+
+        GLint alphaLoc = glGetUniformLocation(programID, "alpha");
+        glUniform1f(alphaLoc, 1.0f);
+
+        for (int i = 0; i < world.count; i++)
+            drawMesh(world.regions[world.drawOrder[i]]->meshPtr);
+
+        // Transparent faces go on top farthest
+        // first, without writing depth so they
+        // don't hide each other
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+        glUniform1f(alphaLoc, CLEAR_ALPHA);
+
+        for (int i = world.count - 1; i >= 0; i--) {
+            Mesh* mesh = world.regions[world.drawOrder[i]]->meshPtr;
+            sortMeshClear(mesh, viewEye);
+            drawMeshClear(mesh);
+        }
+
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+
+        if (headless)
+            endHeadlessFrame(offscreen);
+        else
+            SDL_GL_SwapWindow(window);
+        markPresented(pacer);
+
+        if (benchmarking)
+            addFrameTime(&(benchResult.frames), pacer->lastFrame);
+
+        frames++;
+        if (frameLimit > 0 && frames >= frameLimit)
+            exited = 1;
+
+        // The first frame waited on startup
+        if (replaying && !firstFrame)
+            addTraceFrame(trace, pacer->lastFrame);
+
+        if (memoryReportLength != 0 && current - lastMemoryReport >= memoryReportLength) {
+            reportMemory(&world);
+            lastMemoryReport = current;
+        }
+
+        if (current - lastJobReport >= jobReportLength) {
+            JobStats jobStats = getJobStats();
+            printJobStats(&jobStats);
+
+            RemeshStats remeshStats = getRemeshStats();
+            printRemeshStats(&remeshStats);
+
+            ColdRegionStats coldStats = getColdRegionStats();
+            printColdRegionStats(&coldStats);
+            lastJobReport = current;
+        }
+
+        if (firstFrame) {
+            fprintf(stderr, "First frame after %.2f ms\n", elapsedMs(startTime));
+            firstFrame = 0;
+        }
+    }
+
+    if (trace != NULL) {
+        printTraceStats(trace);
+        freeTrace(&trace);
     }
 
+    if (benchmarking) {
+        finishBench(&world, &benchResult, offscreen);
+        printBenchResult(&benchResult);
+        freeBenchResult(&benchResult);
+    }
+    else if (headless) {
+        printHeadlessSummary(offscreen, replaying ? replayPath : "turn");
+    }
+
+    if (headless)
+        freeHeadless(&offscreen);
+
+    waitForRemeshes();
+    waitForColdRegions();
+
+    freeJournal(&journal);
+
+    freeJobs();
+
+    free(world.drawOrder);
+
     return 0;
 }
 
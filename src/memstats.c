@@ -0,0 +1,138 @@
+/**
+ * Memory accounting, walks the world structures
+ * and adds up what they hold on the CPU and the
+ * GPU so budgets can be set from real numbers.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "memstats.h"
+#include "compress.h"
+
+static const char* MEMORY_CATEGORY_NAMES[MEMORY_CATEGORY_COUNT] = {
+    "region filled",
+    "region cubed",
+    "region mcubed",
+    "region headers",
+    "region occupancy",
+    "region light",
+    "region packed",
+    "mesh cpu",
+    "mesh gpu",
+    "mesh elements",
+    "journal",
+    "arenas"
+};
+
+void clearMemoryStats(MemoryStats* stats) {
+    memset(stats, 0, sizeof(MemoryStats));
+}
+
+/**
+ * Adds a region block unless it is a uniform one
+ * that was added already. Other blocks are only
+ * shared with snapshots and jobs, which are not
+ * measured, so each is added once by its region.
+ *
+ */
+static void addBlockMemory(MemoryStats* stats, enum MemoryCategory category, void* block, size_t bytes) {
+    if (isUniformRegionBlock(block)) {
+        for (int i = 0; i < stats->uniformCount; i++) {
+            if (stats->uniformBlocks[i] == block)
+                return;
+        }
+
+        stats->uniformBlocks[stats->uniformCount++] = block;
+    }
+
+    stats->bytes[category] += bytes;
+}
+
+void addRegionMemory(MemoryStats* stats, Region* reg) {
+    if (reg == NULL)
+        return;
+
+    size_t cells = 1;
+    if (reg->regType == CUBED)
+        cells = REGION_CUBE_DEPTH * REGION_CUBE_DEPTH * REGION_CUBE_DEPTH;
+    else if (reg->regType == MCUBED)
+        cells = REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH;
+
+    // Packed regions only hold their runs
+    if (reg->packed != NULL)
+        stats->bytes[MEMORY_REGION_PACKED] += getPackedBytes(reg->packed);
+    else
+        stats->bytes[MEMORY_REGION_FILLED + reg->regType] += cells * sizeof(char*);
+    stats->regionCounts[reg->regType]++;
+
+    stats->bytes[MEMORY_REGION_HEADERS] += sizeof(Region);
+    addBlockMemory(stats, MEMORY_REGION_OCCUPANCY, reg->occupancy, 2 * REGION_OCCUPANCY_ROWS * sizeof(RegionRow));
+    addBlockMemory(stats, MEMORY_REGION_LIGHT, reg->light, REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH);
+
+    addMeshMemory(stats, reg->meshPtr);
+}
+
+void addMeshMemory(MemoryStats* stats, Mesh* meshPtr) {
+    if (meshPtr == NULL)
+        return;
+
+    size_t cpu = sizeof(Mesh) + meshPtr->sectionCount * sizeof(MeshSection);
+
+    // Draw arguments have room for every section
+    cpu += meshPtr->sectionCount * (sizeof(GLsizei) + sizeof(GLint) + sizeof(void*));
+
+    for (int i = 0; i < meshPtr->sectionCount; i++) {
+        MeshSection* sec = &(meshPtr->sections[i]);
+        cpu += (size_t) (sec->faceCapacity + sec->clearCapacity) * meshPtr->faceBytes;
+    }
+
+    stats->bytes[MEMORY_MESH_CPU] += cpu;
+    stats->bytes[MEMORY_MESH_GPU] += (size_t) (meshPtr->bufferSize + meshPtr->clearBufferSize) * meshPtr->faceBytes;
+    stats->meshCount++;
+}
+
+void addJournalMemory(MemoryStats* stats, Journal* journal) {
+    if (journal == NULL)
+        return;
+
+    stats->bytes[MEMORY_JOURNAL] += sizeof(Journal) +
+        journal->stepCapacity * sizeof(JournalStep) + journal->bytes;
+}
+
+void addSharedMeshMemory(MemoryStats* stats) {
+    stats->bytes[MEMORY_MESH_ELEMENTS] = getSharedElementBytes();
+}
+
+void addArenaMemory(MemoryStats* stats) {
+    stats->arenas = getArenaUsage();
+    stats->bytes[MEMORY_ARENAS] = stats->arenas.reserved;
+}
+
+size_t getMemoryTotal(MemoryStats* stats) {
+    size_t total = 0;
+
+    for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+        total += stats->bytes[i];
+
+    return total;
+}
+
+const char* getMemoryCategoryName(enum MemoryCategory category) {
+    return MEMORY_CATEGORY_NAMES[category];
+}
+
+void printMemoryStats(MemoryStats* stats) {
+    const double KIB = 1024.0;
+
+    fprintf(stderr, "Memory %.1f KiB, regions %d filled %d cubed %d mcubed, %d meshes\n",
+            (double) getMemoryTotal(stats) / KIB,
+            stats->regionCounts[FILLED], stats->regionCounts[CUBED],
+            stats->regionCounts[MCUBED], stats->meshCount);
+
+    for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+        fprintf(stderr, "  %-18s %10.1f KiB\n", MEMORY_CATEGORY_NAMES[i], (double) stats->bytes[i] / KIB);
+
+    fprintf(stderr, "  arena high water scratch %.1f KiB\n",
+            (double) stats->arenas.scratchHighWater / KIB);
+}
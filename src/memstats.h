@@ -0,0 +1,87 @@
+#include <stddef.h>
+
+#include "region.h"
+#include "mesh.h"
+#include "journal.h"
+#include "arena.h"
+
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+enum MemoryCategory {
+    // Cube IDs of regions by their RegionType
+    MEMORY_REGION_FILLED,
+    MEMORY_REGION_CUBED,
+    MEMORY_REGION_MCUBED,
+    // The Region structs themselves
+    MEMORY_REGION_HEADERS,
+    MEMORY_REGION_OCCUPANCY,
+    MEMORY_REGION_LIGHT,
+    // Runs of cold MCUBED regions
+    MEMORY_REGION_PACKED,
+    // CPU copies of mesh sections and the
+    // draw arguments
+    MEMORY_MESH_CPU,
+    // Vertex or face record buffers
+    MEMORY_MESH_GPU,
+    // The element buffer all vertex meshes share
+    MEMORY_MESH_ELEMENTS,
+    // Undo history
+    MEMORY_JOURNAL,
+    // Frame and scratch arenas of every thread
+    MEMORY_ARENAS,
+    MEMORY_CATEGORY_COUNT
+};
+
+/**
+ * Bytes used by everything added to it since it
+ * was cleared. Nothing is tracked as it is
+ * allocated, the structures are measured when
+ * they are added.
+ *
+ */
+typedef struct _memoryStats {
+    size_t bytes[MEMORY_CATEGORY_COUNT];
+
+    // Indexed by RegionType
+    int regionCounts[3];
+    int meshCount;
+
+    // Uniform blocks already counted, every
+    // region sharing one adds it only once
+    void* uniformBlocks[REGION_UNIFORM_BLOCKS];
+    int uniformCount;
+
+    ArenaUsage arenas;
+} MemoryStats;
+
+void clearMemoryStats(MemoryStats* stats);
+
+/**
+ * Adds a region and its mesh.
+ *
+ */
+void addRegionMemory(MemoryStats* stats, Region* reg);
+void addMeshMemory(MemoryStats* stats, Mesh* meshPtr);
+void addJournalMemory(MemoryStats* stats, Journal* journal);
+
+/**
+ * Adds the buffers shared by every mesh and
+ * the arenas, only once per set of stats.
+ *
+ */
+void addSharedMeshMemory(MemoryStats* stats);
+void addArenaMemory(MemoryStats* stats);
+
+size_t getMemoryTotal(MemoryStats* stats);
+
+const char* getMemoryCategoryName(enum MemoryCategory category);
+
+/**
+ * Prints one line per category, the region
+ * counts and the arena high water marks.
+ *
+ */
+void printMemoryStats(MemoryStats* stats);
+
+#endif
@@ -3,13 +3,55 @@
  *
  */
 #include "mesh.h"
+#include "region.h"
+#include "radix.h"
 
 #include <glad/glad.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 #include <cglm/struct.h>
 
-Mesh* initMesh(vec3s pos) {
+// Indices for every face are the same so all
+// meshes share one element buffer
+static GLuint sharedElementBufferObj = 0;
+static int sharedElementFaces = 0;
+
+// Sections never shrink below this so small
+// edits don't keep moving the buffer around
+static const int MIN_SECTION_FACES = 16;
+
+// Most times the cell the eye has to leave before
+// transparent faces are sorted again can double
+// for far meshes (see sortMeshClear)
+static const int MAX_SORT_LEVEL = 6;
+
+// Face record fields, the cell takes enough bits
+// for the region depth and the width and height
+// share what is left after the face
+#define FACE_CELL_BITS REGION_MCUBE_BITS
+#define FACE_EXTENT_BITS ((29 - 3 * FACE_CELL_BITS) / 2)
+
+static enum MeshMode meshMode = MESH_VERTICES;
+
+// Where regionOrigin is in the last face
+// shader used, looked up again if it changes
+static GLint faceProgram = 0;
+static GLint faceOriginLoc = -1;
+
+// Only touched where GL is
+static MeshCounters counters;
+
+void setMeshMode(enum MeshMode mode) {
+    meshMode = mode;
+}
+
+enum MeshMode getMeshMode() {
+    return meshMode;
+}
+
+Mesh* initMesh(vec3s pos, int sectionCount) {
     Mesh* result = malloc(sizeof(Mesh));
 
     if (result == NULL) {
@@ -17,182 +59,651 @@ Mesh* initMesh(vec3s pos) {
         exit(1);
     }
 
-    // VAO
-    glGenVertexArrays(1, &(result->vertArrayObj));
-    glBindVertexArray(result->vertArrayObj);
+    result->sections = calloc(sectionCount, sizeof(MeshSection));
+    result->drawCounts = malloc(sectionCount * sizeof(GLsizei));
+    result->drawBaseVerts = malloc(sectionCount * sizeof(GLint));
+    result->drawIndices = calloc(sectionCount, sizeof(void*));
+
+    if (result->sections == NULL || result->drawCounts == NULL ||
+        result->drawBaseVerts == NULL || result->drawIndices == NULL) {
+        fprintf(stderr, "ERROR: Cannot allocate space for Mesh!\n");
+        exit(1);
+    }
 
-    // VBO
-    glGenBuffers(1, &(result->vertBufferObj));
+    result->mode = meshMode;
+    result->faceBytes = meshMode == MESH_FACES ? sizeof(FaceRecord) : 4 * sizeof(Vertex);
 
-    // EBO
-    glGenBuffers(1, &(result->elementBufferObj));
+    result->vertArrayObj = 0;
+    result->vertBufferObj = 0;
+    result->faceTexture = 0;
+    result->bufferSize = 0;
+    result->pending = 0;
 
-    result->vertSize = 0;
-    result->elemSize = 0;
+    result->sectionCount = sectionCount;
+    result->drawCount = 0;
+
+    result->clearArrayObj = 0;
+    result->clearBufferObj = 0;
+    result->clearTexture = 0;
+    result->clearBufferSize = 0;
+    result->clearFaces = 0;
+    result->clearChanged = 0;
+    memset(result->sortCell, 0, sizeof(result->sortCell));
+    result->sortLevel = 0;
 
     result->position = pos;
 
     return result;
 }
 
-void setMeshVertPointer(Mesh* meshPtr, Vertex* vert, int size) {
-    // Free previous pointers
-    if (meshPtr->vertSize != 0)
-        free(meshPtr->vertPointer);
+void setMeshSection(Mesh* meshPtr, int section, void* faces, int count, void* clearFaces, int clearCount) {
+    MeshSection* sec = &(meshPtr->sections[section]);
+
+    // Most sections have nothing transparent, so
+    // only sort again when they did or do now
+    if (clearCount > 0 || sec->clearCount > 0) {
+        if (clearCount > sec->clearCapacity) {
+            sec->clearCapacity = clearCount;
+            sec->clearData = realloc(sec->clearData, sec->clearCapacity * meshPtr->faceBytes);
+
+            if (sec->clearData == NULL) {
+                fprintf(stderr, "ERROR: Unable to allocate memory for program\n");
+                exit(1);
+            }
+        }
+
+        if (clearCount > 0)
+            memcpy(sec->clearData, clearFaces, clearCount * meshPtr->faceBytes);
+        sec->clearCount = clearCount;
+        meshPtr->clearChanged = 1;
+    }
 
-    meshPtr->vertPointer = vert;
-    meshPtr->vertSize = size;
+    if (count > sec->faceCapacity) {
+        sec->faceCapacity = count;
+        sec->data = realloc(sec->data, sec->faceCapacity * meshPtr->faceBytes);
+
+        if (sec->data == NULL) {
+            fprintf(stderr, "ERROR: Unable to allocate memory for program\n");
+            exit(1);
+        }
+    }
+
+    if (count > 0)
+        memcpy(sec->data, faces, count * meshPtr->faceBytes);
+    sec->faceCount = count;
+    sec->pending = 1;
+    meshPtr->pending = 1;
+}
+
+/**
+ * Grows the shared element buffer so it has
+ * indices for at least the given faces.
+ *
+ */
+static void reserveElements(int faces) {
+    if (faces <= sharedElementFaces && sharedElementBufferObj != 0)
+        return;
+
+    int newFaces = sharedElementFaces == 0 ? 1024 : sharedElementFaces;
+    while (newFaces < faces)
+        newFaces *= 2;
+
+    Arena* scratch = getScratchArena();
+    size_t mark = getArenaMark(scratch);
+    GLuint* elems = arenaAlloc(scratch, newFaces * 6 * sizeof(GLuint));
+
+    // Every face is 0, 1, 3, 0, 3, 2
+    // added with its first vertex
+    const int indices[6] = {0, 1, 3, 0, 3, 2};
+
+    for (int i = 0; i < newFaces; i++) {
+        for (int j = 0; j < 6; j++)
+            elems[i * 6 + j] = indices[j] + i * 4;
+    }
+
+    if (sharedElementBufferObj == 0)
+        glGenBuffers(1, &sharedElementBufferObj);
+
+    // Go through the copy target so no vertex
+    // array's element binding gets changed
+    glBindBuffer(GL_COPY_WRITE_BUFFER, sharedElementBufferObj);
+    glBufferData(GL_COPY_WRITE_BUFFER, newFaces * 6 * sizeof(GLuint), elems, GL_STATIC_DRAW);
+
+    counters.uploadBytes += newFaces * 6 * sizeof(GLuint);
+    counters.uploads++;
+
+    sharedElementFaces = newFaces;
+    rewindArena(scratch, mark);
+}
+
+/**
+ * Gives every section a new range with some
+ * room to grow and uploads all of them.
+ *
+ */
+static void layoutMesh(Mesh* meshPtr) {
+    int size = 0;
+
+    for (int i = 0; i < meshPtr->sectionCount; i++) {
+        MeshSection* sec = &(meshPtr->sections[i]);
+
+        if (sec->faceCount > sec->bufferCapacity) {
+            // Half again so building next to it
+            // doesn't lay out the buffer each time
+            int capacity = sec->faceCount + sec->faceCount / 2;
+            sec->bufferCapacity = capacity < MIN_SECTION_FACES ? MIN_SECTION_FACES : capacity;
+        }
+
+        sec->bufferStart = size;
+        size += sec->bufferCapacity;
+    }
+
+    meshPtr->bufferSize = size;
 
-    glBindVertexArray(meshPtr->vertArrayObj);
     glBindBuffer(GL_ARRAY_BUFFER, meshPtr->vertBufferObj);
-    glBufferData(GL_ARRAY_BUFFER, meshPtr->vertSize * sizeof(Vertex), meshPtr->vertPointer, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, size * meshPtr->faceBytes, NULL, GL_STATIC_DRAW);
+
+    for (int i = 0; i < meshPtr->sectionCount; i++) {
+        MeshSection* sec = &(meshPtr->sections[i]);
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) 0);
+        if (sec->faceCount > 0) {
+            glBufferSubData(GL_ARRAY_BUFFER, sec->bufferStart * meshPtr->faceBytes, sec->faceCount * meshPtr->faceBytes, sec->data);
+
+            counters.uploadBytes += sec->faceCount * meshPtr->faceBytes;
+            counters.uploads++;
+        }
+
+        sec->pending = 0;
+    }
 }
 
-void setMeshElemPointer(Mesh* meshPtr, GLuint* elem, int size) {
-    // Free previous pointers
-    if (meshPtr->elemSize != 0)
-        free(meshPtr->elementPointer);
+void uploadMesh(Mesh* meshPtr) {
+    int relayout = 0;
+    int anyPending = 0;
+
+    for (int i = 0; i < meshPtr->sectionCount; i++) {
+        MeshSection* sec = &(meshPtr->sections[i]);
+
+        if (!sec->pending)
+            continue;
 
-    meshPtr->elementPointer = elem;
-    meshPtr->elemSize = size;
+        anyPending = 1;
+        if (sec->faceCount > sec->bufferCapacity)
+            relayout = 1;
+
+        if (meshPtr->mode == MESH_VERTICES)
+            reserveElements(sec->faceCount);
+    }
+
+    meshPtr->pending = 0;
+
+    if (!anyPending)
+        return;
+
+    if (meshPtr->vertArrayObj == 0) {
+        // VAO
+        glGenVertexArrays(1, &(meshPtr->vertArrayObj));
+        glBindVertexArray(meshPtr->vertArrayObj);
+
+        // VBO
+        glGenBuffers(1, &(meshPtr->vertBufferObj));
+        glBindBuffer(GL_ARRAY_BUFFER, meshPtr->vertBufferObj);
+
+        if (meshPtr->mode == MESH_FACES) {
+            // No attributes, the shader fetches the
+            // record for each vertex from the buffer
+            glGenTextures(1, &(meshPtr->faceTexture));
+            glBindTexture(GL_TEXTURE_BUFFER, meshPtr->faceTexture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, meshPtr->vertBufferObj);
+        }
+        else {
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) 0);
+            glEnableVertexAttribArray(1);
+            glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(Vertex), (void*) offsetof(Vertex, light));
+
+            // EBO
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sharedElementBufferObj);
+        }
+
+        relayout = 1;
+    }
+
+    if (relayout) {
+        layoutMesh(meshPtr);
+    }
+    else {
+        // Only patch the sections that changed
+        glBindBuffer(GL_ARRAY_BUFFER, meshPtr->vertBufferObj);
+
+        for (int i = 0; i < meshPtr->sectionCount; i++) {
+            MeshSection* sec = &(meshPtr->sections[i]);
+
+            if (!sec->pending)
+                continue;
+
+            if (sec->faceCount > 0) {
+                glBufferSubData(GL_ARRAY_BUFFER, sec->bufferStart * meshPtr->faceBytes, sec->faceCount * meshPtr->faceBytes, sec->data);
+
+                counters.uploadBytes += sec->faceCount * meshPtr->faceBytes;
+                counters.uploads++;
+            }
+
+            sec->pending = 0;
+        }
+    }
+
+    // Draw every section that has something
+    meshPtr->drawCount = 0;
+
+    for (int i = 0; i < meshPtr->sectionCount; i++) {
+        MeshSection* sec = &(meshPtr->sections[i]);
+
+        if (sec->faceCount == 0)
+            continue;
+
+        // Six vertices per face either way, face
+        // records have no base vertex to offset
+        // so start at the section's first face
+        meshPtr->drawCounts[meshPtr->drawCount] = sec->faceCount * 6;
+        meshPtr->drawBaseVerts[meshPtr->drawCount] = meshPtr->mode == MESH_FACES ? sec->bufferStart * 6 : sec->bufferStart * 4;
+        meshPtr->drawCount++;
+    }
+}
+
+/**
+ * Points the face shader in use at the mesh and
+ * the records in the texture.
+ *
+ */
+static void bindFaceShader(Mesh* meshPtr, GLuint texture) {
+    GLint program;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+
+    if (program != faceProgram) {
+        faceProgram = program;
+        faceOriginLoc = glGetUniformLocation(program, "regionOrigin");
+
+        // Uniforms stay with the program so the
+        // layout only has to be set once
+        glUniform1ui(glGetUniformLocation(program, "cellBits"), FACE_CELL_BITS);
+    }
+
+    glUniform3f(faceOriginLoc, meshPtr->position.x, meshPtr->position.y, meshPtr->position.z);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+}
+
+void drawMesh(Mesh* meshPtr) {
+    if (meshPtr->pending)
+        uploadMesh(meshPtr);
+
+    if (meshPtr->drawCount == 0)
+        return;
+
+    glFrontFace(GL_CW);
+    glCullFace(GL_BACK);
+    glEnable(GL_CULL_FACE);
 
     glBindVertexArray(meshPtr->vertArrayObj);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshPtr->elementBufferObj);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, meshPtr->elemSize * sizeof(GLuint), meshPtr->elementPointer, GL_STATIC_DRAW);
+
+    counters.drawCalls++;
+    for (int i = 0; i < meshPtr->drawCount; i++)
+        counters.drawnFaces += meshPtr->drawCounts[i] / 6;
+
+    if (meshPtr->mode == MESH_FACES) {
+        bindFaceShader(meshPtr, meshPtr->faceTexture);
+
+        glMultiDrawArrays(GL_TRIANGLES, meshPtr->drawBaseVerts, meshPtr->drawCounts, meshPtr->drawCount);
+    }
+    else {
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, meshPtr->drawCounts, GL_UNSIGNED_INT, meshPtr->drawIndices, meshPtr->drawCount, meshPtr->drawBaseVerts);
+    }
 }
 
-void clearMeshVertPointer(Mesh* meshPtr) {
-    // Free previous pointers
-    if (meshPtr->vertSize != 0)
-        free(meshPtr->vertPointer);
+/**
+ * Centre of a face in the same space as the
+ * mesh. Merged face records sort by their first
+ * mini cube.
+ *
+ */
+static vec3s getFaceCentre(Mesh* meshPtr, void* faces, int index) {
+    if (meshPtr->mode == MESH_VERTICES) {
+        // The first and last corners are across
+        // the face from each other
+        Vertex* verts = &(((Vertex*) faces)[index * 4]);
+
+        return (vec3s) {
+            .x = (verts[0].pos[0] + verts[3].pos[0]) * 0.5f,
+            .y = (verts[0].pos[1] + verts[3].pos[1]) * 0.5f,
+            .z = (verts[0].pos[2] + verts[3].pos[2]) * 0.5f
+        };
+    }
 
-    meshPtr->vertPointer = NULL;
-    meshPtr->vertSize = 0;
+    const uint32_t cellMask = (1u << FACE_CELL_BITS) - 1;
+    uint32_t cell = ((FaceRecord*) faces)[index].cell;
+
+    // Out from the centre of the mini cube by
+    // half of it on the side of the face
+    static const float normals[6][3] = {
+        {0, 0, 1}, {0, 0, -1},
+        {-1, 0, 0}, {1, 0, 0},
+        {0, 1, 0}, {0, -1, 0}
+    };
+    const float* normal = normals[(cell >> (3 * FACE_CELL_BITS)) & 7];
+    const float halfSize = REGION_MCUBE_SIZE / 2.0f;
+
+    return (vec3s) {
+        .x = meshPtr->position.x + REGION_MCUBE_SIZE * (float) (cell & cellMask) + normal[0] * halfSize,
+        .y = meshPtr->position.y + REGION_MCUBE_SIZE * (float) ((cell >> FACE_CELL_BITS) & cellMask) + normal[1] * halfSize,
+        .z = meshPtr->position.z + REGION_MCUBE_SIZE * (float) ((cell >> (2 * FACE_CELL_BITS)) & cellMask) + normal[2] * halfSize
+    };
 }
 
-void clearMeshElemPointer(Mesh* meshPtr) {
-    // Free previous pointers
-    if (meshPtr->elemSize != 0)
-        free(meshPtr->elementPointer);
+/**
+ * Sends the sorted transparent faces to their
+ * buffer, making the GL objects the first time.
+ *
+ */
+static void uploadMeshClear(Mesh* meshPtr, void* faces, int count) {
+    if (meshPtr->mode == MESH_VERTICES)
+        reserveElements(count);
+
+    if (meshPtr->clearArrayObj == 0) {
+        glGenVertexArrays(1, &(meshPtr->clearArrayObj));
+        glBindVertexArray(meshPtr->clearArrayObj);
+
+        glGenBuffers(1, &(meshPtr->clearBufferObj));
+        glBindBuffer(GL_ARRAY_BUFFER, meshPtr->clearBufferObj);
+
+        // Set up the same way as the other faces
+        if (meshPtr->mode == MESH_FACES) {
+            glGenTextures(1, &(meshPtr->clearTexture));
+            glBindTexture(GL_TEXTURE_BUFFER, meshPtr->clearTexture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, meshPtr->clearBufferObj);
+        }
+        else {
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) 0);
+            glEnableVertexAttribArray(1);
+            glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(Vertex), (void*) offsetof(Vertex, light));
+
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sharedElementBufferObj);
+        }
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, meshPtr->clearBufferObj);
+
+    if (count > meshPtr->clearBufferSize) {
+        // Room to grow like the sections have
+        int size = count + count / 2;
+        meshPtr->clearBufferSize = size < MIN_SECTION_FACES ? MIN_SECTION_FACES : size;
+        glBufferData(GL_ARRAY_BUFFER, meshPtr->clearBufferSize * meshPtr->faceBytes, NULL, GL_DYNAMIC_DRAW);
+    }
+
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * meshPtr->faceBytes, faces);
 
-    meshPtr->elementPointer = NULL;
-    meshPtr->elemSize = 0;
+    counters.uploadBytes += count * meshPtr->faceBytes;
+    counters.uploads++;
 }
 
-void drawMesh(Mesh mesh) {
+void sortMeshClear(Mesh* meshPtr, vec3s eye) {
+    const float regionSize = REGION_MCUBE_DEPTH * REGION_MCUBE_SIZE;
+    const vec3s half = {.x = regionSize / 2.0f, .y = regionSize / 2.0f, .z = regionSize / 2.0f};
+
+    vec3s away = glms_vec3_sub(eye, glms_vec3_add(meshPtr->position, half));
+    float distance = sqrtf(glms_vec3_dot(away, away));
+
+    // Faces only swap order when the eye crosses
+    // between them, which a section sized cell
+    // mostly catches. Far meshes are seen from
+    // nearly the same side anywhere in a bigger
+    // one, so it doubles each time the distance
+    // does past a couple of regions.
+    int level = 0;
+    while (level < MAX_SORT_LEVEL && distance > regionSize * (float) (2 << level))
+        level++;
+
+    const float cellSize = REGION_SECTION_DEPTH * REGION_MCUBE_SIZE * (float) (1 << level);
+    int cell[3] = {
+        (int) floorf(eye.x / cellSize),
+        (int) floorf(eye.y / cellSize),
+        (int) floorf(eye.z / cellSize)
+    };
+
+    if (!meshPtr->clearChanged && level == meshPtr->sortLevel && cell[0] == meshPtr->sortCell[0] &&
+        cell[1] == meshPtr->sortCell[1] && cell[2] == meshPtr->sortCell[2])
+        return;
+
+    meshPtr->clearChanged = 0;
+    meshPtr->sortLevel = level;
+    memcpy(meshPtr->sortCell, cell, sizeof(cell));
+
+    int count = 0;
+    for (int i = 0; i < meshPtr->sectionCount; i++)
+        count += meshPtr->sections[i].clearCount;
+
+    meshPtr->clearFaces = count;
+
+    if (count == 0)
+        return;
+
+    Arena* scratch = getScratchArena();
+    size_t mark = getArenaMark(scratch);
+
+    char* faces = arenaAlloc(scratch, (size_t) count * meshPtr->faceBytes);
+    char* sorted = arenaAlloc(scratch, (size_t) count * meshPtr->faceBytes);
+    uint32_t* keys = arenaAlloc(scratch, count * sizeof(uint32_t));
+    uint32_t* order = arenaAlloc(scratch, count * sizeof(uint32_t));
+
+    int next = 0;
+    for (int i = 0; i < meshPtr->sectionCount; i++) {
+        MeshSection* sec = &(meshPtr->sections[i]);
+
+        if (sec->clearCount > 0)
+            memcpy(&(faces[next * meshPtr->faceBytes]), sec->clearData, sec->clearCount * meshPtr->faceBytes);
+        next += sec->clearCount;
+    }
+
+    for (int i = 0; i < count; i++) {
+        vec3s offset = glms_vec3_sub(getFaceCentre(meshPtr, faces, i), eye);
+
+        // Flipped so the farthest comes first
+        keys[i] = ~getDistanceKey(glms_vec3_dot(offset, offset));
+        order[i] = i;
+    }
+
+    radixSort(keys, order, count, scratch);
+
+    for (int i = 0; i < count; i++)
+        memcpy(&(sorted[i * meshPtr->faceBytes]), &(faces[order[i] * meshPtr->faceBytes]), meshPtr->faceBytes);
+
+    uploadMeshClear(meshPtr, sorted, count);
+
+    rewindArena(scratch, mark);
+}
+
+void drawMeshClear(Mesh* meshPtr) {
+    if (meshPtr->clearFaces == 0)
+        return;
+
     glFrontFace(GL_CW);
     glCullFace(GL_BACK);
     glEnable(GL_CULL_FACE);
 
-    glBindVertexArray(mesh.vertArrayObj);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.elementBufferObj);
-    glDrawElements(GL_TRIANGLES, mesh.elemSize, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(meshPtr->clearArrayObj);
+
+    counters.drawCalls++;
+    counters.drawnFaces += meshPtr->clearFaces;
+
+    if (meshPtr->mode == MESH_FACES) {
+        bindFaceShader(meshPtr, meshPtr->clearTexture);
+        glDrawArrays(GL_TRIANGLES, 0, meshPtr->clearFaces * 6);
+    }
+    else {
+        glDrawElements(GL_TRIANGLES, meshPtr->clearFaces * 6, GL_UNSIGNED_INT, (void*) 0);
+    }
 }
 
 /**
- * Add a face to the mesh. 
+ * Makes room in the builder for one more face
+ * of the given size.
  *
  */
-void addFace(Mesh* mesh, enum CubeFace face, vec3s position, float scale) {
-    // Need to create new lists to not override memory
-    int newVertSize = mesh->vertSize + 4;
-    Vertex* newVerts = malloc(sizeof(Vertex) * newVertSize);
+static void growMeshBuilder(MeshBuilder* builder, size_t faceBytes) {
+    if (builder->size < builder->capacity)
+        return;
+
+    int capacity = builder->capacity == 0 ? 64 : builder->capacity * 2;
+
+    if (builder->arena != NULL)
+        builder->data = arenaResize(builder->arena, builder->data, builder->capacity * faceBytes, capacity * faceBytes);
+    else
+        builder->data = realloc(builder->data, capacity * faceBytes);
 
-    int newElemSize = mesh->elemSize + 6;
-    GLuint* newElems = malloc(sizeof(GLuint) * newElemSize);
+    builder->capacity = capacity;
 
-    if (newVerts == NULL || newElems == NULL) {
+    if (builder->data == NULL) {
         fprintf(stderr, "ERROR: Unable to allocate memory for program\n");
         exit(1);
     }
+}
 
-    // Make copies of previous data
-    for (int i = 0; i < mesh->vertSize; i++) 
-        newVerts[i] = mesh->vertPointer[i];
-
-    for (int i = 0; i < mesh->elemSize; i++) 
-        newElems[i] = mesh->elementPointer[i];
-
-    int oldVertSize = mesh->vertSize;
-    int oldElemSize = mesh->elemSize;
+/**
+ * Add a face to the builder.
+ *
+ */
+void addFace(MeshBuilder* builder, enum CubeFace face, vec3s position, float scale, uint32_t light) {
+    growMeshBuilder(builder, 4 * sizeof(Vertex));
 
-    // New elems will always be 
-    // 0, 1, 3, 0, 3, 2
-    // added with the old size
-    const int indices[6] = {0, 1, 3, 0, 3, 2};
+    Vertex* verts = &(((Vertex*) builder->data)[builder->size * 4]);
+    builder->size++;
 
-    for (int i = 0; i < 6; i++)
-        newElems[i + oldElemSize] = indices[i] + oldVertSize;
-    
     switch (face) {
         case 0:
-            newVerts[oldVertSize]     = (Vertex) {.pos = {-scale + position.x, scale + position.y, scale + position.z}};
-            newVerts[oldVertSize + 1] = (Vertex) {.pos = {scale + position.x, scale + position.y, scale + position.z}};
-            newVerts[oldVertSize + 2] = (Vertex) {.pos = {-scale + position.x, -scale + position.y, scale + position.z}};
-            newVerts[oldVertSize + 3] = (Vertex) {.pos = {scale + position.x, -scale + position.y, scale + position.z}};
+            verts[0] = (Vertex) {.pos = {-scale + position.x, scale + position.y, scale + position.z}};
+            verts[1] = (Vertex) {.pos = {scale + position.x, scale + position.y, scale + position.z}};
+            verts[2] = (Vertex) {.pos = {-scale + position.x, -scale + position.y, scale + position.z}};
+            verts[3] = (Vertex) {.pos = {scale + position.x, -scale + position.y, scale + position.z}};
             break;
         case 1:
             // Front but flipped and on -z side
-            newVerts[oldVertSize]     = (Vertex) {.pos = {-scale + position.x, -scale + position.y, -scale + position.z}};
-            newVerts[oldVertSize + 1] = (Vertex) {.pos = {scale + position.x, -scale + position.y, -scale + position.z}};
-            newVerts[oldVertSize + 2] = (Vertex) {.pos = {-scale + position.x, scale + position.y, -scale + position.z}};
-            newVerts[oldVertSize + 3] = (Vertex) {.pos = {scale + position.x, scale + position.y, -scale + position.z}};
+            verts[0] = (Vertex) {.pos = {-scale + position.x, -scale + position.y, -scale + position.z}};
+            verts[1] = (Vertex) {.pos = {scale + position.x, -scale + position.y, -scale + position.z}};
+            verts[2] = (Vertex) {.pos = {-scale + position.x, scale + position.y, -scale + position.z}};
+            verts[3] = (Vertex) {.pos = {scale + position.x, scale + position.y, -scale + position.z}};
             break;
         case 2:
             // Front but flipped and on -x side
-            newVerts[oldVertSize]     = (Vertex) {.pos = {-scale + position.x, -scale + position.y, -scale + position.z}};
-            newVerts[oldVertSize + 1] = (Vertex) {.pos = {-scale + position.x, scale + position.y, -scale + position.z}};
-            newVerts[oldVertSize + 2] = (Vertex) {.pos = {-scale + position.x, -scale + position.y, scale + position.z}};
-            newVerts[oldVertSize + 3] = (Vertex) {.pos = {-scale + position.x, scale + position.y, scale + position.z}};
+            verts[0] = (Vertex) {.pos = {-scale + position.x, -scale + position.y, -scale + position.z}};
+            verts[1] = (Vertex) {.pos = {-scale + position.x, scale + position.y, -scale + position.z}};
+            verts[2] = (Vertex) {.pos = {-scale + position.x, -scale + position.y, scale + position.z}};
+            verts[3] = (Vertex) {.pos = {-scale + position.x, scale + position.y, scale + position.z}};
             break;
         case 3:
             // Front but on +x side
-            newVerts[oldVertSize]     = (Vertex) {.pos = {scale + position.x, -scale + position.y, scale + position.z}};
-            newVerts[oldVertSize + 1] = (Vertex) {.pos = {scale + position.x, scale + position.y, scale + position.z}};
-            newVerts[oldVertSize + 2] = (Vertex) {.pos = {scale + position.x, -scale + position.y, -scale + position.z}};
-            newVerts[oldVertSize + 3] = (Vertex) {.pos = {scale + position.x, scale + position.y, -scale + position.z}};
+            verts[0] = (Vertex) {.pos = {scale + position.x, -scale + position.y, scale + position.z}};
+            verts[1] = (Vertex) {.pos = {scale + position.x, scale + position.y, scale + position.z}};
+            verts[2] = (Vertex) {.pos = {scale + position.x, -scale + position.y, -scale + position.z}};
+            verts[3] = (Vertex) {.pos = {scale + position.x, scale + position.y, -scale + position.z}};
             break;
         case 4:
             // Front but flipped and on +y side
-            newVerts[oldVertSize]     = (Vertex) {.pos = {-scale + position.x, scale + position.y, -scale + position.z}};
-            newVerts[oldVertSize + 1] = (Vertex) {.pos = {scale + position.x, scale + position.y, -scale + position.z}};
-            newVerts[oldVertSize + 2] = (Vertex) {.pos = {-scale + position.x, scale + position.y, scale + position.z}};
-            newVerts[oldVertSize + 3] = (Vertex) {.pos = {scale + position.x, scale + position.y, scale + position.z}};
+            verts[0] = (Vertex) {.pos = {-scale + position.x, scale + position.y, -scale + position.z}};
+            verts[1] = (Vertex) {.pos = {scale + position.x, scale + position.y, -scale + position.z}};
+            verts[2] = (Vertex) {.pos = {-scale + position.x, scale + position.y, scale + position.z}};
+            verts[3] = (Vertex) {.pos = {scale + position.x, scale + position.y, scale + position.z}};
             break;
         case 5:
             // Front but on -y side
-            newVerts[oldVertSize]     = (Vertex) {.pos = {-scale + position.x, -scale + position.y, scale + position.z}};
-            newVerts[oldVertSize + 1] = (Vertex) {.pos = {scale + position.x, -scale + position.y, scale + position.z}};
-            newVerts[oldVertSize + 2] = (Vertex) {.pos = {-scale + position.x, -scale + position.y, -scale + position.z}};
-            newVerts[oldVertSize + 3] = (Vertex) {.pos = {scale + position.x, -scale + position.y, -scale + position.z}};
+            verts[0] = (Vertex) {.pos = {-scale + position.x, -scale + position.y, scale + position.z}};
+            verts[1] = (Vertex) {.pos = {scale + position.x, -scale + position.y, scale + position.z}};
+            verts[2] = (Vertex) {.pos = {-scale + position.x, -scale + position.y, -scale + position.z}};
+            verts[3] = (Vertex) {.pos = {scale + position.x, -scale + position.y, -scale + position.z}};
             break;
     }
 
-    // Set it to the new data
-    setMeshVertPointer(mesh, newVerts, newVertSize);
+    for (int i = 0; i < 4; i++)
+        verts[i].light = (light >> (i * 8)) & 0xFF;
+}
+
+void addFaceRecord(MeshBuilder* builder, enum CubeFace face, int x, int y, int z, int width, int height, uint32_t light) {
+    growMeshBuilder(builder, sizeof(FaceRecord));
 
-    setMeshElemPointer(mesh, newElems, newElemSize);
+    const int cellMask = (1 << FACE_CELL_BITS) - 1;
+    const int extentMask = (1 << FACE_EXTENT_BITS) - 1;
+    const int faceShift = 3 * FACE_CELL_BITS;
+
+    FaceRecord record;
+    record.cell = (uint32_t) (x & cellMask)
+        | (uint32_t) (y & cellMask) << FACE_CELL_BITS
+        | (uint32_t) (z & cellMask) << (2 * FACE_CELL_BITS)
+        | (uint32_t) (face & 7) << faceShift
+        | (uint32_t) ((width - 1) & extentMask) << (faceShift + 3)
+        | (uint32_t) ((height - 1) & extentMask) << (faceShift + 3 + FACE_EXTENT_BITS);
+    record.light = light;
+
+    ((FaceRecord*) builder->data)[builder->size] = record;
+    builder->size++;
+}
+
+void clearMeshBuilder(MeshBuilder* builder) {
+    builder->size = 0;
+}
+
+void freeMeshBuilder(MeshBuilder* builder) {
+    // Arena faces go back when it is rewound
+    if (builder->arena == NULL)
+        free(builder->data);
+    builder->data = NULL;
+    builder->size = 0;
+    builder->capacity = 0;
+}
+
+MeshCounters getMeshCounters() {
+    return counters;
+}
+
+void clearMeshCounters() {
+    memset(&counters, 0, sizeof(MeshCounters));
+}
+
+size_t getSharedElementBytes() {
+    return (size_t) sharedElementFaces * 6 * sizeof(GLuint);
 }
 
 void freeMesh(Mesh** meshPtrPtr) {
     Mesh* meshPtr = *meshPtrPtr;
 
-    // VAO
-    glDeleteVertexArrays(1, &(meshPtr->vertArrayObj));
+    if (meshPtr->vertArrayObj != 0) {
+        // VAO
+        glDeleteVertexArrays(1, &(meshPtr->vertArrayObj));
 
-    // VBO
-    glDeleteBuffers(1, &(meshPtr->vertBufferObj));
+        // VBO
+        glDeleteBuffers(1, &(meshPtr->vertBufferObj));
+
+        if (meshPtr->faceTexture != 0)
+            glDeleteTextures(1, &(meshPtr->faceTexture));
+    }
 
-    // EBO
-    glDeleteBuffers(1, &(meshPtr->elementBufferObj));
+    if (meshPtr->clearArrayObj != 0) {
+        glDeleteVertexArrays(1, &(meshPtr->clearArrayObj));
+        glDeleteBuffers(1, &(meshPtr->clearBufferObj));
+
+        if (meshPtr->clearTexture != 0)
+            glDeleteTextures(1, &(meshPtr->clearTexture));
+    }
+
+    for (int i = 0; i < meshPtr->sectionCount; i++) {
+        free(meshPtr->sections[i].data);
+        free(meshPtr->sections[i].clearData);
+    }
 
-    if (meshPtr->vertSize != 0)
-        free(meshPtr->vertPointer);
-    if (meshPtr->elemSize != 0)
-        free(meshPtr->elementPointer);
+    free(meshPtr->sections);
+    free(meshPtr->drawCounts);
+    free(meshPtr->drawBaseVerts);
+    free(meshPtr->drawIndices);
 
     free(meshPtr);
     *meshPtrPtr = NULL;
@@ -1,26 +1,162 @@
+#include <stddef.h>
+#include <stdint.h>
 #include <glad/glad.h>
 #include <cglm/struct.h>
 
+#include "arena.h"
+
 #ifndef MESH_H
 #define MESH_H
 
 typedef struct _vertex {
     GLfloat pos[3];
+    // Sky light in the high 4 bits and cube
+    // light in the low 4
+    GLuint light;
 } Vertex;
 
+/**
+ * One face for the face record path. The cell is
+ * packed from the low bits up:
+ *
+ *   x, y, z         REGION_MCUBE_BITS each
+ *   face            3
+ *   width - 1,      FACE_EXTENT_BITS each, which
+ *   height - 1      is (29 - 3 * REGION_MCUBE_BITS) / 2
+ *
+ * so 4/4/4, 3, 8/8 at depth 16, 5/5/5, 3, 7/7 at
+ * depth 32 and 6/6/6, 3, 5/5 at depth 64, with
+ * any bit left over at the top unused. Positions
+ * are in mini cubes from the mesh position. The
+ * light has a byte for each corner in the same
+ * order as addFace.
+ *
+ */
+typedef struct _faceRecord {
+    uint32_t cell;
+    uint32_t light;
+} FaceRecord;
+
+/**
+ * How meshes store their faces. Vertices are four
+ * corners per face drawn with the shared indices,
+ * face records are expanded into corners by the
+ * vertex shader (assets/face_vertex.glsl).
+ *
+ */
+enum MeshMode {
+    MESH_VERTICES,
+    MESH_FACES
+};
+
+/**
+ * A part of the mesh that owns its own range of
+ * the vertex buffer so it can be rebuilt and
+ * uploaded without touching the rest.
+ *
+ */
+typedef struct _meshSection {
+    // CPU copy of the section, vertices or
+    // face records depending on the mesh mode
+    void* data;
+    int faceCount;
+    int faceCapacity;
+
+    // Range reserved in the buffer in faces
+    int bufferStart;
+    int bufferCapacity;
+
+    // Needs to be rebuilt from the source data
+    int dirty;
+    // Has faces waiting to be uploaded
+    int pending;
+
+    // Faces of transparent cubes, they are
+    // sorted into their own buffer when drawn
+    void* clearData;
+    int clearCount;
+    int clearCapacity;
+} MeshSection;
+
 typedef struct _mesh {
     vec3s position;
 
+    // Picked when the mesh is made
+    enum MeshMode mode;
+    int faceBytes;
+
     GLuint vertArrayObj;
     GLuint vertBufferObj;
-    GLuint elementBufferObj;
+    // Texture the shader reads face records from
+    GLuint faceTexture;
+
+    // Size of the buffer in faces
+    int bufferSize;
+
+    // Some section is waiting to be uploaded
+    int pending;
+
+    int sectionCount;
+    MeshSection* sections;
 
-    int vertSize;
-    Vertex* vertPointer;
-    int elemSize;
-    GLuint* elementPointer;
+    // Arguments for the multi draw, rebuilt
+    // on upload. With face records the base
+    // vertices are the first vertex to draw
+    int drawCount;
+    GLsizei* drawCounts;
+    GLint* drawBaseVerts;
+    const void** drawIndices;
+
+    // Transparent faces of every section sorted
+    // far to near for the last eye they were
+    // sorted for
+    GLuint clearArrayObj;
+    GLuint clearBufferObj;
+    GLuint clearTexture;
+    int clearBufferSize;
+    int clearFaces;
+
+    // Set when a section's transparent faces
+    // change, they are sorted again next time
+    int clearChanged;
+    // Cell of the eye when last sorted and how
+    // many times its size was doubled, see
+    // sortMeshClear
+    int sortCell[3];
+    int sortLevel;
 } Mesh;
 
+/**
+ * Work done by the thread drawing meshes since
+ * the counters were last cleared.
+ *
+ */
+typedef struct _meshCounters {
+    // Bytes sent to buffers and how many times
+    uint64_t uploadBytes;
+    uint64_t uploads;
+
+    // Multi draws and the faces in them
+    uint64_t drawCalls;
+    uint64_t drawnFaces;
+} MeshCounters;
+
+/**
+ * Scratch space faces are added to while a
+ * section is being built.
+ *
+ */
+typedef struct _meshBuilder {
+    void* data;
+    // Both in faces
+    int size;
+    int capacity;
+
+    // Faces come from here instead of the
+    // heap when set
+    Arena* arena;
+} MeshBuilder;
+
 enum CubeFace {
     FRONT, BACK,
     LEFT, RIGHT,
@@ -28,33 +164,89 @@ enum CubeFace {
 };
 
 /**
- * Initialize mesh populating the object
- * IDs and return the mesh structure.
+ * Picks how meshes made after this store their
+ * faces. Vertices are used by default.
+ *
+ */
+void setMeshMode(enum MeshMode mode);
+enum MeshMode getMeshMode();
+
+/**
+ * Initialize mesh with the given number of
+ * sections and return the mesh structure. The
+ * GL objects are created on the first upload.
+ *
+ */
+Mesh* initMesh(vec3s pos, int sectionCount);
+
+/**
+ * Replaces the faces of one section, they are
+ * copied so the caller keeps ownership. Faces of
+ * transparent cubes are given separately.
+ *
+ */
+void setMeshSection(Mesh* meshPtr, int section, void* faces, int count, void* clearFaces, int clearCount);
+
+/**
+ * Sends pending sections to the GPU. Sections
+ * that still fit in their range are patched in
+ * place, otherwise the buffer is laid out again.
+ *
+ */
+void uploadMesh(Mesh* meshPtr);
+
+/**
+ * Add a face to the builder, light has a byte
+ * for each corner.
  *
  */
-Mesh* initMesh(vec3s pos);
+void addFace(MeshBuilder* builder, enum CubeFace face, vec3s position, float scale, uint32_t light);
 
 /**
- * Set the mesh pointers.
+ * Add a face record to the builder, width and
+ * height are in mini cubes for merged faces.
  *
  */
-void setMeshVertPointer(Mesh* meshPtr, Vertex* vert, int size);
-void setMeshElemPointer(Mesh* meshPtr, GLuint* elem, int size);
+void addFaceRecord(MeshBuilder* builder, enum CubeFace face, int x, int y, int z, int width, int height, uint32_t light);
 
-void clearMeshVertPointer(Mesh* meshPtr);
-void clearMeshElemPointer(Mesh* meshPtr);
+void clearMeshBuilder(MeshBuilder* builder);
+void freeMeshBuilder(MeshBuilder* builder);
 
 /**
- * Add a face to the mesh. 
+ * Draw whatever is in the mesh, uploading it
+ * first if it changed. Face records need the
+ * face shader to be in use.
  *
  */
-void addFace(Mesh* mesh, enum CubeFace face, vec3s position, float scale);
+void drawMesh(Mesh* meshPtr);
+
+/**
+ * Sorts the transparent faces far to near from
+ * the eye (in the same space as the mesh) and
+ * uploads them. Only done again when they change
+ * or the eye moves into another cell, section
+ * sized near the mesh and bigger the farther it
+ * is, so a still camera costs nothing.
+ *
+ */
+void sortMeshClear(Mesh* meshPtr, vec3s eye);
+
+/**
+ * Draws the transparent faces as last sorted,
+ * blending is left to the caller.
+ *
+ */
+void drawMeshClear(Mesh* meshPtr);
+
+MeshCounters getMeshCounters();
+void clearMeshCounters();
 
 /**
- * Draw whatever is in the mesh.
+ * Size of the element buffer shared by meshes
+ * drawn with vertices.
  *
  */
-void drawMesh(Mesh mesh);
+size_t getSharedElementBytes();
 
 /**
  * Free everything in the mesh and the
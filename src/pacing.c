@@ -0,0 +1,211 @@
+/**
+ * Presents frames at an even pace and reports
+ * frame time jitter and input latency.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "pacing.h"
+
+// Sleeping can run over by about this much so
+// the rest of the wait is spun
+static const double SPIN_MARGIN_MS = 2.0;
+
+static const char* PRESENT_MODE_NAMES[] = {
+    "vsync", "adaptive", "uncapped", "capped"
+};
+
+static double toMs(FramePacer* pacer, Uint64 counts) {
+    return (double) counts * 1000.0 / (double) pacer->frequency;
+}
+
+FramePacer* initFramePacer(enum PresentMode mode, double targetFps, double reportSeconds) {
+    FramePacer* result = malloc(sizeof(FramePacer));
+
+    if (result == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate memory for program!\n");
+        exit(1);
+    }
+
+    memset(result, 0, sizeof(FramePacer));
+
+    result->frequency = SDL_GetPerformanceFrequency();
+    result->frameLength = targetFps > 0.0 ? (Uint64) (result->frequency / targetFps) : 0;
+    result->reportLength = (Uint64) (result->frequency * reportSeconds);
+
+    switch (mode) {
+        case PRESENT_VSYNC:
+            SDL_GL_SetSwapInterval(1);
+            break;
+        case PRESENT_ADAPTIVE:
+            // Not every driver has late swap tearing
+            if (SDL_GL_SetSwapInterval(-1) < 0) {
+                fprintf(stderr, "WARNING: Adaptive vsync is not supported, using vsync\n");
+                SDL_GL_SetSwapInterval(1);
+                mode = PRESENT_VSYNC;
+            }
+            break;
+        case PRESENT_UNCAPPED:
+            SDL_GL_SetSwapInterval(0);
+            break;
+        case PRESENT_CAPPED:
+            SDL_GL_SetSwapInterval(0);
+
+            if (result->frameLength == 0) {
+                fprintf(stderr, "WARNING: No frame rate to cap at, running uncapped\n");
+                mode = PRESENT_UNCAPPED;
+            }
+            break;
+    }
+
+    result->mode = mode;
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    result->nextFrame = now;
+    result->inputTime = now;
+    result->lastPresent = now;
+    result->lastReport = now;
+
+    fprintf(stderr, "Presenting with %s", PRESENT_MODE_NAMES[mode]);
+    if (mode == PRESENT_CAPPED)
+        fprintf(stderr, " at %.1f fps", targetFps);
+    fprintf(stderr, "\n");
+
+    return result;
+}
+
+int getPresentMode(const char* name) {
+    for (int i = 0; i < (int) (sizeof(PRESENT_MODE_NAMES) / sizeof(PRESENT_MODE_NAMES[0])); i++) {
+        if (strcmp(name, PRESENT_MODE_NAMES[i]) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+void waitForFrame(FramePacer* pacer) {
+    if (pacer->mode != PRESENT_CAPPED)
+        return;
+
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    // Too far behind to catch up so start over
+    // from now instead of rushing frames out
+    if (now > pacer->nextFrame + pacer->frameLength)
+        pacer->nextFrame = now;
+
+    // Sleep for most of it then spin the rest,
+    // sleeping alone wakes up late
+    double remaining = toMs(pacer, pacer->nextFrame > now ? pacer->nextFrame - now : 0);
+
+    if (remaining > SPIN_MARGIN_MS)
+        SDL_Delay((Uint32) (remaining - SPIN_MARGIN_MS));
+
+    while (SDL_GetPerformanceCounter() < pacer->nextFrame);
+
+    pacer->nextFrame += pacer->frameLength;
+}
+
+void markInputSampled(FramePacer* pacer) {
+    pacer->inputTime = SDL_GetPerformanceCounter();
+}
+
+void markPresented(FramePacer* pacer) {
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    double frame = toMs(pacer, now - pacer->lastPresent);
+    pacer->lastPresent = now;
+    pacer->lastFrame = frame;
+
+    pacer->frames++;
+    pacer->frameSum += frame;
+    pacer->frameSquares += frame * frame;
+    if (frame > pacer->frameMax)
+        pacer->frameMax = frame;
+
+    // Swapping returns about when the frame is
+    // queued, the display still adds its own
+    pacer->latencySum += toMs(pacer, now - pacer->inputTime);
+
+    if (pacer->reportLength == 0 || now - pacer->lastReport < pacer->reportLength)
+        return;
+
+    double mean = pacer->frameSum / pacer->frames;
+    double variance = pacer->frameSquares / pacer->frames - mean * mean;
+    double deviation = variance > 0.0 ? sqrt(variance) : 0.0;
+
+    fprintf(stderr, "Frames: %.2f ms avg (%.1f fps), %.2f ms std dev, %.2f ms max, %.2f ms input to present\n",
+            mean, 1000.0 / mean, deviation, pacer->frameMax, pacer->latencySum / pacer->frames);
+
+    pacer->frames = 0;
+    pacer->frameSum = 0.0;
+    pacer->frameSquares = 0.0;
+    pacer->frameMax = 0.0;
+    pacer->latencySum = 0.0;
+    pacer->lastReport = now;
+}
+
+void freeFramePacer(FramePacer** pacerPtrPtr) {
+    free(*pacerPtrPtr);
+    *pacerPtrPtr = NULL;
+}
+
+void addFrameTime(FrameTimes* frames, double milliseconds) {
+    if (frames->count == frames->capacity) {
+        int capacity = frames->capacity > 0 ? frames->capacity * 2 : 1024;
+        double* times = realloc(frames->times, capacity * sizeof(double));
+
+        if (times == NULL) {
+            fprintf(stderr, "ERROR: unable to allocate memory for program!\n");
+            exit(1);
+        }
+
+        frames->times = times;
+        frames->capacity = capacity;
+    }
+
+    frames->times[frames->count++] = milliseconds;
+}
+
+static int compareFrameTimes(const void* a, const void* b) {
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+
+    return (x > y) - (x < y);
+}
+
+static double getPercentile(FrameTimes* sorted, double percent) {
+    int index = (int) (percent / 100.0 * (sorted->count - 1) + 0.5);
+    return sorted->times[index];
+}
+
+void summarizeFrameTimes(FrameTimes* frames, FrameSummary* summary) {
+    memset(summary, 0, sizeof(FrameSummary));
+
+    if (frames->count == 0)
+        return;
+
+    for (int i = 0; i < frames->count; i++)
+        summary->total += frames->times[i];
+
+    qsort(frames->times, frames->count, sizeof(double), compareFrameTimes);
+
+    summary->count = frames->count;
+    summary->mean = summary->total / frames->count;
+    summary->min = frames->times[0];
+    summary->p50 = getPercentile(frames, 50.0);
+    summary->p95 = getPercentile(frames, 95.0);
+    summary->p99 = getPercentile(frames, 99.0);
+    summary->max = frames->times[frames->count - 1];
+}
+
+void freeFrameTimes(FrameTimes* frames) {
+    free(frames->times);
+
+    frames->times = NULL;
+    frames->count = 0;
+    frames->capacity = 0;
+}
@@ -0,0 +1,126 @@
+#include <SDL2/SDL.h>
+
+#ifndef PACING_H
+#define PACING_H
+
+/**
+ * How frames are handed to the display.
+ *
+ * Vsync waits for every refresh, adaptive does the
+ * same but tears instead of waiting a whole extra
+ * refresh when a frame is late. Uncapped never
+ * waits and capped waits for a target frame rate
+ * itself.
+ *
+ */
+enum PresentMode {
+    PRESENT_VSYNC,
+    PRESENT_ADAPTIVE,
+    PRESENT_UNCAPPED,
+    PRESENT_CAPPED
+};
+
+/**
+ * Keeps frames to the presentation mode and
+ * measures how even they are.
+ *
+ */
+typedef struct _framePacer {
+    enum PresentMode mode;
+
+    // Performance counter units
+    Uint64 frequency;
+    Uint64 frameLength;
+    Uint64 nextFrame;
+
+    Uint64 inputTime;
+    Uint64 lastPresent;
+
+    // Time between the last two presents in
+    // milliseconds
+    double lastFrame;
+
+    // Since the last report, in milliseconds
+    int frames;
+    double frameSum;
+    double frameSquares;
+    double frameMax;
+    double latencySum;
+
+    Uint64 lastReport;
+    Uint64 reportLength;
+} FramePacer;
+
+/**
+ * Every frame time of a run in milliseconds, for
+ * stats that need all of them rather than sums.
+ *
+ */
+typedef struct _frameTimes {
+    double* times;
+    int count;
+    int capacity;
+} FrameTimes;
+
+typedef struct _frameSummary {
+    int count;
+    double total;
+    double mean;
+    double min;
+    double p50;
+    double p95;
+    double p99;
+    double max;
+} FrameSummary;
+
+/**
+ * Sets the swap interval for the mode, so the GL
+ * context has to exist. targetFps is only used
+ * when capped. Stats are printed every
+ * reportSeconds, or never if it is 0.
+ *
+ */
+FramePacer* initFramePacer(enum PresentMode mode, double targetFps, double reportSeconds);
+
+/**
+ * Returns the mode named by a string or -1 if
+ * there is none.
+ *
+ */
+int getPresentMode(const char* name);
+
+/**
+ * Waits until the next frame should start, only
+ * capped frames wait here. Input should be read
+ * right after this returns.
+ *
+ */
+void waitForFrame(FramePacer* pacer);
+
+/**
+ * Marks when input for this frame was read.
+ *
+ */
+void markInputSampled(FramePacer* pacer);
+
+/**
+ * Marks the frame as presented, call it right
+ * after swapping.
+ *
+ */
+void markPresented(FramePacer* pacer);
+
+void freeFramePacer(FramePacer** pacerPtrPtr);
+
+void addFrameTime(FrameTimes* frames, double milliseconds);
+
+/**
+ * Works out the mean and percentiles of the
+ * frame times, which are sorted to do it.
+ *
+ */
+void summarizeFrameTimes(FrameTimes* frames, FrameSummary* summary);
+
+void freeFrameTimes(FrameTimes* frames);
+
+#endif
@@ -0,0 +1,182 @@
+/**
+ * A global table of every cube ID that has
+ * been used, cube IDs are looked up by string
+ * so two copies of the same name share an ID.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "palette.h"
+#include "region.h"
+
+// Entries live in chunks that never move once
+// made, so they can be read on any thread while
+// the palette grows
+#define PALETTE_CHUNK_BITS 8
+#define PALETTE_CHUNK_SIZE (1 << PALETTE_CHUNK_BITS)
+#define PALETTE_CHUNK_COUNT ((PALETTE_MISSING + PALETTE_CHUNK_SIZE - 1) / PALETTE_CHUNK_SIZE)
+
+typedef struct _paletteEntry {
+    char* cubeID;
+    // Light it gives off, 0 for most
+    uint8_t light;
+    uint8_t transparent;
+} PaletteEntry;
+
+static PaletteEntry* paletteChunks[PALETTE_CHUNK_COUNT];
+
+// Entries below the size are filled in before
+// it is raised, only adding takes the lock
+static int paletteSize = 0;
+static SDL_SpinLock paletteLock = 0;
+
+static PaletteEntry* getEntry(uint16_t paletteID) {
+    return &(paletteChunks[paletteID >> PALETTE_CHUNK_BITS][paletteID & (PALETTE_CHUNK_SIZE - 1)]);
+}
+
+static int getSize() {
+    return __atomic_load_n(&paletteSize, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Only called with the lock held.
+ *
+ */
+static uint16_t addCube(char* cubeID) {
+    if (paletteSize == PALETTE_MISSING) {
+        fprintf(stderr, "ERROR: Too many cube types for the palette!\n");
+        exit(1);
+    }
+
+    int chunk = paletteSize >> PALETTE_CHUNK_BITS;
+
+    if (paletteChunks[chunk] == NULL) {
+        paletteChunks[chunk] = calloc(PALETTE_CHUNK_SIZE, sizeof(PaletteEntry));
+
+        if (paletteChunks[chunk] == NULL) {
+            fprintf(stderr, "ERROR: Cannot allocate space for palette!\n");
+            exit(1);
+        }
+    }
+
+    // Callers may pass IDs that don't live long,
+    // so the palette keeps its own copy. Air is
+    // kept as itself so it compares by pointer.
+    char* copy = cubeID == AIR_CUBE ? AIR_CUBE : strdup(cubeID);
+
+    if (copy == NULL) {
+        fprintf(stderr, "ERROR: Cannot allocate space for palette!\n");
+        exit(1);
+    }
+
+    PaletteEntry* entry = getEntry(paletteSize);
+    entry->cubeID = copy;
+    entry->light = 0;
+    entry->transparent = 0;
+
+    // Readers only look at it once it is counted
+    __atomic_store_n(&paletteSize, paletteSize + 1, __ATOMIC_RELEASE);
+    return paletteSize - 1;
+}
+
+uint16_t findPaletteID(const char* cubeID) {
+    int size = getSize();
+
+    // Most callers pass the same pointers
+    // around so check those first
+    for (int i = 0; i < size; i++) {
+        if (getEntry(i)->cubeID == cubeID)
+            return i;
+    }
+
+    for (int i = 0; i < size; i++) {
+        if (strcmp(getEntry(i)->cubeID, cubeID) == 0)
+            return i;
+    }
+
+    // Air is always first, even before it is added
+    if (strcmp(cubeID, AIR_CUBE) == 0)
+        return 0;
+
+    return PALETTE_MISSING;
+}
+
+uint16_t getPaletteID(char* cubeID) {
+    uint16_t paletteID = findPaletteID(cubeID);
+
+    if (paletteID != PALETTE_MISSING && paletteID < getSize())
+        return paletteID;
+
+    SDL_AtomicLock(&paletteLock);
+
+    // Air is always first
+    if (paletteSize == 0)
+        addCube(AIR_CUBE);
+
+    // Someone else may have added it meanwhile
+    paletteID = findPaletteID(cubeID);
+    if (paletteID == PALETTE_MISSING)
+        paletteID = addCube(cubeID);
+
+    SDL_AtomicUnlock(&paletteLock);
+
+    return paletteID;
+}
+
+char* getPaletteCube(uint16_t paletteID) {
+    if (paletteID == 0)
+        return AIR_CUBE;
+
+    if (paletteID >= getSize())
+        return ERR_CUBE;
+
+    return getEntry(paletteID)->cubeID;
+}
+
+void setPaletteLight(char* cubeID, int level) {
+    if (level < 0)
+        level = 0;
+    if (level > 15)
+        level = 15;
+
+    // Adds the cube first if it is new
+    uint16_t paletteID = getPaletteID(cubeID);
+    __atomic_store_n(&(getEntry(paletteID)->light), level, __ATOMIC_RELAXED);
+}
+
+int getPaletteLight(uint16_t paletteID) {
+    if (paletteID >= getSize())
+        return 0;
+
+    return __atomic_load_n(&(getEntry(paletteID)->light), __ATOMIC_RELAXED);
+}
+
+void setPaletteTransparent(char* cubeID, int transparent) {
+    uint16_t paletteID = getPaletteID(cubeID);
+
+    // Air can't be seen anyway
+    if (paletteID == 0)
+        return;
+
+    __atomic_store_n(&(getEntry(paletteID)->transparent), transparent != 0, __ATOMIC_RELAXED);
+}
+
+int isPaletteTransparent(uint16_t paletteID) {
+    if (paletteID >= getSize())
+        return 0;
+
+    return __atomic_load_n(&(getEntry(paletteID)->transparent), __ATOMIC_RELAXED);
+}
+
+int isCubeTransparent(char* cubeID) {
+    // Also adds the cube, so whatever is written
+    // to a region can be found by the workers
+    return isPaletteTransparent(getPaletteID(cubeID));
+}
+
+int getPaletteSize() {
+    return getSize();
+}
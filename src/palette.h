@@ -0,0 +1,68 @@
+#include <stdint.h>
+
+#ifndef PALETTE_H
+#define PALETTE_H
+
+// Never a palette ID, the palette is full
+// before it gets this far
+#define PALETTE_MISSING UINT16_MAX
+
+/**
+ * Maps cube IDs to small numbers so they can
+ * be stored compactly. Air is always 0. Safe
+ * from any thread, adding takes a lock.
+ *
+ * Returns the palette ID, adding a copy of the
+ * cube if it has not been seen before.
+ */
+uint16_t getPaletteID(char* cubeID);
+
+/**
+ * Only looks the cube up, never adds it, so job
+ * workers reading snapshots never wait on the
+ * lock. Every cube written to a region is added
+ * by the thread writing it.
+ *
+ * Returns PALETTE_MISSING if it hasn't been
+ * added.
+ */
+uint16_t findPaletteID(const char* cubeID);
+
+/**
+ * Returns the cube ID for a palette ID or
+ * ERR_CUBE if there is none. The palette owns
+ * the string so it lives as long as the program,
+ * use it for IDs that come from short lived
+ * buffers. Air is always AIR_CUBE itself.
+ *
+ */
+char* getPaletteCube(uint16_t paletteID);
+
+/**
+ * Sets how much light a cube gives off, from 0
+ * to 15. Has to be set before the cube is used.
+ *
+ */
+void setPaletteLight(char* cubeID, int level);
+int getPaletteLight(uint16_t paletteID);
+
+/**
+ * Marks a cube as see-through, its faces are
+ * drawn sorted after everything else and don't
+ * hide the faces behind them. Has to be set
+ * before the cube is used.
+ *
+ */
+void setPaletteTransparent(char* cubeID, int transparent);
+int isPaletteTransparent(uint16_t paletteID);
+
+/**
+ * Same as isPaletteTransparent but by cube ID,
+ * air is never transparent.
+ *
+ */
+int isCubeTransparent(char* cubeID);
+
+int getPaletteSize();
+
+#endif
@@ -0,0 +1,189 @@
+/**
+ * Box collision against the mini cube grid.
+ * Solid cells are found through the occupancy
+ * rows so a whole row of a box is one test.
+ *
+ */
+#include <stdlib.h>
+#include <math.h>
+
+#include "physics.h"
+
+// Moves are split so no part moves further
+// than this many mini cubes along an axis
+static const float PHYSICS_MAX_STEP = 1.0f;
+static const int PHYSICS_MAX_SUBSTEPS = 16;
+
+// Boxes touching a mini cube aren't inside it,
+// in mini cubes
+static const float PHYSICS_SKIN = 1e-3f;
+
+/**
+ * Returns 1 if any mini cube from lo to hi
+ * (inclusive, counted from the anchor's first
+ * mini cube) is solid. Regions that aren't loaded
+ * count as air.
+ *
+ */
+static int isCellBoxSolid(Region* anchor, int lo[3], int hi[3]) {
+    const int depth = REGION_MCUBE_DEPTH;
+
+    int rlo[3], rhi[3];
+    for (int i = 0; i < 3; i++) {
+        rlo[i] = floorDiv(lo[i], depth);
+        rhi[i] = floorDiv(hi[i], depth);
+    }
+
+    for (int ry = rlo[1]; ry <= rhi[1]; ry++) {
+        for (int rz = rlo[2]; rz <= rhi[2]; rz++) {
+            for (int rx = rlo[0]; rx <= rhi[0]; rx++) {
+                Region* reg = findRegion(anchor, rx, ry, rz);
+
+                if (reg == NULL)
+                    continue;
+
+                int base[3] = {rx * depth, ry * depth, rz * depth};
+                int from[3], to[3];
+
+                for (int i = 0; i < 3; i++) {
+                    from[i] = lo[i] - base[i] < 0 ? 0 : lo[i] - base[i];
+                    to[i] = hi[i] - base[i] > depth - 1 ? depth - 1 : hi[i] - base[i];
+                }
+
+                RegionRow mask = getRowMask(from[0], to[0]);
+
+                for (int y = from[1]; y <= to[1]; y++) {
+                    for (int z = from[2]; z <= to[2]; z++) {
+                        if (reg->occupancy[z + y * depth] & mask)
+                            return 1;
+                    }
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Sweeps the box (in mini cubes from the anchor,
+ * where mini cube n covers n to n + 1) along one
+ * axis and returns how far it can go.
+ *
+ */
+static float sweepAxis(Region* anchor, float lo[3], float hi[3], int axis, float delta) {
+    if (delta == 0.0f)
+        return 0.0f;
+
+    int cellLo[3], cellHi[3];
+    for (int i = 0; i < 3; i++) {
+        cellLo[i] = (int) floorf(lo[i] + PHYSICS_SKIN);
+        cellHi[i] = (int) floorf(hi[i] - PHYSICS_SKIN);
+    }
+
+    // Check each layer of mini cubes the leading
+    // side passes into, nearest first
+    if (delta > 0.0f) {
+        int last = (int) floorf(hi[axis] + delta - PHYSICS_SKIN);
+
+        for (int layer = cellHi[axis] + 1; layer <= last; layer++) {
+            cellLo[axis] = cellHi[axis] = layer;
+
+            if (isCellBoxSolid(anchor, cellLo, cellHi))
+                return fmaxf((float) layer - hi[axis], 0.0f);
+        }
+    }
+    else {
+        int last = (int) floorf(lo[axis] + delta + PHYSICS_SKIN);
+
+        for (int layer = cellLo[axis] - 1; layer >= last; layer--) {
+            cellLo[axis] = cellHi[axis] = layer;
+
+            if (isCellBoxSolid(anchor, cellLo, cellHi))
+                return fminf((float) (layer + 1) - lo[axis], 0.0f);
+        }
+    }
+
+    return delta;
+}
+
+void moveBody(Region* anchor, Body* body, vec3s move) {
+    body->contacts = 0;
+
+    if (anchor == NULL) {
+        body->position = glms_vec3_add(body->position, move);
+        return;
+    }
+
+    // Work in mini cubes from the anchor, they
+    // are centered on their index
+    float lo[3], hi[3], delta[3];
+    float longest = 0.0f;
+
+    for (int i = 0; i < 3; i++) {
+        float center = (body->position.raw[i] - anchor->meshPtr->position.raw[i]) / REGION_MCUBE_SIZE + 0.5f;
+        float half = body->halfSize.raw[i] / REGION_MCUBE_SIZE;
+
+        lo[i] = center - half;
+        hi[i] = center + half;
+        delta[i] = move.raw[i] / REGION_MCUBE_SIZE;
+
+        longest = fmaxf(longest, fabsf(delta[i]));
+    }
+
+    int substeps = (int) ceilf(longest / PHYSICS_MAX_STEP);
+    if (substeps < 1)
+        substeps = 1;
+    if (substeps > PHYSICS_MAX_SUBSTEPS)
+        substeps = PHYSICS_MAX_SUBSTEPS;
+
+    // Up and down first so walking over the
+    // ground doesn't catch on it
+    const int order[3] = {1, 0, 2};
+    const enum CubeFace lowFaces[3] = {LEFT, BOTTOM, BACK};
+    const enum CubeFace highFaces[3] = {RIGHT, TOP, FRONT};
+
+    for (int step = 0; step < substeps; step++) {
+        for (int j = 0; j < 3; j++) {
+            int axis = order[j];
+            float want = delta[axis] / substeps;
+            float moved = sweepAxis(anchor, lo, hi, axis, want);
+
+            lo[axis] += moved;
+            hi[axis] += moved;
+
+            if (moved != want) {
+                body->contacts |= 1 << (want > 0.0f ? highFaces[axis] : lowFaces[axis]);
+                body->velocity.raw[axis] = 0.0f;
+
+                // Nothing left to move on this axis
+                delta[axis] = 0.0f;
+            }
+        }
+    }
+
+    for (int i = 0; i < 3; i++)
+        body->position.raw[i] = ((lo[i] + hi[i]) * 0.5f - 0.5f) * REGION_MCUBE_SIZE + anchor->meshPtr->position.raw[i];
+}
+
+void stepBodies(Region* anchor, Body* bodies, int count, float deltaTime) {
+    for (int i = 0; i < count; i++)
+        moveBody(anchor, &(bodies[i]), glms_vec3_scale(bodies[i].velocity, deltaTime));
+}
+
+int isBoxBlocked(Region* anchor, vec3s position, vec3s halfSize) {
+    if (anchor == NULL)
+        return 0;
+
+    int lo[3], hi[3];
+
+    for (int i = 0; i < 3; i++) {
+        float center = (position.raw[i] - anchor->meshPtr->position.raw[i]) / REGION_MCUBE_SIZE + 0.5f;
+        float half = halfSize.raw[i] / REGION_MCUBE_SIZE;
+
+        lo[i] = (int) floorf(center - half + PHYSICS_SKIN);
+        hi[i] = (int) floorf(center + half - PHYSICS_SKIN);
+    }
+
+    return isCellBoxSolid(anchor, lo, hi);
+}
@@ -0,0 +1,49 @@
+#include "region.h"
+#include <cglm/struct.h>
+
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+/**
+ * An axis aligned box that collides with mini
+ * cubes. Positions are in world space like the
+ * region positions.
+ *
+ */
+typedef struct _body {
+    vec3s position;
+    vec3s halfSize;
+
+    // World units per second, used by stepBodies
+    vec3s velocity;
+
+    // Bits (1 << CubeFace) for each side that was
+    // stopped by a mini cube on the last move
+    int contacts;
+} Body;
+
+/**
+ * Moves the body by move, sliding along any mini
+ * cubes in the way of the anchor region or
+ * anything linked to it. Each axis is swept on
+ * its own and long moves are split up so fast
+ * bodies can't pass through thin walls.
+ *
+ * Velocity along a blocked axis is zeroed.
+ */
+void moveBody(Region* anchor, Body* body, vec3s move);
+
+/**
+ * Moves every body by its velocity.
+ *
+ */
+void stepBodies(Region* anchor, Body* bodies, int count, float deltaTime);
+
+/**
+ * Returns 1 if any mini cube overlaps the box,
+ * 0 otherwise.
+ *
+ */
+int isBoxBlocked(Region* anchor, vec3s position, vec3s halfSize);
+
+#endif
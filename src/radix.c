@@ -0,0 +1,84 @@
+/**
+ * Sorts 32 bit keys a byte at a time from the
+ * lowest, counting each byte then scattering the
+ * keys into place. Keys that only differ in a few
+ * bytes skip the passes where they all match.
+ *
+ */
+#include <string.h>
+
+#include "radix.h"
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (32 / RADIX_BITS)
+
+void radixSort(uint32_t* keys, uint32_t* values, int count, Arena* scratch) {
+    if (count < 2)
+        return;
+
+    size_t mark = getArenaMark(scratch);
+    uint32_t* tempKeys = arenaAlloc(scratch, count * sizeof(uint32_t));
+    uint32_t* tempValues = arenaAlloc(scratch, count * sizeof(uint32_t));
+
+    // Every pass is counted in one go
+    int counts[RADIX_PASSES][RADIX_BUCKETS];
+    memset(counts, 0, sizeof(counts));
+
+    for (int i = 0; i < count; i++) {
+        for (int pass = 0; pass < RADIX_PASSES; pass++)
+            counts[pass][(keys[i] >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+    }
+
+    uint32_t* srcKeys = keys;
+    uint32_t* srcValues = values;
+    uint32_t* dstKeys = tempKeys;
+    uint32_t* dstValues = tempValues;
+
+    for (int pass = 0; pass < RADIX_PASSES; pass++) {
+        const int shift = pass * RADIX_BITS;
+
+        // Nothing to move if every key has the
+        // same byte here
+        if (counts[pass][(srcKeys[0] >> shift) & (RADIX_BUCKETS - 1)] == count)
+            continue;
+
+        int offsets[RADIX_BUCKETS];
+        int offset = 0;
+
+        for (int bucket = 0; bucket < RADIX_BUCKETS; bucket++) {
+            offsets[bucket] = offset;
+            offset += counts[pass][bucket];
+        }
+
+        for (int i = 0; i < count; i++) {
+            int index = offsets[(srcKeys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+            dstKeys[index] = srcKeys[i];
+            dstValues[index] = srcValues[i];
+        }
+
+        uint32_t* swapKeys = srcKeys;
+        uint32_t* swapValues = srcValues;
+        srcKeys = dstKeys;
+        srcValues = dstValues;
+        dstKeys = swapKeys;
+        dstValues = swapValues;
+    }
+
+    // An odd number of passes leaves the result
+    // in the temporary arrays
+    if (srcKeys != keys) {
+        memcpy(keys, srcKeys, count * sizeof(uint32_t));
+        memcpy(values, srcValues, count * sizeof(uint32_t));
+    }
+
+    rewindArena(scratch, mark);
+}
+
+uint32_t getDistanceKey(float distance) {
+    // Positive floats order the same as their bits
+    uint32_t bits;
+    memcpy(&bits, &distance, sizeof(bits));
+
+    return bits;
+}
@@ -0,0 +1,25 @@
+#include <stdint.h>
+
+#include "arena.h"
+
+#ifndef RADIX_H
+#define RADIX_H
+
+/**
+ * Sorts the keys from low to high and moves the
+ * values with them. Equal keys keep their order.
+ * The temporary arrays come from the scratch
+ * arena and are given back before it returns.
+ *
+ */
+void radixSort(uint32_t* keys, uint32_t* values, int count, Arena* scratch);
+
+/**
+ * Key that sorts distances (never negative)
+ * nearest first, flip the bits for farthest
+ * first.
+ *
+ */
+uint32_t getDistanceKey(float distance);
+
+#endif
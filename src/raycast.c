@@ -0,0 +1,263 @@
+/**
+ * Amanatides-Woo style voxel traversal over
+ * the mini cubes of linked regions.
+ *
+ * Everything in here works in mini cube units
+ * local to the region the ray is currently in,
+ * where mini cube i covers [i, i + 1).
+ *
+ */
+#include <math.h>
+#include <float.h>
+#include <stdlib.h>
+
+#include "raycast.h"
+
+typedef struct _rayState {
+    Region* reg;
+
+    // Ray origin relative to the current region
+    float origin[3];
+    float dir[3];
+
+    int cell[3];
+    int step[3];
+
+    // Ray distance to the next cell boundary and
+    // the distance between boundaries per axis
+    float tMax[3];
+    float tDelta[3];
+} RayState;
+
+/**
+ * Works out the distance to the next cell
+ * boundary on the given axis.
+ *
+ */
+static void setBoundary(RayState* ray, int axis) {
+    if (ray->step[axis] == 0) {
+        ray->tMax[axis] = FLT_MAX;
+        return;
+    }
+
+    float next = (float) (ray->cell[axis] + (ray->step[axis] > 0 ? 1 : 0));
+    ray->tMax[axis] = (next - ray->origin[axis]) / ray->dir[axis];
+}
+
+/**
+ * Distance at which the ray leaves the current
+ * region along the given axis.
+ *
+ */
+static float regionExit(RayState* ray, int axis) {
+    if (ray->step[axis] == 0)
+        return FLT_MAX;
+
+    float edge = ray->step[axis] > 0 ? (float) REGION_MCUBE_DEPTH : 0.0f;
+    return (edge - ray->origin[axis]) / ray->dir[axis];
+}
+
+/**
+ * Moves the ray into whichever neighbor holds
+ * its cell, shifting the local coordinates.
+ *
+ * Returns 1 if success, 0 if there is no
+ * region there.
+ */
+static int hopRegion(RayState* ray) {
+    for (int axis = 0; axis < 3; axis++) {
+        while (ray->cell[axis] < 0 || ray->cell[axis] >= REGION_MCUBE_DEPTH) {
+            int positive = ray->cell[axis] >= REGION_MCUBE_DEPTH;
+            Region* next = NULL;
+
+            switch (axis) {
+                case 0:
+                    next = positive ? ray->reg->right : ray->reg->left;
+                    break;
+                case 1:
+                    next = positive ? ray->reg->up : ray->reg->down;
+                    break;
+                case 2:
+                    next = positive ? ray->reg->front : ray->reg->back;
+                    break;
+            }
+
+            if (next == NULL)
+                return 0;
+
+            int shift = positive ? -REGION_MCUBE_DEPTH : REGION_MCUBE_DEPTH;
+            ray->cell[axis] += shift;
+            ray->origin[axis] += (float) shift;
+            ray->reg = next;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Places the ray on a cell at distance t where
+ * axis is the one that was just crossed.
+ *
+ */
+static void jumpTo(RayState* ray, float t, int axis, int cellOnAxis) {
+    for (int i = 0; i < 3; i++) {
+        if (i == axis) {
+            ray->cell[i] = cellOnAxis;
+        }
+        else {
+            // Clamp in case of rounding at the edges
+            int c = (int) floorf(ray->origin[i] + ray->dir[i] * t);
+            if (c < 0)
+                c = 0;
+            else if (c >= REGION_MCUBE_DEPTH)
+                c = REGION_MCUBE_DEPTH - 1;
+            ray->cell[i] = c;
+        }
+        setBoundary(ray, i);
+    }
+}
+
+/**
+ * The face a ray enters through after
+ * crossing a boundary on the given axis.
+ *
+ */
+static enum CubeFace enteredFace(int axis, int step) {
+    switch (axis) {
+        case 0:
+            return step > 0 ? LEFT : RIGHT;
+        case 1:
+            return step > 0 ? BOTTOM : TOP;
+        default:
+            return step > 0 ? BACK : FRONT;
+    }
+}
+
+int raycast(Region* start, vec3s origin, vec3s dir, float maxDist, RayHit* hit) {
+    if (start == NULL)
+        return 0;
+
+    dir = glms_vec3_normalize(dir);
+
+    RayState ray;
+    ray.reg = start;
+
+    for (int i = 0; i < 3; i++) {
+        // Mini cubes are centered on their index
+        ray.origin[i] = (origin.raw[i] - start->meshPtr->position.raw[i]) / REGION_MCUBE_SIZE + 0.5f;
+        ray.dir[i] = dir.raw[i];
+        ray.cell[i] = (int) floorf(ray.origin[i]);
+        ray.step[i] = dir.raw[i] > 0.0f ? 1 : (dir.raw[i] < 0.0f ? -1 : 0);
+        ray.tDelta[i] = ray.step[i] == 0 ? FLT_MAX : fabsf(1.0f / dir.raw[i]);
+    }
+
+    // The origin is outside of the loaded regions
+    if (!hopRegion(&ray))
+        return 0;
+
+    for (int i = 0; i < 3; i++)
+        setBoundary(&ray, i);
+
+    const float tLimit = maxDist / REGION_MCUBE_SIZE;
+    float t = 0.0f;
+    int lastAxis = -1;
+
+    while (t <= tLimit) {
+        if (!hopRegion(&ray))
+            return 0;
+
+        Region* reg = ray.reg;
+        int x = ray.cell[0];
+        int y = ray.cell[1];
+        int z = ray.cell[2];
+
+        RegionRow row = reg->occupancy[z + y * REGION_MCUBE_DEPTH];
+
+        // Whole region is air, go straight to
+        // whichever side the ray leaves through
+        if (reg->regType == FILLED && row == 0) {
+            int axis = 0;
+            float tExit = regionExit(&ray, 0);
+
+            for (int i = 1; i < 3; i++) {
+                float tAxis = regionExit(&ray, i);
+                if (tAxis < tExit) {
+                    tExit = tAxis;
+                    axis = i;
+                }
+            }
+
+            if (tExit > tLimit)
+                return 0;
+
+            t = tExit;
+            lastAxis = axis;
+            jumpTo(&ray, t, axis, ray.step[axis] > 0 ? REGION_MCUBE_DEPTH : -1);
+            continue;
+        }
+
+        // Nothing along this row, so skip to
+        // where y or z changes
+        if (row == 0) {
+            int axis = ray.tMax[1] < ray.tMax[2] ? 1 : 2;
+            float tNext = ray.tMax[axis];
+            float tExitX = regionExit(&ray, 0);
+
+            if (tExitX < tNext) {
+                if (tExitX > tLimit)
+                    return 0;
+
+                t = tExitX;
+                lastAxis = 0;
+                jumpTo(&ray, t, 0, ray.step[0] > 0 ? REGION_MCUBE_DEPTH : -1);
+                continue;
+            }
+
+            if (tNext > tLimit)
+                return 0;
+
+            t = tNext;
+            lastAxis = axis;
+            jumpTo(&ray, t, axis, ray.cell[axis] + ray.step[axis]);
+            continue;
+        }
+
+        if ((row >> x) & 1u) {
+            if (hit != NULL) {
+                // Started inside of a mini cube so
+                // use the face we are looking out of
+                if (lastAxis == -1) {
+                    lastAxis = 0;
+                    for (int i = 1; i < 3; i++) {
+                        if (fabsf(ray.dir[i]) > fabsf(ray.dir[lastAxis]))
+                            lastAxis = i;
+                    }
+                }
+
+                hit->region = reg;
+                hit->x = x;
+                hit->y = y;
+                hit->z = z;
+                hit->face = enteredFace(lastAxis, ray.step[lastAxis]);
+                hit->distance = t * REGION_MCUBE_SIZE;
+                hit->cubeID = getMCube(reg, x, y, z);
+            }
+            return 1;
+        }
+
+        // Regular step to the closest boundary
+        int axis = 0;
+        if (ray.tMax[1] < ray.tMax[axis])
+            axis = 1;
+        if (ray.tMax[2] < ray.tMax[axis])
+            axis = 2;
+
+        t = ray.tMax[axis];
+        lastAxis = axis;
+        ray.cell[axis] += ray.step[axis];
+        ray.tMax[axis] += ray.tDelta[axis];
+    }
+
+    return 0;
+}
@@ -0,0 +1,35 @@
+#include "region.h"
+#include <cglm/struct.h>
+
+#ifndef RAYCAST_H
+#define RAYCAST_H
+
+typedef struct _rayHit {
+    // Region and mini cube index that was hit
+    Region* region;
+    int x, y, z;
+
+    // The face of the mini cube the ray entered
+    enum CubeFace face;
+
+    // Distance from the origin in world units
+    float distance;
+
+    char* cubeID;
+} RayHit;
+
+/**
+ * Casts a ray from origin (world space) along
+ * dir through the mini cubes of the start
+ * region and anything linked to it. Regions
+ * filled with air and empty occupancy rows are
+ * skipped in one step.
+ *
+ * The ray stops at maxDist or when it leaves
+ * the linked regions.
+ *
+ * Returns 1 if a mini cube was hit, 0 otherwise.
+ */
+int raycast(Region* start, vec3s origin, vec3s dir, float maxDist, RayHit* hit);
+
+#endif
@@ -10,13 +10,168 @@
 #include <string.h>
 
 #include "region.h"
+#include "journal.h"
+#include "palette.h"
+#include "edit.h"
+#include "light.h"
+#include "compress.h"
+#include "cull.h"
 
-const int REGION_CUBE_DEPTH = 16;
-const int REGION_MCUBE_DEPTH = 32;
+const float REGION_MCUBE_SIZE = 0.25f;
+const int REGION_SECTION_DEPTH = 8;
 
 char* ERR_CUBE = "ERROR";
 char* AIR_CUBE = "";
 
+/**
+ * Sits in front of every block, the pointer
+ * handed out is just past it.
+ *
+ */
+typedef struct _regionBlockHeader {
+    int refs;
+    size_t size;
+} RegionBlockHeader;
+
+static RegionBlockHeader* getBlockHeader(void* block) {
+    return (RegionBlockHeader*) block - 1;
+}
+
+void* allocRegionBlock(size_t size) {
+    RegionBlockHeader* header = malloc(sizeof(RegionBlockHeader) + size);
+
+    if (header == NULL) {
+        fprintf(stderr, "ERROR: Cannot allocate space for Region data!\n");
+        exit(1);
+    }
+
+    header->refs = 1;
+    header->size = size;
+
+    return header + 1;
+}
+
+void* shareRegionBlock(void* block) {
+    __atomic_add_fetch(&(getBlockHeader(block)->refs), 1, __ATOMIC_RELAXED);
+
+    return block;
+}
+
+void releaseRegionBlock(void* block) {
+    if (block == NULL)
+        return;
+
+    RegionBlockHeader* header = getBlockHeader(block);
+
+    // Whoever lets go last frees it, after
+    // everyone else is done reading
+    if (__atomic_sub_fetch(&(header->refs), 1, __ATOMIC_ACQ_REL) == 0)
+        free(header);
+}
+
+// Mini cubes in a region, one light byte each
+#define REGION_CELLS (REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH)
+
+/**
+ * Blocks shared by every region whose light or
+ * occupancy is the same all the way through, so
+ * FILLED regions don't each hold their own. They
+ * keep a reference of their own so they are never
+ * freed, writing to one copies it like any other
+ * shared block.
+ *
+ */
+static struct {
+    RegionBlockHeader header;
+    uint8_t light[REGION_CELLS];
+} skyLightBlock = {{1, REGION_CELLS}, {[0 ... REGION_CELLS - 1] = LIGHT_SKY_FULL}};
+
+static struct {
+    RegionBlockHeader header;
+    uint8_t light[REGION_CELLS];
+} darkLightBlock = {{1, REGION_CELLS}, {0}};
+
+static struct {
+    RegionBlockHeader header;
+    RegionRow rows[2 * REGION_OCCUPANCY_ROWS];
+} emptyOccupancyBlock = {{1, 2 * REGION_OCCUPANCY_ROWS * sizeof(RegionRow)}, {0}};
+
+// Solid and opaque
+static struct {
+    RegionBlockHeader header;
+    RegionRow rows[2 * REGION_OCCUPANCY_ROWS];
+} fullOccupancyBlock = {{1, 2 * REGION_OCCUPANCY_ROWS * sizeof(RegionRow)}, {[0 ... 2 * REGION_OCCUPANCY_ROWS - 1] = REGION_ROW_FULL}};
+
+int isUniformRegionBlock(void* block) {
+    return block == skyLightBlock.light || block == darkLightBlock.light ||
+           block == emptyOccupancyBlock.rows || block == fullOccupancyBlock.rows;
+}
+
+/**
+ * Lets go of the block and takes a reference to
+ * one of the uniform ones instead.
+ *
+ */
+static void* swapBlock(void* block, void* uniform) {
+    if (block == uniform)
+        return block;
+
+    releaseRegionBlock(block);
+    return shareRegionBlock(uniform);
+}
+
+int shareUniformLight(Region* reg) {
+    uint8_t level = reg->light[0];
+
+    if (level != 0 && level != LIGHT_SKY_FULL)
+        return 0;
+
+    for (int i = 1; i < REGION_CELLS; i++) {
+        if (reg->light[i] != level)
+            return 0;
+    }
+
+    // Nothing changes so it isn't counted as
+    // a write
+    reg->light = swapBlock(reg->light, level == 0 ? darkLightBlock.light : skyLightBlock.light);
+    return 1;
+}
+
+/**
+ * Returns the block if nothing else holds it,
+ * otherwise a copy of it.
+ *
+ */
+static void* getUniqueBlock(void* block) {
+    RegionBlockHeader* header = getBlockHeader(block);
+
+    // Only the editing thread adds references so
+    // a block held once stays that way
+    if (__atomic_load_n(&(header->refs), __ATOMIC_ACQUIRE) == 1)
+        return block;
+
+    void* copy = allocRegionBlock(header->size);
+    memcpy(copy, block, header->size);
+    releaseRegionBlock(block);
+
+    return copy;
+}
+
+void makeRegionWritable(Region* reg, int blocks) {
+    reg->version++;
+    touchRegion(reg);
+
+    if (blocks & REGION_BLOCK_DATA)
+        unpackRegion(reg);
+
+    if (blocks & REGION_BLOCK_DATA)
+        reg->data = getUniqueBlock(reg->data);
+    if (blocks & REGION_BLOCK_OCCUPANCY)
+        reg->occupancy = getUniqueBlock(reg->occupancy);
+    if (blocks & REGION_BLOCK_LIGHT)
+        reg->light = getUniqueBlock(reg->light);
+}
+
 Region* initRegion(vec3s pos) {
     Region* result = malloc(sizeof(Region));
 
@@ -26,12 +181,27 @@ Region* initRegion(vec3s pos) {
     }
 
     // Initalize as air by default
-    result->data = malloc(strlen(AIR_CUBE) + 1);
+    result->data = allocRegionBlock(sizeof(char*));
     result->data[0] = AIR_CUBE;
 
     result->regType = FILLED;
+    result->packed = NULL;
+    result->lastUsed = getRegionClock();
+
+    // Air everywhere so no bits are set
+    result->occupancy = shareRegionBlock(emptyOccupancyBlock.rows);
+    result->solidCount = 0;
+    memset(result->faceCounts, 0, sizeof(result->faceCounts));
+    result->clearCount = 0;
 
-    result->meshPtr = initMesh(pos);
+    // Open sky until it is lit properly
+    result->light = shareRegionBlock(skyLightBlock.light);
+
+    const int sectionsPerAxis = REGION_MCUBE_DEPTH / REGION_SECTION_DEPTH;
+    result->meshPtr = initMesh(pos, sectionsPerAxis * sectionsPerAxis * sectionsPerAxis);
+    result->remeshQueued = 0;
+    result->version = 0;
+    result->remeshRunning = 0;
     
     // Define the neighbors
     result->up = NULL;
@@ -44,129 +214,420 @@ Region* initRegion(vec3s pos) {
     return result;
 }
 
-int fillRegion(char* cubeID, Region* regPtr) {
-    if (regPtr->regType == FILLED && strcmp(*(regPtr->data), cubeID) == 0) {
+int setRegionFill(char* cubeID, Region* regPtr) {
+    if (regPtr->regType == FILLED && isSameCube(*(regPtr->data), cubeID)) {
         return 0;
     }
 
-    regPtr->regType = FILLED;
+    // The journal may want the old data
+    unpackRegion(regPtr);
 
     // Only 1 string list
-    char** newData = malloc(sizeof(char*));
+    char** newData = allocRegionBlock(sizeof(char*));
     newData[0] = cubeID;
 
-    free(regPtr->data);
+    // The journal may keep the old data around
+    // for undo
+    if (!journalRecordFill(regPtr, cubeID))
+        releaseRegionBlock(regPtr->data);
     regPtr->data = newData;
+    regPtr->regType = FILLED;
+
+    // Every row is either full or empty, only
+    // transparent cubes need rows of their own
+    int solid = strcmp(cubeID, AIR_CUBE) != 0;
+    int clear = solid && isCubeTransparent(cubeID);
+
+    if (clear) {
+        makeRegionWritable(regPtr, REGION_BLOCK_OCCUPANCY);
+
+        RegionRow* opaqueRows = getOccupancyPlane(regPtr, OCCUPANCY_OPAQUE);
+        for (int i = 0; i < REGION_OCCUPANCY_ROWS; i++) {
+            regPtr->occupancy[i] = REGION_ROW_FULL;
+            opaqueRows[i] = 0;
+        }
+    }
+    else {
+        makeRegionWritable(regPtr, 0);
+        regPtr->occupancy = swapBlock(regPtr->occupancy, solid ? fullOccupancyBlock.rows : emptyOccupancyBlock.rows);
+    }
 
-    // update ourselves
-    updateRegionMesh(regPtr);
+    regPtr->solidCount = solid ? REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH : 0;
+    regPtr->clearCount = clear ? regPtr->solidCount : 0;
+    for (int face = FRONT; face <= BOTTOM; face++)
+        regPtr->faceCounts[face] = solid ? REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH : 0;
 
-    // update all neighbors
-    updateRegionMesh(regPtr->up);
-    updateRegionMesh(regPtr->down);
-    updateRegionMesh(regPtr->left);
-    updateRegionMesh(regPtr->right);
-    updateRegionMesh(regPtr->front);
-    updateRegionMesh(regPtr->back);
+    // Solid mini cubes only hold light they give
+    // off, which is filled in when it is relit
+    regPtr->light = swapBlock(regPtr->light, solid ? darkLightBlock.light : skyLightBlock.light);
 
     return 1;
 }
 
-int setMCube(char* cubeID, Region* regPtr, vec3s pos) {
-    int x = floorf(pos.x);
-    int y = floorf(pos.y);
-    int z = floorf(pos.z);
+int fillRegion(char* cubeID, Region* regPtr) {
+    if (!setRegionFill(cubeID, regPtr))
+        return 0;
 
-    char* mcubeAtPos = getMCube(regPtr, x, y, z);
+    // everything changed, the neighbors only
+    // need the sections along our border and
+    // wherever the light spreads to
+    int lo[3] = {0, 0, 0};
+    int hi[3] = {REGION_MCUBE_DEPTH - 1, REGION_MCUBE_DEPTH - 1, REGION_MCUBE_DEPTH - 1};
 
-    // If there is already a mini cube there
-    // of the same ID
-    if (strcmp(mcubeAtPos, cubeID) == 0) 
+    EditBatch batch;
+    beginEdit(&batch);
+    markRegionEdited(&batch, regPtr, lo, hi);
+    endEdit(&batch);
+
+    return 1;
+}
+
+int expandRegion(Region* regPtr) {
+    if (regPtr->regType == MCUBED)
         return 0;
 
+    const int size = REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH;
+
+    // list of all minicubes
+    char** newData = allocRegionBlock(size * sizeof(char*));
+
     // Need to convert from filled to
     // mcubed
     if (regPtr->regType == FILLED) {
         char* fillCubeID = *(regPtr->data);
 
-        // list of all minicubes
-        char** newData = malloc(REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH * sizeof(char*));
-
-        for (int i = 0; i < REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH; i++)
+        for (int i = 0; i < size; i++)
             newData[i] = fillCubeID;
-
-        free(regPtr->data);
-        regPtr->data = newData;
-        regPtr->regType = MCUBED;
     }
     // Need to convert from cubed to
-    // mcubed
+    // mcubed, each cube covers a few
+    // mini cubes
     else if (regPtr->regType == CUBED) {
+        for (int y = 0; y < REGION_MCUBE_DEPTH; y++)
+            for (int z = 0; z < REGION_MCUBE_DEPTH; z++)
+                for (int x = 0; x < REGION_MCUBE_DEPTH; x++)
+                    newData[x + z * REGION_MCUBE_DEPTH + y * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH] = getMCube(regPtr, x, y, z);
     }
 
+    releaseRegionBlock(regPtr->data);
+    regPtr->data = newData;
+    regPtr->regType = MCUBED;
+
+    return 1;
+}
+
+int collapseRegion(Region* regPtr) {
+    const int size = REGION_CELLS;
+
+    if (regPtr->regType != MCUBED || regPtr->packed != NULL)
+        return 0;
+
+    // Only all air or all solid can be one cube,
+    // which most edits aren't
+    if (regPtr->solidCount != 0 && regPtr->solidCount != size)
+        return 0;
+
+    char* cubeID = regPtr->data[0];
+
+    for (int i = 1; i < size; i++) {
+        if (!isSameCube(regPtr->data[i], cubeID))
+            return 0;
+    }
+
+    makeRegionWritable(regPtr, 0);
+
+    char** newData = allocRegionBlock(sizeof(char*));
+    newData[0] = cubeID;
+
+    releaseRegionBlock(regPtr->data);
+    regPtr->data = newData;
+    regPtr->regType = FILLED;
+
+    // Transparent rows differ between the planes,
+    // the rest can share like a fill does
+    if (regPtr->clearCount == 0)
+        regPtr->occupancy = swapBlock(regPtr->occupancy, regPtr->solidCount != 0 ? fullOccupancyBlock.rows : emptyOccupancyBlock.rows);
+
+    return 1;
+}
+
+int setMCube(char* cubeID, Region* regPtr, vec3s pos) {
+    int x = floorf(pos.x);
+    int y = floorf(pos.y);
+    int z = floorf(pos.z);
+
+    char* mcubeAtPos = getMCube(regPtr, x, y, z);
+
+    // If there is already a mini cube there
+    // of the same ID
+    if (isSameCube(mcubeAtPos, cubeID))
+        return 0;
+
+    int index = x + z * REGION_MCUBE_DEPTH + y * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH;
+
+    journalRecordCells(regPtr, index, 1, cubeID);
+    expandRegion(regPtr);
+    makeRegionWritable(regPtr, REGION_BLOCK_DATA);
+
     // Set the value
-    regPtr->data[x + z * REGION_MCUBE_DEPTH + y * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH] = cubeID;
+    regPtr->data[index] = cubeID;
+
+    setOccupancyBits(regPtr, y, z, REGION_ROW_BIT(x), cubeID);
+    collapseRegion(regPtr);
 
-    // update ourselves
-    updateRegionMesh(regPtr);
+    // Only the sections around the mini cube
+    // and wherever its light reaches need to be
+    // rebuilt
+    int pos3[3] = {x, y, z};
 
-    // update all neighbors
-    updateRegionMesh(regPtr->up);
-    updateRegionMesh(regPtr->down);
-    updateRegionMesh(regPtr->left);
-    updateRegionMesh(regPtr->right);
-    updateRegionMesh(regPtr->front);
-    updateRegionMesh(regPtr->back);
+    EditBatch batch;
+    beginEdit(&batch);
+    markRegionEdited(&batch, regPtr, pos3, pos3);
+    endEdit(&batch);
 
     return 1;
 }
 
-void updateRegionMesh(Region* reg) {
-    if (reg == NULL) 
+/**
+ * Marks the sections holding lo to hi as dirty
+ * without spilling into anything else.
+ *
+ */
+static void markSections(Region* reg, int lo[3], int hi[3]) {
+    const int sectionsPerAxis = REGION_MCUBE_DEPTH / REGION_SECTION_DEPTH;
+
+    // Meshes built before this are out of date
+    reg->version++;
+
+    for (int sy = lo[1] / REGION_SECTION_DEPTH; sy <= hi[1] / REGION_SECTION_DEPTH; sy++)
+        for (int sz = lo[2] / REGION_SECTION_DEPTH; sz <= hi[2] / REGION_SECTION_DEPTH; sz++)
+            for (int sx = lo[0] / REGION_SECTION_DEPTH; sx <= hi[0] / REGION_SECTION_DEPTH; sx++)
+                reg->meshPtr->sections[sx + sz * sectionsPerAxis + sy * sectionsPerAxis * sectionsPerAxis].dirty = 1;
+}
+
+void markRegionDirty(Region* reg, int lo[3], int hi[3]) {
+    if (reg == NULL)
         return;
 
-    clearMeshVertPointer(reg->meshPtr);
-    clearMeshElemPointer(reg->meshPtr);
-
-    int x, y, z;
-
-    for (y = 0; y < REGION_MCUBE_DEPTH; y++) {
-        for (x = 0; x < REGION_MCUBE_DEPTH; x++) {
-            for (z = 0; z < REGION_MCUBE_DEPTH; z++) {
-                float rx, ry, rz;
-                rx = (0.25f * (float) x) + reg->meshPtr->position.x;
-                ry = (0.25f * (float) y) + reg->meshPtr->position.y;
-                rz = (0.25f * (float) z) + reg->meshPtr->position.z;
-                vec3s pos = {.x = rx, .y = ry, .z = rz};
-
-                // If the current cube is air
-                if (strcmp(getMCube(reg, x, y, z), AIR_CUBE) == 0) 
-                    continue;
-
-                // Top is air
-                if (strcmp(getMCube(reg, x, y + 1, z), AIR_CUBE) == 0)
-                    addFace(reg->meshPtr, TOP, pos, 0.25f);
-                // Bottom is air
-                if (strcmp(getMCube(reg, x, y - 1, z), AIR_CUBE) == 0)
-                    addFace(reg->meshPtr, BOTTOM, pos, 0.25f);
-                // Front is air
-                if (strcmp(getMCube(reg, x, y, z + 1), AIR_CUBE) == 0) 
-                    addFace(reg->meshPtr, FRONT, pos, 0.25f);
-                // Back is air
-                if (strcmp(getMCube(reg, x, y, z - 1), AIR_CUBE) == 0)
-                    addFace(reg->meshPtr, BACK, pos, 0.25f);
-                // Left is air
-                if (strcmp(getMCube(reg, x - 1, y, z), AIR_CUBE) == 0)
-                    addFace(reg->meshPtr, LEFT, pos, 0.25f);
-                // Right is air
-                if (strcmp(getMCube(reg, x + 1, y, z), AIR_CUBE) == 0)
-                    addFace(reg->meshPtr, RIGHT, pos, 0.25f);
+    // Faces of the mini cubes right next to the
+    // changed ones may have been hidden or shown
+    int grownLo[3], grownHi[3];
+    for (int i = 0; i < 3; i++) {
+        grownLo[i] = lo[i] > 0 ? lo[i] - 1 : 0;
+        grownHi[i] = hi[i] < REGION_MCUBE_DEPTH - 1 ? hi[i] + 1 : REGION_MCUBE_DEPTH - 1;
+    }
+    markSections(reg, grownLo, grownHi);
+
+    // Along the border that includes the layer
+    // of the neighbor touching us
+    for (int axis = 0; axis < 3; axis++) {
+        const enum CubeFace lowFaces[3] = {LEFT, BOTTOM, BACK};
+        const enum CubeFace highFaces[3] = {RIGHT, TOP, FRONT};
+
+        int layerLo[3] = {lo[0], lo[1], lo[2]};
+        int layerHi[3] = {hi[0], hi[1], hi[2]};
+
+        if (lo[axis] == 0) {
+            Region* neighbor = getNeighbor(reg, lowFaces[axis]);
+            layerLo[axis] = layerHi[axis] = REGION_MCUBE_DEPTH - 1;
+            if (neighbor != NULL)
+                markSections(neighbor, layerLo, layerHi);
+        }
+
+        if (hi[axis] == REGION_MCUBE_DEPTH - 1) {
+            Region* neighbor = getNeighbor(reg, highFaces[axis]);
+            layerLo[axis] = layerHi[axis] = 0;
+            if (neighbor != NULL)
+                markSections(neighbor, layerLo, layerHi);
+        }
+    }
+}
+
+/**
+ * Adds the faces set in visible for one row of
+ * a section.
+ *
+ */
+static void addRowFaces(Region* reg, Mesh* mesh, MeshBuilder* builder, RegionRow visible[6][CULL_MAX_ROWS], int i, int y, int z) {
+    // Faces are built around the centre of
+    // each mini cube
+    const float halfSize = REGION_MCUBE_SIZE / 2.0f;
+
+    // Face records hold the position in the
+    // region so they skip the world positions
+    const int records = mesh->mode == MESH_FACES;
+
+    RegionRow any = visible[TOP][i] | visible[BOTTOM][i] | visible[FRONT][i] |
+                    visible[BACK][i] | visible[LEFT][i] | visible[RIGHT][i];
+
+    while (any != 0) {
+        int x = lowestRowBit(any);
+        any &= any - 1;
+
+        if (records) {
+            for (int face = 0; face < 6; face++) {
+                if ((visible[face][i] >> x) & 1u)
+                    addFaceRecord(builder, face, x, y, z, 1, 1, getFaceLight(reg, x, y, z, face));
             }
+
+            continue;
+        }
+
+        float rx, ry, rz;
+        rx = (REGION_MCUBE_SIZE * (float) x) + mesh->position.x;
+        ry = (REGION_MCUBE_SIZE * (float) y) + mesh->position.y;
+        rz = (REGION_MCUBE_SIZE * (float) z) + mesh->position.z;
+        vec3s pos = {.x = rx, .y = ry, .z = rz};
+
+        for (int face = 0; face < 6; face++) {
+            if ((visible[face][i] >> x) & 1u)
+                addFace(builder, face, pos, halfSize, getFaceLight(reg, x, y, z, face));
         }
     }
 }
 
-int connectRegions(Region* src, Region* dest, enum CubeFace face) {
+/**
+ * Builds the faces of a single section. A face
+ * is visible where a solid bit has a clear bit
+ * beside it, so the rows of each layer are culled
+ * together against the rows around them (see
+ * cull.h). Opaque cubes are culled against the
+ * opaque plane so they show through transparent
+ * ones, transparent cubes against the solid plane
+ * so they only show next to air.
+ *
+ */
+void buildRegionSection(Region* reg, Mesh* mesh, int section, MeshBuilder* builder, MeshBuilder* clearBuilder) {
+    const int sectionsPerAxis = REGION_MCUBE_DEPTH / REGION_SECTION_DEPTH;
+
+    if (isRegionEmpty(reg))
+        return;
+
+    int startX = (section % sectionsPerAxis) * REGION_SECTION_DEPTH;
+    int startZ = ((section / sectionsPerAxis) % sectionsPerAxis) * REGION_SECTION_DEPTH;
+    int startY = (section / (sectionsPerAxis * sectionsPerAxis)) * REGION_SECTION_DEPTH;
+
+    const RegionRow sectionMask = getRowMask(startX, startX + REGION_SECTION_DEPTH - 1);
+
+    RegionRow ends[REGION_SECTION_DEPTH + 2];
+    RegionRow visible[6][CULL_MAX_ROWS];
+
+    for (int y = startY; y < startY + REGION_SECTION_DEPTH; y++) {
+        CullRows rows;
+        getCullRows(reg, OCCUPANCY_OPAQUE, y, startZ, REGION_SECTION_DEPTH, ends, &rows);
+        cullRows(&rows, REGION_SECTION_DEPTH, sectionMask, visible);
+
+        for (int i = 0; i < REGION_SECTION_DEPTH; i++)
+            addRowFaces(reg, mesh, builder, visible, i, y, startZ + i);
+
+        if (reg->clearCount == 0)
+            continue;
+
+        getCullRows(reg, OCCUPANCY_SOLID, y, startZ, REGION_SECTION_DEPTH, ends, &rows);
+        cullRows(&rows, REGION_SECTION_DEPTH, sectionMask, visible);
+
+        const RegionRow* opaque = &(getOccupancyPlane(reg, OCCUPANCY_OPAQUE)[startZ + y * REGION_MCUBE_DEPTH]);
+
+        for (int i = 0; i < REGION_SECTION_DEPTH; i++) {
+            // Only the solid bits that aren't opaque
+            RegionRow clear = rows.rows[i] & ~opaque[i];
+
+            for (int face = 0; face < 6; face++)
+                visible[face][i] &= clear;
+
+            addRowFaces(reg, mesh, clearBuilder, visible, i, y, startZ + i);
+        }
+    }
+}
+
+void updateRegionSections(Region* reg) {
+    if (reg == NULL)
+        return;
+
+    Mesh* mesh = reg->meshPtr;
+
+    // Faces are built in scratch space and copied
+    // into the sections, so nothing is allocated
+    // once the arena is big enough
+    Arena* scratch = getScratchArena();
+    size_t mark = getArenaMark(scratch);
+    MeshBuilder builder = {.data = NULL, .size = 0, .capacity = 0, .arena = scratch};
+    MeshBuilder clearBuilder = {.data = NULL, .size = 0, .capacity = 0, .arena = scratch};
+
+    for (int i = 0; i < mesh->sectionCount; i++) {
+        if (!mesh->sections[i].dirty)
+            continue;
+
+        clearMeshBuilder(&builder);
+        clearMeshBuilder(&clearBuilder);
+        buildRegionSection(reg, mesh, i, &builder, &clearBuilder);
+        setMeshSection(mesh, i, builder.data, builder.size, clearBuilder.data, clearBuilder.size);
+
+        mesh->sections[i].dirty = 0;
+    }
+
+    freeMeshBuilder(&builder);
+    freeMeshBuilder(&clearBuilder);
+    rewindArena(scratch, mark);
+}
+
+void updateRegionMesh(Region* reg) {
+    if (reg == NULL) 
+        return;
+
+    for (int i = 0; i < reg->meshPtr->sectionCount; i++)
+        reg->meshPtr->sections[i].dirty = 1;
+
+    updateRegionSections(reg);
+}
+
+Region* getNeighbor(Region* reg, enum CubeFace face) {
+    if (reg == NULL)
+        return NULL;
+
+    switch (face) {
+        case FRONT:
+            return reg->front;
+        case BACK:
+            return reg->back;
+        case LEFT:
+            return reg->left;
+        case RIGHT:
+            return reg->right;
+        case TOP:
+            return reg->up;
+        case BOTTOM:
+            return reg->down;
+    }
+    return NULL;
+}
+
+int floorDiv(int a, int b) {
+    return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+Region* findRegion(Region* anchor, int rx, int ry, int rz) {
+    Region* reg = anchor;
+
+    for (; rx > 0 && reg != NULL; rx--)
+        reg = reg->right;
+    for (; rx < 0 && reg != NULL; rx++)
+        reg = reg->left;
+
+    for (; ry > 0 && reg != NULL; ry--)
+        reg = reg->up;
+    for (; ry < 0 && reg != NULL; ry++)
+        reg = reg->down;
+
+    for (; rz > 0 && reg != NULL; rz--)
+        reg = reg->front;
+    for (; rz < 0 && reg != NULL; rz++)
+        reg = reg->back;
+
+    return reg;
+}
+
+static int linkRegions(Region* src, Region* dest, enum CubeFace face) {
     if (src == NULL || dest == NULL)
         return 0;
 
@@ -211,7 +672,7 @@ int connectRegions(Region* src, Region* dest, enum CubeFace face) {
     return 0;
 }
 
-int detachRegions(Region* src, Region* reg) {
+static int unlinkRegions(Region* src, Region* reg) {
     if (src == NULL || reg == NULL)
         return 0;
 
@@ -262,8 +723,323 @@ int detachRegions(Region* src, Region* reg) {
     return 0;
 }
 
+int connectRegions(Region* src, Region* dest, enum CubeFace face) {
+    if (!linkRegions(src, dest, face))
+        return 0;
+
+    // Borders that were open to the air are
+    // against a region now
+    src->version++;
+    dest->version++;
+
+    return 1;
+}
+
+int detachRegions(Region* src, Region* reg) {
+    if (!unlinkRegions(src, reg))
+        return 0;
+
+    src->version++;
+    reg->version++;
+
+    return 1;
+}
+
+void freeRegion(Region** regPptr) {
+    Region* regPtr = *regPptr;
+
+    if (regPtr == NULL)
+        return;
+
+    journalForgetRegion(regPtr);
+
+    // Make sure no neighbor points to us
+    detachRegions(regPtr, regPtr->up);
+    detachRegions(regPtr, regPtr->down);
+    detachRegions(regPtr, regPtr->left);
+    detachRegions(regPtr, regPtr->right);
+    detachRegions(regPtr, regPtr->front);
+    detachRegions(regPtr, regPtr->back);
+
+    freeMesh(&(regPtr->meshPtr));
+
+    free(regPtr->packed);
+    releaseRegionBlock(regPtr->data);
+    releaseRegionBlock(regPtr->occupancy);
+    releaseRegionBlock(regPtr->light);
+
+    free(regPtr);
+    *regPptr = NULL;
+}
+
+Region* snapshotRegion(Region* reg, int cells) {
+    if (cells)
+        unpackRegion(reg);
+
+    Region* result = malloc(sizeof(Region));
+
+    if (result == NULL) {
+        fprintf(stderr, "ERROR: Cannot allocate space for Region!\n");
+        exit(1);
+    }
+
+    *result = *reg;
+
+    // The packed runs stay with the region, they
+    // are freed when it unpacks
+    result->packed = NULL;
+
+    if (cells)
+        shareRegionBlock(result->data);
+    else
+        result->data = NULL;
+
+    shareRegionBlock(result->occupancy);
+    shareRegionBlock(result->light);
+
+    result->meshPtr = NULL;
+    result->remeshQueued = 0;
+    result->remeshRunning = 0;
+
+    result->up = NULL;
+    result->down = NULL;
+    result->left = NULL;
+    result->right = NULL;
+    result->front = NULL;
+    result->back = NULL;
+
+    return result;
+}
+
+/**
+ * Open addressed table from regions to their
+ * snapshots, so linking them stays linear in
+ * the number of regions.
+ *
+ */
+typedef struct _snapshotSlot {
+    Region* region;
+    Region* snapshot;
+} SnapshotSlot;
+
+static size_t getSnapshotSlot(Region* reg, size_t mask) {
+    uint64_t h = (uint64_t) (uintptr_t) reg * 0x9E3779B97F4A7C15ull;
+
+    return (size_t) (h >> 32) & mask;
+}
+
+static Region* findSnapshot(SnapshotSlot* slots, size_t mask, Region* reg) {
+    if (reg == NULL)
+        return NULL;
+
+    for (size_t i = getSnapshotSlot(reg, mask); slots[i].region != NULL; i = (i + 1) & mask) {
+        if (slots[i].region == reg)
+            return slots[i].snapshot;
+    }
+
+    return NULL;
+}
+
+Region** snapshotRegions(Region** regions, int count, int cellCount) {
+    // Kept under half full
+    size_t capacity = 16;
+    while (capacity < (size_t) count * 2)
+        capacity *= 2;
+
+    const size_t mask = capacity - 1;
+
+    Region** result = malloc(count * sizeof(Region*));
+    SnapshotSlot* slots = calloc(capacity, sizeof(SnapshotSlot));
+
+    if (result == NULL || slots == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate memory for program!\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < count; i++) {
+        result[i] = snapshotRegion(regions[i], i < cellCount);
+
+        size_t slot = getSnapshotSlot(regions[i], mask);
+        while (slots[slot].region != NULL)
+            slot = (slot + 1) & mask;
+
+        slots[slot].region = regions[i];
+        slots[slot].snapshot = result[i];
+    }
+
+    // Each link is made from both sides, the
+    // second attempt is refused
+    for (int i = 0; i < count; i++) {
+        for (int face = FRONT; face <= BOTTOM; face++) {
+            Region* neighbor = findSnapshot(slots, mask, getNeighbor(regions[i], face));
+
+            if (neighbor != NULL)
+                connectRegions(result[i], neighbor, face);
+        }
+    }
+
+    free(slots);
+
+    return result;
+}
+
+void freeRegionSnapshot(Region** snapshotPptr) {
+    Region* snapshot = *snapshotPptr;
+
+    if (snapshot == NULL)
+        return;
+
+    detachRegions(snapshot, snapshot->up);
+    detachRegions(snapshot, snapshot->down);
+    detachRegions(snapshot, snapshot->left);
+    detachRegions(snapshot, snapshot->right);
+    detachRegions(snapshot, snapshot->front);
+    detachRegions(snapshot, snapshot->back);
+
+    releaseRegionBlock(snapshot->data);
+    releaseRegionBlock(snapshot->occupancy);
+    releaseRegionBlock(snapshot->light);
+
+    free(snapshot);
+    *snapshotPptr = NULL;
+}
+
+void freeRegionSnapshots(Region*** snapshotsPtr, int count) {
+    Region** snapshots = *snapshotsPtr;
+
+    if (snapshots == NULL)
+        return;
+
+    for (int i = 0; i < count; i++)
+        freeRegionSnapshot(&(snapshots[i]));
+
+    free(snapshots);
+    *snapshotsPtr = NULL;
+}
+
+RegionRow* getOccupancyPlane(Region* reg, enum OccupancyPlane plane) {
+    return &(reg->occupancy[plane * REGION_OCCUPANCY_ROWS]);
+}
+
+void setOccupancyRow(Region* reg, int y, int z, RegionRow row, RegionRow opaque) {
+    const int index = z + y * REGION_MCUBE_DEPTH;
+
+    if (reg->occupancy[index] == row && reg->occupancy[index + REGION_OCCUPANCY_ROWS] == opaque)
+        return;
+
+    makeRegionWritable(reg, REGION_BLOCK_OCCUPANCY);
+    RegionRow* old = &(reg->occupancy[index]);
+    RegionRow* oldOpaque = &(reg->occupancy[index + REGION_OCCUPANCY_ROWS]);
+
+    reg->clearCount += countRowBits(row & ~opaque) - countRowBits(*old & ~*oldOpaque);
+    *oldOpaque = opaque;
+
+    int change = countRowBits(row) - countRowBits(*old);
+    reg->solidCount += change;
+
+    // The first and last bits are on the
+    // left and right borders
+    const int lastX = REGION_MCUBE_DEPTH - 1;
+    reg->faceCounts[LEFT] += (int) (row & 1u) - (int) (*old & 1u);
+    reg->faceCounts[RIGHT] += (int) ((row >> lastX) & 1u) - (int) ((*old >> lastX) & 1u);
+
+    // The whole row is on the others
+    if (z == 0)
+        reg->faceCounts[BACK] += change;
+    if (z == REGION_MCUBE_DEPTH - 1)
+        reg->faceCounts[FRONT] += change;
+    if (y == 0)
+        reg->faceCounts[BOTTOM] += change;
+    if (y == REGION_MCUBE_DEPTH - 1)
+        reg->faceCounts[TOP] += change;
+
+    *old = row;
+}
+
+void setOccupancyBits(Region* reg, int y, int z, RegionRow bits, char* cubeID) {
+    RegionRow row = reg->occupancy[z + y * REGION_MCUBE_DEPTH];
+    RegionRow opaque = reg->occupancy[z + y * REGION_MCUBE_DEPTH + REGION_OCCUPANCY_ROWS];
+
+    if (strcmp(cubeID, AIR_CUBE) == 0) {
+        row &= ~bits;
+        opaque &= ~bits;
+    }
+    else if (isCubeTransparent(cubeID)) {
+        row |= bits;
+        opaque &= ~bits;
+    }
+    else {
+        row |= bits;
+        opaque |= bits;
+    }
+
+    setOccupancyRow(reg, y, z, row, opaque);
+}
+
+int isRegionEmpty(Region* reg) {
+    return reg->solidCount == 0;
+}
+
+int isRegionFull(Region* reg) {
+    return reg->solidCount == REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH;
+}
+
+int isRegionFaceCovered(Region* reg, enum CubeFace face) {
+    return reg->faceCounts[face] == REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH;
+}
+
+void updateRegionOccupancy(Region* reg) {
+    // A filled region is one string compare
+    // instead of one per mini cube
+    int filledSolid = reg->regType == FILLED && strcmp(*(reg->data), AIR_CUBE) != 0;
+    int filledOpaque = filledSolid && !isCubeTransparent(*(reg->data));
+
+    for (int y = 0; y < REGION_MCUBE_DEPTH; y++) {
+        for (int z = 0; z < REGION_MCUBE_DEPTH; z++) {
+            RegionRow row = 0;
+            RegionRow opaque = 0;
+
+            if (reg->regType == FILLED) {
+                row = filledSolid ? REGION_ROW_FULL : 0;
+                opaque = filledOpaque ? REGION_ROW_FULL : 0;
+            }
+            else {
+                for (int x = 0; x < REGION_MCUBE_DEPTH; x++) {
+                    char* cubeID = getMCube(reg, x, y, z);
+
+                    if (strcmp(cubeID, AIR_CUBE) == 0)
+                        continue;
+
+                    row |= REGION_ROW_BIT(x);
+                    if (!isCubeTransparent(cubeID))
+                        opaque |= REGION_ROW_BIT(x);
+                }
+            }
+
+            setOccupancyRow(reg, y, z, row, opaque);
+        }
+    }
+}
+
+int isMCubeSolid(Region* reg, int x, int y, int z) {
+    return (reg->occupancy[z + y * REGION_MCUBE_DEPTH] >> x) & 1u;
+}
+
+RegionRow getRowMask(int x0, int x1) {
+    int width = x1 - x0 + 1;
+
+    if (width >= REGION_MCUBE_DEPTH)
+        return REGION_ROW_FULL;
+
+    return (RegionRow) ((REGION_ROW_BIT(width) - 1u) << x0);
+}
+
 char* getMCubeHelper(Region* reg, int x, int y, int z, int iter);
 
+int isSameCube(char* a, char* b) {
+    return a == b || strcmp(a, b) == 0;
+}
+
 char* getMCube(Region* reg, int x, int y, int z) {
     return getMCubeHelper(reg, x, y, z, 0);
 }
@@ -314,6 +1090,9 @@ char* getMCubeHelper(Region* reg, int x, int y, int z, int iter) {
             return *(reg->data);
         // Do typical indexing
         case MCUBED:
+            if (reg->packed != NULL)
+                unpackRegion(reg);
+
             return reg->data[x + z * REGION_MCUBE_DEPTH + y * REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH];
         // Since cubes are 2x bigger, this
         // will be a little more complex
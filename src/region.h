@@ -1,11 +1,69 @@
 #include "mesh.h"
+#include <stddef.h>
+#include <stdint.h>
 #include <cglm/struct.h>
 
 #ifndef REGION_H
 #define REGION_H
 
-extern const int REGION_CUBE_DEPTH;
-extern const int REGION_MCUBE_DEPTH;
+// Mini cubes along each side of a region, fixed
+// when building (make REGION_DEPTH=16, 32 or 64)
+// so the index math folds into constants
+#ifndef REGION_MCUBE_DEPTH
+#define REGION_MCUBE_DEPTH 32
+#endif
+
+// Cubes are two mini cubes a side
+#define REGION_CUBE_DEPTH (REGION_MCUBE_DEPTH / 2)
+
+extern const float REGION_MCUBE_SIZE;
+
+// Regions are meshed in cubic sections of
+// this many mini cubes a side
+extern const int REGION_SECTION_DEPTH;
+
+// Occupancy rows are as wide as the region,
+// REGION_MCUBE_BITS is log2 of the depth and
+// RegionIndex holds an index into the data
+#if REGION_MCUBE_DEPTH == 16
+typedef uint16_t RegionRow;
+typedef uint16_t RegionIndex;
+#define REGION_ROW_FULL ((RegionRow) 0xFFFFu)
+#define REGION_MCUBE_BITS 4
+#elif REGION_MCUBE_DEPTH == 32
+typedef uint32_t RegionRow;
+typedef uint16_t RegionIndex;
+#define REGION_ROW_FULL ((RegionRow) 0xFFFFFFFFu)
+#define REGION_MCUBE_BITS 5
+#elif REGION_MCUBE_DEPTH == 64
+typedef uint64_t RegionRow;
+typedef uint32_t RegionIndex;
+#define REGION_ROW_FULL ((RegionRow) 0xFFFFFFFFFFFFFFFFull)
+#define REGION_MCUBE_BITS 6
+#else
+#error "REGION_MCUBE_DEPTH must be 16, 32 or 64"
+#endif
+
+// The bit of mini cube x in a row
+#define REGION_ROW_BIT(x) ((RegionRow) 1 << (x))
+
+// Set bits and the lowest set bit of a row
+#define countRowBits(row) __builtin_popcountll((unsigned long long) (row))
+#define lowestRowBit(row) __builtin_ctzll((unsigned long long) (row))
+
+// Rows in one plane of the occupancy
+#define REGION_OCCUPANCY_ROWS (REGION_MCUBE_DEPTH * REGION_MCUBE_DEPTH)
+
+/**
+ * The occupancy holds a plane of rows for each,
+ * solid is anything but air and opaque leaves
+ * out transparent cubes (see palette.h).
+ *
+ */
+enum OccupancyPlane {
+    OCCUPANCY_SOLID,
+    OCCUPANCY_OPAQUE
+};
 
 extern char* ERR_CUBE;
 extern char* AIR_CUBE;
@@ -16,12 +74,70 @@ enum RegionType {
     MCUBED
 };
 
+/**
+ * The region storage is split into blocks that
+ * are reference counted, so snapshots share them
+ * with the region until it writes to one. Used
+ * as flags for makeRegionWritable.
+ *
+ */
+enum RegionBlock {
+    REGION_BLOCK_DATA = 1,
+    REGION_BLOCK_OCCUPANCY = 2,
+    REGION_BLOCK_LIGHT = 4
+};
+
 typedef struct _region {
+    // NULL for snapshots
     Mesh* meshPtr;
 
+    // The data, occupancy and light are blocks,
+    // anything writing to one has to make the
+    // region writable first
     enum RegionType regType;
     char** data;
 
+    // Set instead of the data while a cold
+    // MCUBED region is packed, see compress.h
+    struct _packedCells* packed;
+
+    // Frame the region was last used in, from
+    // getRegionClock
+    uint32_t lastUsed;
+
+    // One row per (y, z) with a bit per mini
+    // cube along x, set when it is not air.
+    // Indexed as z + y * REGION_MCUBE_DEPTH, the
+    // opaque plane follows the solid one.
+    RegionRow* occupancy;
+
+    // Solid mini cubes in the whole region and
+    // on each of its border layers (indexed by
+    // CubeFace), kept in step with the rows
+    int solidCount;
+    int faceCounts[6];
+
+    // Solid mini cubes that aren't opaque
+    int clearCount;
+
+    // One byte per mini cube indexed like the
+    // data, see light.h
+    uint8_t* light;
+
+    // Set while the region is waiting in an
+    // edit batch to be remeshed
+    int remeshQueued;
+
+    // Goes up whenever the region is written to,
+    // linked or has a neighbor change along its
+    // border. Anything worked out from an older
+    // version is out of date.
+    uint64_t version;
+
+    // Set while a job is remeshing it from a
+    // snapshot, see remesh.h
+    int remeshRunning;
+
     struct _region* up;
     struct _region* down;
     struct _region* left;
@@ -32,6 +148,72 @@ typedef struct _region {
 
 Region* initRegion(vec3s pos);
 
+/**
+ * Storage blocks for regions, they start with
+ * one reference and are freed when the last
+ * one is released. Releasing NULL does nothing.
+ *
+ */
+void* allocRegionBlock(size_t size);
+void* shareRegionBlock(void* block);
+void releaseRegionBlock(void* block);
+
+/**
+ * Returns 1 for the blocks every region with the
+ * same light or occupancy throughout shares (open
+ * sky, dark, empty and full), they are never
+ * freed.
+ *
+ */
+int isUniformRegionBlock(void* block);
+
+// How many uniform blocks there are
+#define REGION_UNIFORM_BLOCKS 4
+
+/**
+ * Swaps the light of the region for the shared
+ * block when every mini cube has open sky or no
+ * light at all. Returns 1 if it did.
+ *
+ */
+int shareUniformLight(Region* reg);
+
+/**
+ * Gives the region its own copy of each block in
+ * blocks (RegionBlock flags) that a snapshot is
+ * still holding. Blocks only the region holds
+ * are left as they are. Packed data is unpacked.
+ * Counts as an edit so the version goes up.
+ *
+ */
+void makeRegionWritable(Region* reg, int blocks);
+
+/**
+ * An immutable copy of the region that shares
+ * its storage, costing one reference per block.
+ * It reads like any region but has no mesh or
+ * neighbors. Snapshots must be taken on the
+ * thread that edits the region, they can be read
+ * and freed on any thread.
+ *
+ * Without cells only the occupancy and light are
+ * kept, getMCube can't be used on it but packed
+ * regions don't have to be unpacked for it.
+ */
+Region* snapshotRegion(Region* reg, int cells);
+
+/**
+ * Snapshots each region and links the snapshots
+ * the way the regions are linked, neighbors
+ * that aren't in the list are left out. Only
+ * the first cellCount keep their cells.
+ *
+ */
+Region** snapshotRegions(Region** regions, int count, int cellCount);
+
+void freeRegionSnapshot(Region** snapshotPptr);
+void freeRegionSnapshots(Region*** snapshotsPtr, int count);
+
 /**
  * Simply connects the two regions to each other.
  *
@@ -46,6 +228,30 @@ int connectRegions(Region* src, Region* dest, enum CubeFace face);
  */
 int detachRegions(Region* src, Region* reg);
 
+/**
+ * Returns the region linked on the given
+ * face or NULL if there is none.
+ *
+ */
+Region* getNeighbor(Region* reg, enum CubeFace face);
+
+/**
+ * Walks the neighbor links to find the region
+ * that is rx, ry, rz regions away from the
+ * anchor (x first, then y, then z).
+ *
+ * Returns NULL if the path is not loaded.
+ */
+Region* findRegion(Region* anchor, int rx, int ry, int rz);
+
+/**
+ * Divides rounding down, so mini cubes at
+ * negative positions land in the region before
+ * the anchor rather than in it.
+ *
+ */
+int floorDiv(int a, int b);
+
 /**
  * Functions for setting the region
  * data.
@@ -55,6 +261,32 @@ int fillRegion(char* cubeID, Region* regPtr);
 int setMCube(char* cubeID, Region* regPtr, vec3s pos);
 int setCube(char* cubeID, Region* regPtr, vec3s pos);
 
+/**
+ * Same as fillRegion but only touches the
+ * data, meshes and light are left for the
+ * caller to update.
+ *
+ * Returns 1 if the region changed, 0 otherwise.
+ */
+int setRegionFill(char* cubeID, Region* regPtr);
+
+/**
+ * Converts a FILLED or CUBED region so every
+ * mini cube has its own entry.
+ *
+ * Returns 1 if converted, 0 if already MCUBED.
+ */
+int expandRegion(Region* regPtr);
+
+/**
+ * Turns an MCUBED region whose mini cubes are
+ * all the same cube back into a FILLED one. The
+ * cubes don't change so nothing is journaled.
+ *
+ * Returns 1 if collapsed, 0 otherwise.
+ */
+int collapseRegion(Region* regPtr);
+
 /**
  * Functions for getting cube data from
  * region.
@@ -64,6 +296,74 @@ int setCube(char* cubeID, Region* regPtr, vec3s pos);
  */
 char* getMCube(Region* reg, int x, int y, int z);
 
+/**
+ * Returns 1 if the IDs name the same cube. The
+ * same name can be held at different addresses
+ * so the names are compared when the pointers
+ * differ.
+ *
+ */
+int isSameCube(char* a, char* b);
+
+/**
+ * Returns 1 if the mini cube inside of the
+ * region is not air, 0 otherwise. Coordinates
+ * must be inside the region.
+ *
+ */
+int isMCubeSolid(Region* reg, int x, int y, int z);
+
+/**
+ * Occupancy row mask with bits x0 to x1
+ * (inclusive) set.
+ *
+ */
+RegionRow getRowMask(int x0, int x1);
+
+/**
+ * The rows of one occupancy plane.
+ *
+ */
+RegionRow* getOccupancyPlane(Region* reg, enum OccupancyPlane plane);
+
+/**
+ * Replaces one occupancy row in both planes and
+ * updates the solid counts by the bits that
+ * changed. Opaque bits must also be solid.
+ *
+ */
+void setOccupancyRow(Region* reg, int y, int z, RegionRow row, RegionRow opaque);
+
+/**
+ * Sets the bits of one occupancy row to what the
+ * cube is, air, transparent or opaque.
+ *
+ */
+void setOccupancyBits(Region* reg, int y, int z, RegionRow bits, char* cubeID);
+
+/**
+ * Answered from the solid counts without
+ * looking at the rows.
+ *
+ */
+int isRegionEmpty(Region* reg);
+int isRegionFull(Region* reg);
+
+/**
+ * Returns 1 if every mini cube on the border
+ * layer of the given face is solid.
+ *
+ */
+int isRegionFaceCovered(Region* reg, enum CubeFace face);
+
+/**
+ * Rebuilds the occupancy rows from the region
+ * data, only needed when the data is replaced
+ * directly.
+ *
+ */
+void updateRegionOccupancy(Region* reg);
+
 /**
  * Modifies the mesh to fit with the
  * data.
@@ -71,6 +371,33 @@ char* getMCube(Region* reg, int x, int y, int z);
  */
 void updateRegionMesh(Region* reg);
 
+/**
+ * Marks the mesh sections that can see the
+ * mini cubes lo to hi (inclusive) as dirty,
+ * including the sections of neighbors that
+ * share a border with them.
+ *
+ */
+void markRegionDirty(Region* reg, int lo[3], int hi[3]);
+
+/**
+ * Builds the faces of one section of a region
+ * into the builders, laid out for the mesh.
+ * Faces of transparent cubes go to clearBuilder.
+ * Only the layout of the mesh is read so the
+ * region can be a snapshot.
+ *
+ */
+void buildRegionSection(Region* reg, Mesh* mesh, int section, MeshBuilder* builder, MeshBuilder* clearBuilder);
+
+/**
+ * Rebuilds only the dirty sections, they are
+ * uploaded when the mesh is next drawn. No GL
+ * calls are made so it can run on any thread.
+ *
+ */
+void updateRegionSections(Region* reg);
+
 void freeRegion(Region** regPptr);
 
 #endif
@@ -0,0 +1,249 @@
+/**
+ * Remeshing off the main thread. Jobs build from
+ * snapshots so editing carries on around them,
+ * and results are checked against the region
+ * versions before they replace what is drawn.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "remesh.h"
+#include "jobs.h"
+#include "arena.h"
+
+// The region and every region around it, face
+// light is sampled across edges and corners
+#define REMESH_SOURCES 27
+
+typedef struct _remeshJob {
+    Region* region;
+
+    // Regions the mesh is built from and their
+    // versions when they were snapshotted, the
+    // region itself is first
+    int sourceCount;
+    Region* sources[REMESH_SOURCES];
+    uint64_t versions[REMESH_SOURCES];
+    Region** snapshots;
+
+    // Sections that were dirty and the faces
+    // built for each of them, transparent ones
+    // kept apart
+    int sectionCount;
+    int* sections;
+    void** faces;
+    int* faceCounts;
+    void** clearFaces;
+    int* clearCounts;
+} RemeshJob;
+
+// Zeroed the same as initJobCounter leaves it
+static JobCounter remeshes;
+static RemeshStats remeshStats;
+
+static void freeRemeshJob(RemeshJob* job) {
+    for (int i = 0; i < job->sectionCount; i++) {
+        free(job->faces[i]);
+        free(job->clearFaces[i]);
+    }
+
+    free(job->sections);
+    free(job->faces);
+    free(job->faceCounts);
+    free(job->clearFaces);
+    free(job->clearCounts);
+    free(job);
+}
+
+/**
+ * Puts the result in the mesh on the main thread.
+ * If anything it was built from changed since it
+ * is still newer than what is drawn, so it is
+ * shown but the sections stay dirty and are built
+ * again. Edits every frame still get seen that
+ * way, one remesh behind.
+ *
+ */
+static void applyRemesh(void* data) {
+    RemeshJob* job = data;
+    Region* reg = job->region;
+
+    int stale = 0;
+    for (int i = 0; i < job->sourceCount; i++) {
+        if (job->sources[i]->version != job->versions[i])
+            stale = 1;
+    }
+
+    reg->remeshRunning = 0;
+
+    for (int i = 0; i < job->sectionCount; i++) {
+        setMeshSection(reg->meshPtr, job->sections[i], job->faces[i], job->faceCounts[i], job->clearFaces[i], job->clearCounts[i]);
+
+        if (!stale)
+            reg->meshPtr->sections[job->sections[i]].dirty = 0;
+    }
+
+    if (stale) {
+        // Built again from the newer data
+        remeshStats.stale++;
+        startRegionRemesh(reg);
+    }
+    else {
+        remeshStats.applied++;
+    }
+
+    freeRemeshJob(job);
+}
+
+/**
+ * Copies the faces out of the builder, NULL if
+ * there are none.
+ *
+ */
+static void* copyBuiltFaces(MeshBuilder* builder, int faceBytes) {
+    if (builder->size == 0)
+        return NULL;
+
+    void* faces = malloc((size_t) builder->size * faceBytes);
+
+    if (faces == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate memory for program!\n");
+        exit(1);
+    }
+
+    memcpy(faces, builder->data, (size_t) builder->size * faceBytes);
+    return faces;
+}
+
+static void buildRemesh(void* data) {
+    RemeshJob* job = data;
+
+    // Only its layout is read, which never changes
+    Mesh* mesh = job->region->meshPtr;
+
+    Arena* scratch = getScratchArena();
+    size_t mark = getArenaMark(scratch);
+    MeshBuilder builder = {.data = NULL, .size = 0, .capacity = 0, .arena = scratch};
+    MeshBuilder clearBuilder = {.data = NULL, .size = 0, .capacity = 0, .arena = scratch};
+
+    for (int i = 0; i < job->sectionCount; i++) {
+        clearMeshBuilder(&builder);
+        clearMeshBuilder(&clearBuilder);
+        buildRegionSection(job->snapshots[0], mesh, job->sections[i], &builder, &clearBuilder);
+
+        // Scratch space is given back long before
+        // the result is used
+        job->faceCounts[i] = builder.size;
+        job->faces[i] = copyBuiltFaces(&builder, mesh->faceBytes);
+        job->clearCounts[i] = clearBuilder.size;
+        job->clearFaces[i] = copyBuiltFaces(&clearBuilder, mesh->faceBytes);
+    }
+
+    freeMeshBuilder(&builder);
+    freeMeshBuilder(&clearBuilder);
+    rewindArena(scratch, mark);
+
+    freeRegionSnapshots(&(job->snapshots), job->sourceCount);
+
+    // Counted before this job finishes so the
+    // remeshes never look done in between
+    runMainJob(applyRemesh, job, &remeshes);
+}
+
+/**
+ * Adds a region to read from unless there is no
+ * region there or it was already added.
+ *
+ */
+static void addRemeshSource(RemeshJob* job, Region* reg) {
+    if (reg == NULL)
+        return;
+
+    for (int i = 0; i < job->sourceCount; i++) {
+        if (job->sources[i] == reg)
+            return;
+    }
+
+    job->sources[job->sourceCount] = reg;
+    job->versions[job->sourceCount] = reg->version;
+    job->sourceCount++;
+}
+
+void startRegionRemesh(Region* reg) {
+    // A remesh already running will come back
+    // stale and start again
+    if (reg == NULL || reg->remeshRunning)
+        return;
+
+    Mesh* mesh = reg->meshPtr;
+
+    int dirty = 0;
+    for (int i = 0; i < mesh->sectionCount; i++)
+        dirty += mesh->sections[i].dirty != 0;
+
+    if (dirty == 0)
+        return;
+
+    RemeshJob* job = malloc(sizeof(RemeshJob));
+
+    if (job == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate memory for program!\n");
+        exit(1);
+    }
+
+    job->region = reg;
+    job->sectionCount = 0;
+    job->sections = malloc(dirty * sizeof(int));
+    job->faces = calloc(dirty, sizeof(void*));
+    job->faceCounts = calloc(dirty, sizeof(int));
+    job->clearFaces = calloc(dirty, sizeof(void*));
+    job->clearCounts = calloc(dirty, sizeof(int));
+
+    if (job->sections == NULL || job->faces == NULL || job->faceCounts == NULL ||
+        job->clearFaces == NULL || job->clearCounts == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate memory for program!\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < mesh->sectionCount; i++) {
+        if (mesh->sections[i].dirty)
+            job->sections[job->sectionCount++] = i;
+    }
+
+    // Found the way the light samples find them so
+    // the snapshots link up the same
+    job->sourceCount = 0;
+    addRemeshSource(job, reg);
+
+    for (int dy = -1; dy <= 1; dy++)
+        for (int dz = -1; dz <= 1; dz++)
+            for (int dx = -1; dx <= 1; dx++)
+                addRemeshSource(job, findRegion(reg, dx, dy, dz));
+
+    // Faces only look at the cells of the region
+    // itself, the neighbors lend their occupancy
+    // and light so cold ones stay packed
+    job->snapshots = snapshotRegions(job->sources, job->sourceCount, 1);
+
+    reg->remeshRunning = 1;
+    remeshStats.started++;
+
+    runJob(buildRemesh, job, &remeshes);
+}
+
+void waitForRemeshes() {
+    waitForJobs(&remeshes);
+}
+
+RemeshStats getRemeshStats() {
+    RemeshStats result = remeshStats;
+    memset(&remeshStats, 0, sizeof(RemeshStats));
+
+    return result;
+}
+
+void printRemeshStats(RemeshStats* stats) {
+    fprintf(stderr, "Remeshes %d, %d current, %d stale\n", stats->started, stats->applied, stats->stale);
+}
@@ -0,0 +1,49 @@
+#include "region.h"
+
+#ifndef REMESH_H
+#define REMESH_H
+
+/**
+ * Remeshing done so far, only touched on the
+ * main thread.
+ *
+ */
+typedef struct _remeshStats {
+    int started;
+    int applied;
+
+    // Built from regions that changed before the
+    // result got back, so it was drawn but the
+    // region was queued again
+    int stale;
+} RemeshStats;
+
+/**
+ * Rebuilds the dirty sections of a region on the
+ * job workers, reading from snapshots of it and
+ * the regions around it. The result is drawn
+ * when it gets back, if any of their versions
+ * changed while it was built the region is
+ * remeshed again. Call from the main thread.
+ *
+ * A region can't be freed while it or any region
+ * next to it is being remeshed.
+ */
+void startRegionRemesh(Region* reg);
+
+/**
+ * Runs jobs until every remesh started has been
+ * drawn, including the ones started again for
+ * being stale.
+ *
+ */
+void waitForRemeshes();
+
+/**
+ * Reads and restarts the stats.
+ *
+ */
+RemeshStats getRemeshStats();
+void printRemeshStats(RemeshStats* stats);
+
+#endif
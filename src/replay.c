@@ -0,0 +1,187 @@
+/**
+ * Records the input and edits of a session to a
+ * trace and plays it back tick for tick, so
+ * builds can be timed on the same workload.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "replay.h"
+#include "edit.h"
+#include "palette.h"
+
+// Replays that end further than this from where
+// a tick was recorded count as drifted
+static const float DRIFT_DISTANCE = 1e-4f;
+
+static Trace* initTrace(enum TraceMode mode, FILE* file, uint32_t tickRate, uint32_t flags) {
+    Trace* result = malloc(sizeof(Trace));
+
+    if (result == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate memory for program!\n");
+        exit(1);
+    }
+
+    memset(result, 0, sizeof(Trace));
+
+    result->mode = mode;
+    result->file = file;
+    result->tickRate = tickRate;
+    result->flags = flags;
+
+    return result;
+}
+
+Trace* startRecording(const char* path, int tickRate, uint32_t flags) {
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: Cannot write trace %s\n", path);
+        return NULL;
+    }
+
+    TraceHeader header = {
+        .magic = TRACE_MAGIC,
+        .version = TRACE_VERSION,
+        .tickRate = tickRate,
+        .flags = flags
+    };
+
+    fwrite(&header, sizeof(header), 1, fp);
+
+    return initTrace(TRACE_RECORD, fp, tickRate, flags);
+}
+
+Trace* startReplay(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: Cannot open trace %s\n", path);
+        return NULL;
+    }
+
+    TraceHeader header;
+
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        header.magic != TRACE_MAGIC || header.version != TRACE_VERSION || header.tickRate == 0) {
+        fprintf(stderr, "ERROR: %s is not a trace this build can play\n", path);
+        fclose(fp);
+        return NULL;
+    }
+
+    return initTrace(TRACE_REPLAY, fp, header.tickRate, header.flags);
+}
+
+void recordTick(Trace* trace, TraceTick* tick) {
+    fputc(TRACE_TICK, trace->file);
+    fwrite(tick, sizeof(TraceTick), 1, trace->file);
+
+    trace->ticks++;
+}
+
+void recordEdit(Trace* trace, TraceEdit* edit) {
+    fputc(TRACE_EDIT, trace->file);
+    fwrite(edit, sizeof(TraceEdit), 1, trace->file);
+}
+
+int readTraceEdit(Trace* trace, TraceEdit* edit) {
+    int type = fgetc(trace->file);
+
+    if (type != TRACE_EDIT) {
+        if (type != EOF)
+            ungetc(type, trace->file);
+        return 0;
+    }
+
+    if (fread(edit, sizeof(TraceEdit), 1, trace->file) != 1)
+        return 0;
+
+    // Never trust the string to be terminated
+    edit->cubeID[TRACE_CUBE_ID_LENGTH - 1] = '\0';
+
+    return 1;
+}
+
+int readTraceTick(Trace* trace, TraceTick* tick) {
+    int type;
+
+    // Edits nobody asked for are skipped
+    while ((type = fgetc(trace->file)) == TRACE_EDIT)
+        fseek(trace->file, sizeof(TraceEdit), SEEK_CUR);
+
+    if (type != TRACE_TICK || fread(tick, sizeof(TraceTick), 1, trace->file) != 1)
+        return 0;
+
+    trace->ticks++;
+
+    return 1;
+}
+
+int applyTraceEdit(TraceEdit* edit, Region** regions, int count) {
+    if (edit->anchor >= (uint32_t) count) {
+        fprintf(stderr, "WARNING: Trace edits region %u of %d\n", edit->anchor, count);
+        return 0;
+    }
+
+    Region* anchor = regions[edit->anchor];
+
+    // The cells keep the pointer, so they get the
+    // palette's copy rather than the edit's buffer
+    char* cubeID = getPaletteCube(getPaletteID(edit->cubeID));
+
+    vec3s from = {.x = edit->from[0], .y = edit->from[1], .z = edit->from[2]};
+    vec3s to = {.x = edit->to[0], .y = edit->to[1], .z = edit->to[2]};
+
+    switch (edit->kind) {
+        case TRACE_FILL_BOX:
+            return fillBox(cubeID, anchor, from, to);
+        case TRACE_FILL_SPHERE:
+            return fillSphere(cubeID, anchor, from, edit->radius);
+    }
+
+    return 0;
+}
+
+void checkTraceTick(Trace* trace, TraceTick* recorded, float position[3]) {
+    for (int i = 0; i < 3; i++) {
+        float difference = recorded->position[i] - position[i];
+
+        if (difference > DRIFT_DISTANCE || difference < -DRIFT_DISTANCE) {
+            trace->drifted++;
+            return;
+        }
+    }
+}
+
+void addTraceFrame(Trace* trace, double milliseconds) {
+    addFrameTime(&(trace->frames), milliseconds);
+}
+
+void printTraceStats(Trace* trace) {
+    if (trace->mode == TRACE_RECORD) {
+        fprintf(stderr, "Recorded %u ticks\n", trace->ticks);
+        return;
+    }
+
+    fprintf(stderr, "Replayed %u ticks, %u drifted from the recording\n", trace->ticks, trace->drifted);
+
+    FrameSummary summary;
+    summarizeFrameTimes(&(trace->frames), &summary);
+
+    if (summary.count == 0)
+        return;
+
+    fprintf(stderr, "Replay frames: %d over %.2f s, %.2f ms avg (%.1f fps)\n",
+            summary.count, summary.total / 1000.0, summary.mean, 1000.0 / summary.mean);
+    fprintf(stderr, "Replay frame times: %.2f min, %.2f p50, %.2f p95, %.2f p99, %.2f max ms\n",
+            summary.min, summary.p50, summary.p95, summary.p99, summary.max);
+}
+
+void freeTrace(Trace** tracePtrPtr) {
+    Trace* trace = *tracePtrPtr;
+
+    fclose(trace->file);
+    freeFrameTimes(&(trace->frames));
+    free(trace);
+
+    *tracePtrPtr = NULL;
+}
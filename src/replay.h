@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#include "region.h"
+#include "pacing.h"
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+/**
+ * Layout of a trace file. The header is followed
+ * by records, each a type byte and its struct.
+ * Edits are written before the tick they happen
+ * in so a replay applies them before moving.
+ *
+ */
+#define TRACE_MAGIC 0x5254434du // "MCTR"
+#define TRACE_VERSION 2
+#define TRACE_CUBE_ID_LENGTH 8
+
+// Header flags for settings that change how
+// the player moves
+#define TRACE_NOCLIP 1u
+
+typedef struct _traceHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t tickRate;
+    uint32_t flags;
+} TraceHeader;
+
+enum TraceRecordType {
+    TRACE_TICK,
+    TRACE_EDIT
+};
+
+/**
+ * The input of one simulation tick and where
+ * the player ended up, which replays check
+ * against to notice when they drift.
+ *
+ */
+typedef struct _traceTick {
+    uint32_t tick;
+    float yaw;
+    float pitch;
+    uint32_t keys;
+    float position[3];
+} TraceTick;
+
+enum TraceEditKind {
+    TRACE_FILL_BOX,
+    TRACE_FILL_SPHERE
+};
+
+/**
+ * A bulk edit as it was applied, positions are
+ * mini cubes relative to the anchor region which
+ * is an index into the world's regions.
+ *
+ */
+typedef struct _traceEdit {
+    uint32_t tick;
+    uint32_t anchor;
+    uint8_t kind;
+    int16_t from[3];
+    int16_t to[3];
+    float radius;
+    char cubeID[TRACE_CUBE_ID_LENGTH];
+} TraceEdit;
+
+enum TraceMode {
+    TRACE_RECORD,
+    TRACE_REPLAY
+};
+
+typedef struct _trace {
+    enum TraceMode mode;
+    FILE* file;
+    uint32_t tickRate;
+    uint32_t flags;
+
+    // Ticks replayed and how many of them ended
+    // somewhere other than they were recorded
+    uint32_t ticks;
+    uint32_t drifted;
+
+    // Every frame of a replay
+    FrameTimes frames;
+} Trace;
+
+/**
+ * Opens a trace to write to or play back. Both
+ * return NULL if the file can't be used, replays
+ * take their tick rate and flags from the file.
+ *
+ */
+Trace* startRecording(const char* path, int tickRate, uint32_t flags);
+Trace* startReplay(const char* path);
+
+void recordTick(Trace* trace, TraceTick* tick);
+void recordEdit(Trace* trace, TraceEdit* edit);
+
+/**
+ * Reads the next edit if one comes before the
+ * next tick. Returns 1 if there was one.
+ *
+ */
+int readTraceEdit(Trace* trace, TraceEdit* edit);
+
+/**
+ * Reads the next tick. Returns 0 once the trace
+ * has ended.
+ *
+ */
+int readTraceTick(Trace* trace, TraceTick* tick);
+
+/**
+ * Applies a recorded edit to the world it was
+ * made in. Returns 1 if anything changed.
+ *
+ */
+int applyTraceEdit(TraceEdit* edit, Region** regions, int count);
+
+/**
+ * Compares where a replayed tick ended with where
+ * it did when recorded.
+ *
+ */
+void checkTraceTick(Trace* trace, TraceTick* recorded, float position[3]);
+
+void addTraceFrame(Trace* trace, double milliseconds);
+
+/**
+ * Prints the frame times of a replay so runs of
+ * different builds can be compared.
+ *
+ */
+void printTraceStats(Trace* trace);
+
+void freeTrace(Trace** tracePtrPtr);
+
+#endif
@@ -3,89 +3,147 @@
  *
  */
 #include <glad/glad.h>
+#include <SDL2/SDL.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "shader.h"
+#include "asset.h"
+
+// Programs are cached here by the paths of
+// their shaders
+static const char* SHADER_CACHE_DIR = "cache";
+
+// Start of every cache file so old layouts
+// are recompiled instead of read wrong
+static const uint32_t SHADER_CACHE_MAGIC = 0x4250434d; // "MCPB"
+static const uint32_t SHADER_CACHE_VERSION = 1;
+
+typedef struct _programCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
+} ProgramCacheHeader;
 
 /**
- * Takes in a file name and returns a pointer to the first character
- * at the start of the file.
+ * Takes in a file name and returns a copy of the file ending in a
+ * null character, or NULL if it can't be loaded. The caller frees it.
  *
  */
 char* getFileContent(const char* fileName) {
-    FILE* fp;
-    long size = 0;
-    char* content;
+    Asset asset;
 
-    // Read file to get the size
-    fp = fopen(fileName, "rb");
-    if (fp == NULL) 
-        return "";
+    if (loadAsset(fileName, &asset) < 0)
+        return NULL;
 
-    fseek(fp, 0L, SEEK_END);
-    size = ftell(fp) + 1;
-    fclose(fp);
+    char* content = malloc(asset.size + 1);
 
-    // Read to return content
-    fp = fopen(fileName, "r");
-    content = memset(malloc(size), '\0', size);
-    fread(content, 1, size - 1, fp);
-    fclose(fp);
+    if (content != NULL) {
+        memcpy(content, asset.data, asset.size);
+        content[asset.size] = '\0';
+    }
 
+    freeAsset(&asset);
     return content;
 }
 
 /**
- * Compiles a shader of any type and stores the ID in a given pointer.
+ * Starts compiling shader source without waiting
+ * for it, the path is only used for errors.
  *
  */
-void compileShader(GLuint* shaderID, GLenum shaderType, const char* shaderFilePath) {
-    GLint isCompiled = 0;
-    GLint maxLength = 0;
-    char* infoLog = malloc(1024);
-
-    const char* shaderSource = getFileContent(shaderFilePath);
-
+static void compileSource(GLuint* shaderID, GLenum shaderType, Asset* source, const char* shaderFilePath) {
     *shaderID = glCreateShader(shaderType);
     if (*shaderID == 0)
         fprintf(stderr, "ERROR: Could not load shader %s\n", shaderFilePath);
 
-    glShaderSource(*shaderID, 1, (const char**) &shaderSource, NULL);
+    GLint length = source->size;
+    glShaderSource(*shaderID, 1, &(source->data), &length);
     glCompileShader(*shaderID);
-    glGetShaderiv(*shaderID, GL_COMPILE_STATUS, &isCompiled);
+}
+
+/**
+ * Waits for a shader to compile and prints the
+ * log if it failed.
+ *
+ */
+static void checkShader(GLuint shaderID, const char* shaderFilePath) {
+    GLint isCompiled = 0;
+    GLint maxLength = 0;
+    char* infoLog = malloc(1024);
+
+    glGetShaderiv(shaderID, GL_COMPILE_STATUS, &isCompiled);
 
     if (isCompiled == GL_FALSE) {
         fprintf(stderr, "ERROR: Compiling shader failed %s\n", shaderFilePath);
 
-        glGetShaderiv(*shaderID, GL_INFO_LOG_LENGTH, &maxLength);
-        glGetShaderInfoLog(*shaderID, maxLength, &maxLength, infoLog);
+        glGetShaderiv(shaderID, GL_INFO_LOG_LENGTH, &maxLength);
+        glGetShaderInfoLog(shaderID, maxLength, &maxLength, infoLog);
 
         fprintf(stderr, "%s\n", infoLog);
-
-        glDeleteShader(*shaderID);
     }
 
     free(infoLog);
 }
 
 /**
- * Links fragment and vertex shader together. 
- * Returns the program ID.
+ * Compiles a shader of any type and stores the ID in a given pointer.
  *
  */
-GLuint linkShader(GLuint vertexShaderID, GLuint fragmentShaderID) {
-    GLuint programID = 0;
-    GLint isLinked = 0;
-    GLint maxLength = 0;
-    char* infoLog = malloc(1024);
+void compileShader(GLuint* shaderID, GLenum shaderType, const char* shaderFilePath) {
+    Asset source;
 
-    programID = glCreateProgram();
+    if (loadAsset(shaderFilePath, &source) < 0) {
+        fprintf(stderr, "ERROR: Could not load shader %s\n", shaderFilePath);
+        *shaderID = 0;
+        return;
+    }
+
+    compileSource(shaderID, shaderType, &source, shaderFilePath);
+    freeAsset(&source);
+
+    GLint isCompiled = 0;
+    checkShader(*shaderID, shaderFilePath);
+    glGetShaderiv(*shaderID, GL_COMPILE_STATUS, &isCompiled);
+
+    if (isCompiled == GL_FALSE)
+        glDeleteShader(*shaderID);
+}
+
+/**
+ * Starts linking without waiting for it.
+ *
+ */
+static GLuint startLink(GLuint vertexShaderID, GLuint fragmentShaderID) {
+    GLuint programID = glCreateProgram();
+
+    // Lets the program be saved to the cache
+    glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
     glAttachShader(programID, vertexShaderID);
     glAttachShader(programID, fragmentShaderID);
 
     glLinkProgram(programID);
 
+    return programID;
+}
+
+/**
+ * Waits for a link to finish and cleans up the
+ * shaders. Returns the program ID or 0 if it
+ * failed.
+ *
+ */
+static GLuint checkLink(GLuint programID, GLuint vertexShaderID, GLuint fragmentShaderID) {
+    GLint isLinked = 0;
+    GLint maxLength = 0;
+    char* infoLog = malloc(1024);
+
     glGetProgramiv(programID, GL_LINK_STATUS, &isLinked);
 
     if (isLinked == GL_FALSE) {
@@ -113,3 +171,227 @@ GLuint linkShader(GLuint vertexShaderID, GLuint fragmentShaderID) {
 
     return programID;
 }
+
+/**
+ * Links fragment and vertex shader together. 
+ * Returns the program ID.
+ *
+ */
+GLuint linkShader(GLuint vertexShaderID, GLuint fragmentShaderID) {
+    GLuint programID = startLink(vertexShaderID, fragmentShaderID);
+
+    return checkLink(programID, vertexShaderID, fragmentShaderID);
+}
+
+/**
+ * FNV-1a over some bytes.
+ *
+ */
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = data;
+
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+/**
+ * Hashes a string including its end so joined
+ * strings can't collide by shifting.
+ *
+ */
+static uint64_t hashString(uint64_t hash, const char* str) {
+    if (str == NULL)
+        str = "";
+
+    return hashBytes(hash, str, strlen(str) + 1);
+}
+
+static double elapsedMs(Uint64 start) {
+    return (double) (SDL_GetPerformanceCounter() - start) * 1000.0 / (double) SDL_GetPerformanceFrequency();
+}
+
+/**
+ * Tries to make the program from the cache file,
+ * returns 0 if it is missing or doesn't match.
+ *
+ */
+static GLuint loadCachedProgram(const char* cachePath, uint64_t key) {
+    FILE* fp = fopen(cachePath, "rb");
+    if (fp == NULL)
+        return 0;
+
+    ProgramCacheHeader header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        header.magic != SHADER_CACHE_MAGIC || header.version != SHADER_CACHE_VERSION ||
+        header.key != key || header.length == 0) {
+        fclose(fp);
+        return 0;
+    }
+
+    void* binary = malloc(header.length);
+    if (binary == NULL || fread(binary, 1, header.length, fp) != header.length) {
+        free(binary);
+        fclose(fp);
+        return 0;
+    }
+
+    fclose(fp);
+
+    GLuint programID = glCreateProgram();
+    glProgramBinary(programID, header.format, binary, header.length);
+    free(binary);
+
+    // Drivers can still turn the binary down
+    // even when the strings matched
+    GLint isLinked = 0;
+    glGetProgramiv(programID, GL_LINK_STATUS, &isLinked);
+
+    if (isLinked == GL_FALSE) {
+        glDeleteProgram(programID);
+        return 0;
+    }
+
+    return programID;
+}
+
+static void saveCachedProgram(const char* cachePath, uint64_t key, GLuint programID) {
+    GLint length = 0;
+    glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &length);
+
+    if (length <= 0)
+        return;
+
+    void* binary = malloc(length);
+    if (binary == NULL)
+        return;
+
+    GLenum format = 0;
+    glGetProgramBinary(programID, length, &length, &format, binary);
+
+    mkdir(SHADER_CACHE_DIR, 0755);
+
+    FILE* fp = fopen(cachePath, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "WARNING: Cannot write shader cache %s\n", cachePath);
+        free(binary);
+        return;
+    }
+
+    ProgramCacheHeader header = {
+        .magic = SHADER_CACHE_MAGIC,
+        .version = SHADER_CACHE_VERSION,
+        .key = key,
+        .format = format,
+        .length = length
+    };
+
+    fwrite(&header, sizeof(header), 1, fp);
+    fwrite(binary, 1, length, fp);
+    fclose(fp);
+
+    free(binary);
+}
+
+int startProgram(ProgramBuild* build, const char* vertexFilePath, const char* fragmentFilePath) {
+    build->start = SDL_GetPerformanceCounter();
+    build->vertexFilePath = vertexFilePath;
+    build->fragmentFilePath = fragmentFilePath;
+    build->programID = 0;
+    build->vertexShaderID = 0;
+    build->fragmentShaderID = 0;
+    build->cached = 0;
+
+    Asset vertexSource, fragmentSource;
+
+    if (loadAsset(vertexFilePath, &vertexSource) < 0) {
+        fprintf(stderr, "ERROR: Could not load shader %s\n", vertexFilePath);
+        return -1;
+    }
+
+    if (loadAsset(fragmentFilePath, &fragmentSource) < 0) {
+        fprintf(stderr, "ERROR: Could not load shader %s\n", fragmentFilePath);
+        freeAsset(&vertexSource);
+        return -1;
+    }
+
+    // The file is named after the shaders and
+    // holds the key of what it was built from.
+    // Sizes go in so the sources can't run into
+    // each other
+    uint64_t key = 0xcbf29ce484222325ull;
+    key = hashBytes(key, &(vertexSource.size), sizeof(size_t));
+    key = hashBytes(key, vertexSource.data, vertexSource.size);
+    key = hashBytes(key, &(fragmentSource.size), sizeof(size_t));
+    key = hashBytes(key, fragmentSource.data, fragmentSource.size);
+    key = hashString(key, (const char*) glGetString(GL_VENDOR));
+    key = hashString(key, (const char*) glGetString(GL_RENDERER));
+    key = hashString(key, (const char*) glGetString(GL_VERSION));
+    build->key = key;
+
+    uint64_t name = 0xcbf29ce484222325ull;
+    name = hashString(name, vertexFilePath);
+    name = hashString(name, fragmentFilePath);
+
+    snprintf(build->cachePath, sizeof(build->cachePath), "%s/%016llx.bin", SHADER_CACHE_DIR, (unsigned long long) name);
+
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    build->cacheable = formats > 0;
+
+    if (build->cacheable)
+        build->programID = loadCachedProgram(build->cachePath, key);
+
+    if (build->programID != 0) {
+        build->cached = 1;
+    }
+    else {
+        // With KHR_parallel_shader_compile these
+        // return right away and the driver works
+        // on them until finishProgram asks
+        compileSource(&(build->vertexShaderID), GL_VERTEX_SHADER, &vertexSource, vertexFilePath);
+        compileSource(&(build->fragmentShaderID), GL_FRAGMENT_SHADER, &fragmentSource, fragmentFilePath);
+
+        build->programID = startLink(build->vertexShaderID, build->fragmentShaderID);
+    }
+
+    freeAsset(&vertexSource);
+    freeAsset(&fragmentSource);
+
+    return 0;
+}
+
+GLuint finishProgram(ProgramBuild* build) {
+    if (build->cached) {
+        fprintf(stderr, "Loaded program %s, %s from cache in %.2f ms\n", build->vertexFilePath, build->fragmentFilePath, elapsedMs(build->start));
+        return build->programID;
+    }
+
+    if (build->programID == 0)
+        return 0;
+
+    checkShader(build->vertexShaderID, build->vertexFilePath);
+    checkShader(build->fragmentShaderID, build->fragmentFilePath);
+
+    GLuint programID = checkLink(build->programID, build->vertexShaderID, build->fragmentShaderID);
+
+    if (programID != 0 && build->cacheable)
+        saveCachedProgram(build->cachePath, build->key, programID);
+
+    fprintf(stderr, "Compiled program %s, %s in %.2f ms\n", build->vertexFilePath, build->fragmentFilePath, elapsedMs(build->start));
+
+    build->programID = programID;
+    return programID;
+}
+
+GLuint loadProgram(const char* vertexFilePath, const char* fragmentFilePath) {
+    ProgramBuild build;
+
+    if (startProgram(&build, vertexFilePath, fragmentFilePath) < 0)
+        return 0;
+
+    return finishProgram(&build);
+}
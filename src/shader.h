@@ -1,12 +1,62 @@
+#include <stdint.h>
 #include <glad/glad.h>
 
 #ifndef SHADER_H
 #define SHADER_H
 
+/**
+ * A program that is being compiled or loaded
+ * from the cache, started by startProgram and
+ * waited on by finishProgram.
+ *
+ */
+typedef struct _programBuild {
+    GLuint programID;
+    GLuint vertexShaderID;
+    GLuint fragmentShaderID;
+
+    const char* vertexFilePath;
+    const char* fragmentFilePath;
+
+    // Loaded from the cache instead of compiled
+    int cached;
+    int cacheable;
+    uint64_t key;
+    char cachePath[64];
+
+    // Performance counter when it started
+    uint64_t start;
+} ProgramBuild;
+
+/**
+ * Returns a copy of the file ending in a null
+ * character or NULL if it can't be loaded.
+ *
+ */
 char* getFileContent(const char* fileName);
 
 void compileShader(GLuint* shaderID, GLenum shaderType, const char* shaderFilePath);
 
 GLuint linkShader(GLuint vertexShaderID, GLuint fragmentShaderID);
 
+/**
+ * Builds a program from a vertex and fragment
+ * shader file. The linked binary is cached on
+ * disk and loaded instead of compiling while the
+ * sources and driver stay the same.
+ *
+ */
+GLuint loadProgram(const char* vertexFilePath, const char* fragmentFilePath);
+
+/**
+ * loadProgram in two halves so other work can
+ * happen while the driver compiles. Starting
+ * returns 0 or -1 if a shader file is missing,
+ * finishing waits and returns the program ID or
+ * 0 if it failed.
+ *
+ */
+int startProgram(ProgramBuild* build, const char* vertexFilePath, const char* fragmentFilePath);
+GLuint finishProgram(ProgramBuild* build);
+
 #endif
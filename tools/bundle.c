@@ -0,0 +1,93 @@
+/**
+ * Packs files into an asset bundle.
+ *
+ * Usage: bundle <output> <files...>
+ *
+ * Files are stored under the path they are
+ * given by, so run it from where the game runs.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "asset.h"
+
+// Blobs start on this boundary
+static const long BUNDLE_ALIGN = 16;
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <output> <files...>\n", argv[0]);
+        return 1;
+    }
+
+    uint32_t count = argc - 2;
+    AssetBundleEntry* entries = calloc(count > 0 ? count : 1, sizeof(AssetBundleEntry));
+
+    if (entries == NULL) {
+        fprintf(stderr, "ERROR: Unable to allocate memory for bundle\n");
+        return 1;
+    }
+
+    FILE* out = fopen(argv[1], "wb");
+    if (out == NULL) {
+        fprintf(stderr, "ERROR: Cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    AssetBundleHeader header = {
+        .magic = ASSET_BUNDLE_MAGIC,
+        .version = ASSET_BUNDLE_VERSION,
+        .count = count,
+        .reserved = 0
+    };
+
+    // Index is written again once the
+    // offsets are known
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(entries, sizeof(AssetBundleEntry), count, out);
+
+    for (uint32_t i = 0; i < count; i++) {
+        const char* path = argv[i + 2];
+
+        if (strlen(path) >= ASSET_NAME_LENGTH) {
+            fprintf(stderr, "ERROR: Asset path is too long %s\n", path);
+            return 1;
+        }
+
+        FILE* in = fopen(path, "rb");
+        if (in == NULL) {
+            fprintf(stderr, "ERROR: Cannot open %s\n", path);
+            return 1;
+        }
+
+        while (ftell(out) % BUNDLE_ALIGN != 0)
+            fputc('\0', out);
+
+        strcpy(entries[i].name, path);
+        entries[i].offset = ftell(out);
+
+        char buffer[4096];
+        size_t read;
+
+        while ((read = fread(buffer, 1, sizeof(buffer), in)) > 0)
+            fwrite(buffer, 1, read, out);
+
+        entries[i].size = ftell(out) - entries[i].offset;
+        fclose(in);
+    }
+
+    fseek(out, sizeof(header), SEEK_SET);
+    fwrite(entries, sizeof(AssetBundleEntry), count, out);
+
+    if (fclose(out) != 0) {
+        fprintf(stderr, "ERROR: Cannot write %s\n", argv[1]);
+        return 1;
+    }
+
+    printf("Bundled %u assets into %s\n", count, argv[1]);
+
+    free(entries);
+    return 0;
+}